@@ -0,0 +1,34 @@
+/*
+ * Example loadable builtin: realpath PATH...
+ *
+ *     cc -shared -fPIC -Iinclude -o realpath.so examples/loadable/realpath.c
+ *     $ enable -f ./realpath.so realpath
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "shell_builtin.h"
+
+static int realpath_main(int argc, char *const argv[]) {
+    int status = 0;
+    for (int i = 1; i < argc; i++) {
+        char *resolved = realpath(argv[i], NULL);
+        if (!resolved) {
+            perror(argv[i]);
+            status = 1;
+            continue;
+        }
+        printf("%s\n", resolved);
+        free(resolved);
+    }
+    return status;
+}
+
+struct shell_builtin realpath_builtin = {
+    SHELL_BUILTIN_ABI_VERSION,
+    SHELL_BUILTIN_NOFORK_LAST,
+    "realpath",
+    realpath_main,
+    "realpath path...",
+};
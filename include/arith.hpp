@@ -0,0 +1,32 @@
+#ifndef ARITH_HPP
+#define ARITH_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace shell {
+namespace arith {
+
+/**
+ * @brief Evaluates a shell arithmetic expression, as in $(( expr ))
+ *
+ * Supports 64-bit integers (decimal, 0x hex, 0 octal), variables and
+ * array elements by bare name, and the C operators with C precedence:
+ * ++ -- + - ! ~ ** * / % << >> < <= > >= == != & ^ | && || ?: and the
+ * assignments = += -= *= /= %= <<= >>= &= ^= |=, plus the comma
+ * operator. A variable whose value is not a number is evaluated as an
+ * expression itself; unset and empty variables are 0.
+ *
+ * Expressions are compiled to bytecode once and cached by their text,
+ * so a loop re-evaluating the same expression skips the parser.
+ *
+ * @param expr Expression text
+ * @param result Receives the value
+ * @return true on success, false after printing an error
+ */
+bool evaluate(const std::string& expr, int64_t& result);
+
+} // namespace arith
+} // namespace shell
+
+#endif // ARITH_HPP
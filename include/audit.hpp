@@ -0,0 +1,83 @@
+#ifndef AUDIT_HPP
+#define AUDIT_HPP
+
+#include <chrono>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+namespace shell {
+namespace audit {
+
+/**
+ * @brief One pipeline stage of an audited command line
+ */
+struct Stage {
+    std::vector<std::string> argv;  ///< Command words after redirections are removed
+    std::string path;               ///< Resolved executable; empty for builtins
+    int status = 0;                 ///< Exit status (128 + signal if killed)
+    rusage usage{};                 ///< Resources used; zero for in-shell builtins
+};
+
+/**
+ * @brief One executed command line, written as a single JSON object
+ */
+struct Record {
+    timespec started{};                            ///< Wall-clock start time
+    std::chrono::steady_clock::time_point start;   ///< Monotonic start time
+    std::chrono::microseconds duration{};          ///< Set by submit()
+    std::string cwd;                               ///< Working directory at start
+    std::vector<Stage> stages;                     ///< Filled in by the executor
+    int status = 0;                                ///< Status of the whole line
+    bool timed_out = false;                        ///< Stopped by `timeout`
+};
+
+/**
+ * @brief Checks whether audit logging is on
+ *
+ * Logging is on when SHELL_AUDIT_LOG names a file at the first call,
+ * which also opens the log.
+ * SHELL_AUDIT_LOG_MAX sets the size at which the log is rotated to
+ * FILE.1 (bytes, with an optional K, M or G suffix; default 10M, 0 never).
+ *
+ * @return true if command lines should be recorded
+ */
+bool enabled();
+
+/**
+ * @brief Makes a forked child log its own command lines
+ *
+ * Children normally stay silent, since records they queued would never
+ * reach the parent's writer. Server workers call this after fork().
+ */
+void take_over();
+
+/**
+ * @brief Starts a record: timestamps and working directory
+ * @param record Record to initialise
+ */
+void begin(Record& record);
+
+/**
+ * @brief Queues a finished record for the background writer
+ *
+ * Never blocks and makes no system calls in the common case. If the queue
+ * is full the record is dropped and the drop is counted in the log.
+ *
+ * @param record Completed record (status and stages filled in)
+ */
+void submit(Record&& record);
+
+/**
+ * @brief Writes out everything queued and stops the writer thread
+ *
+ * Runs automatically at exit(); processes that leave through _exit()
+ * call it themselves.
+ */
+void shutdown();
+
+} // namespace audit
+} // namespace shell
+
+#endif // AUDIT_HPP
@@ -0,0 +1,40 @@
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include <string>
+#include <vector>
+
+namespace shell {
+namespace batch {
+
+/**
+ * @brief Checks whether a command asks for argument batching
+ * @param args Command line, after expansion
+ * @return true if a "+batch" word follows the command name
+ */
+bool requested(const std::vector<std::string>& args);
+
+/**
+ * @brief Runs `cmd [fixed...] +batch [-P N] [-n N] [--] items...`
+ *
+ * The items are split into the largest batches that keep argv plus the
+ * environment within sysconf(_SC_ARG_MAX), like xargs, and cmd runs once
+ * per batch with the fixed arguments first. -n caps the items per batch
+ * and -P runs up to N batches at a time (0 means one per CPU; the
+ * default is 1, in order). When everything fits in one batch the
+ * command replaces the calling process directly.
+ *
+ * Meant to run in a forked pipeline stage, whose redirections are
+ * already in place.
+ *
+ * @param args Command line containing the +batch marker
+ * @param path Resolved executable for args[0]
+ * @return 0 if every batch succeeded, 123 if any failed (as xargs), 126
+ *         or 127 if the command could not run, 2 on a usage error
+ */
+int run(const std::vector<std::string>& args, const std::string& path);
+
+} // namespace batch
+} // namespace shell
+
+#endif // BATCH_HPP
@@ -2,13 +2,45 @@
 #define BUILTINS_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
 
+struct shell_builtin;
+
 namespace shell {
 namespace builtins {
 
-/// List of all builtin command names
-extern const std::vector<std::string> builtin_list;
+/// Builtin implementation: takes the command line, returns the exit code
+using Handler = int (*)(const std::vector<std::string>& args);
+
+/// Builtin properties
+enum Flags : unsigned {
+    NO_FLAGS = 0,
+    /// May run in the shell process as the last stage of a pipeline,
+    /// saving a fork (so `cmd | read x` also sets x in the shell)
+    NOFORK_LAST = 1u << 0,
+    /// Ships disabled; turned on with `enable name`
+    OPTIONAL = 1u << 1,
+    /// Runs a command taken from its arguments, which may use +batch
+    RUNS_COMMAND = 1u << 2,
+};
+
+/**
+ * @brief A registered builtin
+ */
+struct Builtin {
+    std::string_view name;
+    Handler handler;                          ///< Native implementation
+    unsigned flags;                           ///< Flags bits
+    const ::shell_builtin* loaded = nullptr;  ///< Set instead of handler for enable -f
+};
+
+/**
+ * @brief Looks up an enabled builtin
+ * @param cmd Command name
+ * @return The builtin, or nullptr if there is none or it is disabled
+ */
+const Builtin* find_builtin(const std::string& cmd);
 
 /**
  * @brief Checks if a command is a shell builtin
@@ -17,39 +49,191 @@ extern const std::vector<std::string> builtin_list;
  */
 bool is_builtin(const std::string& cmd);
 
+/**
+ * @brief Lists the names of all enabled builtins
+ * @return Builtin names, for completion
+ */
+std::vector<std::string> builtin_names();
+
 /**
  * @brief Executes the pwd builtin command
+ * @param args Command arguments (pwd)
+ * @return Exit code
  */
-void builtin_pwd();
+int builtin_pwd(const std::vector<std::string>& args);
 
 /**
  * @brief Executes the cd builtin command
  * @param args Command arguments (cd [path])
+ * @return Exit code
  */
-void builtin_cd(const std::vector<std::string>& args);
+int builtin_cd(const std::vector<std::string>& args);
 
 /**
  * @brief Executes the echo builtin command
  * @param args Command arguments (echo [-n] [string...])
+ * @return Exit code
  */
-void builtin_echo(const std::vector<std::string>& args);
+int builtin_echo(const std::vector<std::string>& args);
 
 /**
  * @brief Executes the type builtin command
  * @param args Command arguments (type name)
+ * @return Exit code
  */
-void builtin_type(const std::vector<std::string>& args);
+int builtin_type(const std::vector<std::string>& args);
 
 /**
  * @brief Executes the history builtin command
  * @param args Command arguments (history [-c|-r|-w|-a file] [n])
+ * @return Exit code
+ */
+int builtin_history(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the shellfds builtin command (lists open descriptors)
+ * @param args Command arguments (shellfds)
+ * @return Exit code
+ */
+int builtin_shellfds(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the shellstats builtin command (runtime counters)
+ * @param args Command arguments (shellstats [--json] [--reset])
+ * @return Exit code
+ */
+int builtin_shellstats(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the source (.) builtin command
+ * @param args Command arguments (source file)
+ * @return Exit code
+ */
+int builtin_source(const std::vector<std::string>& args);
+
+/**
+ * @brief Parses the exit builtin's status argument
+ *
+ * Exiting the shell itself is handled by the executor, which saves
+ * history first; in a pipeline stage this just ends that stage.
+ *
+ * @param args Command arguments (exit [n])
+ * @return Exit code to exit with
+ */
+int builtin_exit(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the exec builtin command
+ * @param args Command arguments (exec [-cl] [-a name] [command [arg...]])
+ * @return Exit code; returns only if there is no command or it failed
+ */
+int builtin_exec(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the export builtin command
+ * @param args Command arguments (export [name[=value]...])
+ * @return Exit code (1 if a name is invalid)
+ */
+int builtin_export(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the let builtin command
+ * @param args Command arguments (let expr...)
+ * @return 0 if the last expression is non-zero, 1 otherwise
+ */
+int builtin_let(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes an arithmetic command, (( expr ))
+ * @param args Command arguments as tokenized: "((", expression, "))"
+ * @return 0 if the expression is non-zero, 1 otherwise
+ */
+int builtin_arith(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the test, [ and [[ builtin commands
+ * @param args Command arguments (test expr, [ expr ] or [[ expr ]])
+ * @return 0 if true, 1 if false, 2 on a syntax error
+ */
+int builtin_test(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the timeout builtin command
+ *
+ * At the start of a pipeline `timeout` is handled by the executor and
+ * limits every stage; this covers it appearing in a later stage.
+ *
+ * @param args Command arguments (timeout [-s SIG] [-k DURATION] DURATION cmd...)
+ * @return The command's exit code, 124 if it timed out, 125 on a usage error
+ */
+int builtin_timeout(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the coproc builtin command
+ *
+ * At the start of a command line `coproc` is handled by the executor,
+ * which hands it the whole pipeline; this covers later pipeline stages.
+ *
+ * @param args Command arguments (coproc [NAME] cmd...)
+ * @return 0 once the coprocess has started
+ */
+int builtin_coproc(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the wait builtin command (waits for coprocesses)
+ * @param args Command arguments (wait [pid...])
+ * @return Exit status of the last pid, 127 if it is not a coprocess
+ */
+int builtin_wait(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the read builtin command
+ * @param args Command arguments (read [-r] [-d delim] [-a array] [-u fd] [name...])
+ * @return Exit code (1 at end of input)
+ */
+int builtin_read(const std::vector<std::string>& args);
+
+/**
+ * @brief Executes the enable builtin command
+ * @param args Command arguments (enable [-n|-d] [name...] or
+ *             enable -f lib.so name...)
+ * @return Exit code
+ */
+int builtin_enable(const std::vector<std::string>& args);
+
+/**
+ * @brief Native cat: copies files to stdout with splice/sendfile/copy_file_range
+ * @param args Command arguments (cat [-u] [file...])
+ * @return Exit code
+ */
+int builtin_cat(const std::vector<std::string>& args);
+
+/**
+ * @brief Native head: prints the first lines or bytes of each file
+ * @param args Command arguments (head [-n N|-c N|-N] [file...])
+ * @return Exit code
+ */
+int builtin_head(const std::vector<std::string>& args);
+
+/**
+ * @brief Native tail: prints the last lines or bytes of each file
+ * @param args Command arguments (tail [-n [+]N|-c [+]N|-N] [file...])
+ * @return Exit code
+ */
+int builtin_tail(const std::vector<std::string>& args);
+
+/**
+ * @brief Native wc: counts lines, words and bytes
+ * @param args Command arguments (wc [-lwc] [file...])
+ * @return Exit code
  */
-void builtin_history(const std::vector<std::string>& args);
+int builtin_wc(const std::vector<std::string>& args);
 
 /**
  * @brief Executes a builtin command by name
  * @param args Command and its arguments
- * @return Exit code (0 for success)
+ * @return Exit code (0 for success, 2 if +batch is passed to a builtin
+ *         that is not RUNS_COMMAND)
  */
 int execute_builtin(const std::vector<std::string>& args);
 
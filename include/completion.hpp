@@ -1,34 +1,37 @@
 #ifndef COMPLETION_HPP
 #define COMPLETION_HPP
 
-#include <readline/readline.h>
+#include "lineedit.hpp"
+#include <string>
 
 namespace shell {
 namespace completion {
 
 /**
- * @brief Generator function for readline completion
- * @param text Text to complete
- * @param state State (0 for first call)
- * @return Allocated string with match, or nullptr when done
+ * @brief Completes the word at [start, end) of a line
+ *
+ * Words in command position complete to builtins, PATH executables and
+ * local files; every other word completes as a path. With
+ * COMPLETION_MODE=fuzzy, matches are fuzzy and ranked best first.
+ *
+ * @param line Line being edited
+ * @param start Start of the word in line
+ * @param end End of the word in line
+ * @return Matches for the word
  */
-char* completion_generator(const char* text, int state);
+lineedit::Completions complete(const std::string& line, size_t start, size_t end);
 
 /**
- * @brief Completion function for readline
- * @param text Text being completed
- * @param start Start position in line
- * @param end End position in line (unused)
- * @return Array of matches, or nullptr
+ * @brief Installs complete() as the line editor's completer
  */
-char** completion_function(const char* text, int start, int end);
+void init_completion();
 
 /**
- * @brief Initializes readline completion
+ * @brief Starts background scans of PATH and the current directory
  */
-void init_completion();
+void warm_up();
 
 } // namespace completion
 } // namespace shell
 
-#endif // COMPLETION_HPP
\ No newline at end of file
+#endif // COMPLETION_HPP
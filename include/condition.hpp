@@ -0,0 +1,34 @@
+#ifndef CONDITION_HPP
+#define CONDITION_HPP
+
+#include <string>
+#include <vector>
+
+namespace shell {
+namespace condition {
+
+/**
+ * @brief Evaluates a conditional command: test, [ ... ] or [[ ... ]]
+ *
+ * test and [ follow POSIX test(1): file tests (-e -f -d -r -w -x -s
+ * -L ...), string tests (-n -z = != < >), integer comparisons (-eq -ne
+ * -lt -le -gt -ge), -nt -ot -ef, and ! ( ) -a -o.
+ *
+ * [[ adds && || and grouping without quoting, glob matching for == and
+ * !=, ERE matching for =~ (capture groups go to BASH_REMATCH) and
+ * arithmetic operands for the integer comparisons. Its words come from
+ * the tokenizer with quoted characters backslash-escaped, so a quoted
+ * pattern or regex matches literally.
+ *
+ * File tests share one stat() per path within a command, and compiled
+ * regular expressions are cached by pattern.
+ *
+ * @param args Command line; args[0] is "test", "[" or "[["
+ * @return 0 if the condition holds, 1 if not, 2 on a syntax error
+ */
+int evaluate(const std::vector<std::string>& args);
+
+} // namespace condition
+} // namespace shell
+
+#endif // CONDITION_HPP
@@ -0,0 +1,60 @@
+#ifndef DIRCACHE_HPP
+#define DIRCACHE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace shell {
+namespace dircache {
+
+/// How long the completion thread waits for a directory scan to finish
+constexpr std::chrono::milliseconds SCAN_BUDGET{75};
+
+/**
+ * @brief A single directory entry
+ */
+struct Entry {
+    std::string name;
+    bool is_dir = false;
+};
+
+/**
+ * @brief Snapshot of a directory listing
+ */
+struct Listing {
+    std::vector<Entry> entries;
+    bool complete = false;  ///< false if the scan was still running
+    uint64_t version = 0;   ///< Changes whenever the entries change; unique across directories
+};
+
+/**
+ * @brief Lists a directory through the background scanner
+ *
+ * Relative paths are resolved against the current directory, so "."
+ * after cd has a listing of its own. A listing is scanned on a
+ * background thread when missing. Once it is
+ * more than a second old it is revalidated there against the directory's
+ * mtime, and rescanned if stale; a newer one is returned at once. The
+ * caller waits at most
+ * `budget`; if the scan has not finished by then the entries read so far
+ * are returned with `complete` unset.
+ *
+ * @param dir Directory path
+ * @param budget Maximum time to wait for a fresh listing
+ * @return Listing snapshot
+ */
+Listing list(const std::string& dir,
+             std::chrono::milliseconds budget = SCAN_BUDGET);
+
+/**
+ * @brief Starts scanning a directory without waiting for the result
+ * @param dir Directory path
+ */
+void prefetch(const std::string& dir);
+
+} // namespace dircache
+} // namespace shell
+
+#endif // DIRCACHE_HPP
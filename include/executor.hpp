@@ -3,11 +3,73 @@
 
 #include <string>
 #include <vector>
+#include <sys/types.h>
+#include "audit.hpp"
 #include "parser.hpp"
+#include "supervisor.hpp"
 
 namespace shell {
 namespace executor {
 
+/**
+ * @brief A running process substitution, <(cmd) or >(cmd)
+ */
+struct ProcessSubstitution {
+    pid_t pid;     ///< Process running the substituted command
+    int fd;        ///< Shell's end of the pipe, exposed as /dev/fd/N
+    size_t stage;  ///< Pipeline stage that consumes the fd
+};
+
+/**
+ * @brief Starts every process substitution found in a pipeline
+ *
+ * Only words the tokenizer flagged SUBSTITUTION run; quoted or expanded
+ * text that merely looks like <(cmd) is left alone.
+ *
+ * @param pipeline Pipeline commands (substitution tokens are replaced
+ *                 in place by their /dev/fd/N paths)
+ * @return Running substitutions, to be passed to execute_pipeline()
+ */
+std::vector<ProcessSubstitution> start_process_substitutions(
+    std::vector<parser::Tokens>& pipeline);
+
+/**
+ * @brief Starts a coprocess, as `coproc [NAME] cmd...` does
+ *
+ * The command (a whole pipeline, redirections included) runs in the
+ * background in its own process group, connected to the shell by two
+ * pipes: ${NAME[0]} reads its output and ${NAME[1]} writes to its input,
+ * as in `echo 2+2 >&${BC[1]}; read -u ${BC[0]} x`. NAME_PID holds its
+ * process ID. NAME defaults to COPROC; the first word is taken as NAME
+ * when more words follow and it is a valid name but not a command.
+ *
+ * @param tokens Output of parser::tokenize(), starting with "coproc"
+ * @return 0 once started, 1 on error, 2 on misuse
+ */
+int start_coprocess(parser::Tokens tokens);
+
+/**
+ * @brief Collects the exit status of coprocesses that have finished
+ *
+ * A finished coprocess loses NAME_PID and the shell's write end; output
+ * it left behind can still be read from ${NAME[0]} until NAME is reused.
+ * Called before every command, so nothing is left as a zombie for long.
+ *
+ * @return Number of coprocesses still running
+ */
+size_t reap_coprocesses();
+
+/**
+ * @brief Waits for coprocesses to finish, as `wait` does
+ *
+ * The shell's write end is closed first, so a coprocess that reads its
+ * input to the end sees EOF instead of waiting on the shell forever.
+ *
+ * @param pid Coprocess to wait for, or -1 for all of them
+ * @return Its exit status (0 for all), or -1 if pid is not a coprocess
+ */
+int wait_coprocess(pid_t pid);
+
 /**
  * @brief Executes a single command (handles both builtins and external)
  * @param args Command and arguments
@@ -20,18 +82,98 @@ int execute_command(const std::vector<std::string>& args,
 /**
  * @brief Executes a pipeline of commands
  * @param pipeline Vector of commands to execute in pipeline
- * @param redirections Redirections for the last command
- * @return Exit code of last command
+ * @param redirections Redirections for the last command (stdin_file
+ *                     applies to the first)
+ * @param subs Process substitutions feeding the pipeline's stages
+ * @param limits Time limit from `timeout`; the pipeline then runs in its
+ *               own process group
+ * @param record Audit record to receive per-stage details, if logging
+ * @param prefixes Each stage's NAME=value prefixes, exported for that
+ *                 stage only
+ * @return Exit code of last command (124 if the time limit expired, 137
+ *         if the pipeline had to be killed)
  */
 int execute_pipeline(std::vector<std::vector<std::string>>& pipeline,
-                     const parser::Redirections& redirections);
+                     const parser::Redirections& redirections,
+                     const std::vector<ProcessSubstitution>& subs = {},
+                     const supervisor::Limits& limits = {},
+                     audit::Record* record = nullptr,
+                     const std::vector<std::vector<std::string>>& prefixes = {});
+
+/**
+ * @brief Replaces the shell process with a command, as `exec cmd` does
+ *
+ * The audit log is flushed first, since nothing runs after a
+ * successful exec. After set_keep_process(true) the command runs in a
+ * child instead, and its exit status is returned.
+ *
+ * @param args Command and arguments
+ * @param argv0 What the command sees as argv[0] (default: args[0])
+ * @param clear_env Run the command with an empty environment
+ * @return Only on failure: 127 if the command was not found, else 126
+ */
+int exec_command(const std::vector<std::string>& args,
+                 const std::string& argv0 = "", bool clear_env = false);
 
 /**
  * @brief Main execution entry point
+ *
+ * Runs each command of a ';' list in turn.
+ *
  * @param input Raw input line
+ * @param tail The line is the last thing the shell will run (script and
+ *             -c mode), so its last simple command may be exec'd in place
+ *             of the shell instead of forked
+ * @return true to continue shell, false to exit
+ */
+bool execute(const std::string& input, bool tail = false);
+
+/**
+ * @brief Executes one already tokenized command
+ * @param tokens Output of parser::tokenize()
+ * @param tail Exec the command in place of the shell if it is a simple
+ *             external command (see execute())
  * @return true to continue shell, false to exit
  */
-bool execute(const std::string& input);
+bool execute_tokens(const parser::Tokens& tokens, bool tail = false);
+
+/**
+ * @brief Sets what `exit` does after saving history, instead of exiting
+ *
+ * Server mode uses this to answer the request before its worker ends.
+ * The process still exits if the handler returns. Forked children that
+ * run shell commands drop the handler and skip the history save.
+ *
+ * @param handler Called with the exit status, or nullptr for plain exit()
+ */
+void set_exit_handler(void (*handler)(int status));
+
+/**
+ * @brief Sets whether the shell keeps going after a failed `exec`
+ *
+ * Interactive shells report the error and continue; scripts and -c exit
+ * with its status (127 if the command was not found, else 126). They
+ * also exit, with status 1, when a line fails to tokenize or expand.
+ *
+ * @param value false for script and -c mode
+ */
+void set_interactive(bool value);
+
+/**
+ * @brief Makes `exec cmd` fork and wait instead of replacing the process
+ *
+ * Server mode uses this so a request's worker survives to send the
+ * command's status.
+ *
+ * @param value true to keep the process
+ */
+void set_keep_process(bool value);
+
+/**
+ * @brief Gets the exit status of the most recently executed command line
+ * @return Exit status (128 + signal number if killed by a signal)
+ */
+int last_status();
 
 } // namespace executor
 } // namespace shell
@@ -0,0 +1,75 @@
+#ifndef FDTABLE_HPP
+#define FDTABLE_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+namespace shell {
+namespace fdtable {
+
+/// Lowest descriptor used for shell-internal fds; 0-9 stay free for users
+constexpr int FD_BASE = 10;
+
+/**
+ * @brief Moves a descriptor into the shell-internal range and registers it
+ * @param fd Descriptor to adopt (closed on success)
+ * @param label Human-readable owner shown by dump()
+ * @return New close-on-exec descriptor >= FD_BASE, or -1 on error
+ */
+int adopt(int fd, const std::string& label);
+
+/**
+ * @brief Duplicates a descriptor into the shell-internal range
+ * @param fd Descriptor to duplicate (left open)
+ * @param label Human-readable owner shown by dump()
+ * @return New close-on-exec descriptor >= FD_BASE, or -1 on error
+ */
+int duplicate(int fd, const std::string& label);
+
+/**
+ * @brief Opens a file as a shell-internal descriptor
+ * @param path File to open
+ * @param flags open() flags (O_CLOEXEC is added)
+ * @param mode Creation mode
+ * @param label Human-readable owner shown by dump()
+ * @return Close-on-exec descriptor >= FD_BASE, or -1 on error
+ */
+int open_file(const std::string& path, int flags, mode_t mode,
+              const std::string& label);
+
+/**
+ * @brief Creates a pipe whose ends are shell-internal descriptors
+ * @param fds Receives the read and write ends
+ * @param label Human-readable owner shown by dump()
+ * @return true on success
+ */
+bool make_pipe(int fds[2], const std::string& label);
+
+/**
+ * @brief Closes a shell-internal descriptor and drops it from the table
+ * @param fd Descriptor to release (ignored if negative)
+ */
+void release(int fd);
+
+/**
+ * @brief Prepares a freshly forked child for running a command
+ *
+ * Closes every shell-internal descriptor except those in `keep`, which
+ * also lose FD_CLOEXEC so they survive the upcoming exec.
+ *
+ * @param keep Descriptors the child's command must inherit
+ */
+void prepare_child(const std::vector<int>& keep = {});
+
+/**
+ * @brief Writes a listing of the process's open descriptors
+ * @param out Stream to write to
+ */
+void dump(std::ostream& out);
+
+} // namespace fdtable
+} // namespace shell
+
+#endif // FDTABLE_HPP
@@ -0,0 +1,80 @@
+#ifndef FUZZY_HPP
+#define FUZZY_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace shell {
+namespace fuzzy {
+
+/**
+ * @brief Computes a case-insensitive character-presence mask
+ *
+ * Letters and digits get a bit each; other characters share the rest.
+ * If a pattern's mask is not a subset of a candidate's mask, the pattern
+ * cannot be a subsequence of the candidate.
+ *
+ * @param s String to summarize
+ * @return 64-bit presence mask
+ */
+uint64_t char_mask(const std::string& s);
+
+/**
+ * @brief Scores a pattern as a subsequence of a candidate (fzf-style)
+ *
+ * Matches at word boundaries, camelCase humps and consecutive runs score
+ * higher; gaps are penalized. Matching is case-insensitive unless the
+ * pattern contains an uppercase letter.
+ *
+ * @param pattern Pattern typed by the user
+ * @param candidate Candidate string
+ * @param score Receives the score when the pattern matches
+ * @return true if the pattern is a subsequence of the candidate
+ */
+bool score(const std::string& pattern, const std::string& candidate, int& score);
+
+/**
+ * @brief A scored candidate
+ */
+struct Match {
+    uint32_t index;  ///< Index into the candidate set
+    int score;
+};
+
+/**
+ * @brief Candidate strings with precomputed masks for repeated filtering
+ */
+class CandidateSet {
+public:
+    /**
+     * @brief Replaces the candidates and recomputes their masks
+     * @param items Candidate strings
+     */
+    void assign(std::vector<std::string> items);
+
+    const std::vector<std::string>& items() const { return items_; }
+
+    /**
+     * @brief Collects candidates whose masks cover a pattern mask
+     * @param pattern_mask Mask from char_mask()
+     * @param out Receives indices of surviving candidates
+     */
+    void prefilter(uint64_t pattern_mask, std::vector<uint32_t>& out) const;
+
+    /**
+     * @brief Prefilters and scores every candidate against a pattern
+     * @param pattern Pattern typed by the user
+     * @return Matching candidates, unordered
+     */
+    std::vector<Match> match(const std::string& pattern) const;
+
+private:
+    std::vector<std::string> items_;
+    std::vector<uint64_t> masks_;
+};
+
+} // namespace fuzzy
+} // namespace shell
+
+#endif // FUZZY_HPP
@@ -15,10 +15,18 @@ constexpr int MAX_HISTORY_SIZE = 1000;
 void init_history_file();
 
 /**
- * @brief Loads history from file into readline history
+ * @brief Starts loading the history file on a background thread
  */
 void load_history();
 
+/**
+ * @brief Merges the loaded history into readline, waiting if necessary
+ *
+ * Must run before anything reads or appends to readline's history. Does
+ * nothing once the history has been merged.
+ */
+void ensure_history_loaded();
+
 /**
  * @brief Saves current history to file
  */
@@ -0,0 +1,97 @@
+#ifndef LINEEDIT_HPP
+#define LINEEDIT_HPP
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace shell {
+namespace lineedit {
+
+/// Prompt text between these markers takes no room on screen (colours)
+constexpr char PROMPT_START_IGNORE = '\001';
+constexpr char PROMPT_END_IGNORE = '\002';
+
+/**
+ * @brief Matches offered for the word being completed
+ */
+struct Completions {
+    std::vector<std::string> matches;  ///< Replacements for the whole word
+    bool ranked = false;               ///< Already best first; do not sort
+    bool filenames = false;            ///< Paths: mark directories with '/'
+};
+
+/**
+ * @brief Produces the matches for the word at [start, end) of a line
+ */
+using Completer = Completions (*)(const std::string& line, size_t start, size_t end);
+
+/**
+ * @brief Returns the rest of a past command line that starts with the
+ *        given line, or "" for none
+ */
+using Suggester = std::string (*)(const std::string& line);
+
+/**
+ * @brief Runs while the editor waits for a key
+ *
+ * Sets prompt and returns true to have the prompt redrawn.
+ */
+using IdleHook = bool (*)(std::string& prompt);
+
+/**
+ * @brief Prepares the line editor; call once before read_line()
+ *
+ * The shell is built with either GNU readline (SHELL_WITH_READLINE, the
+ * default) or a built-in editor that puts the terminal in raw mode only
+ * while a line is read. Both merge the background history load when the
+ * first key arrives.
+ */
+void init();
+
+/**
+ * @brief Reads one line from the user
+ * @param prompt Prompt to show, possibly spanning several lines
+ * @param line Receives the line, without its newline
+ * @return false at end of input (Ctrl-D on an empty line)
+ */
+bool read_line(const std::string& prompt, std::string& line);
+
+/**
+ * @brief Sets the function that Tab completion asks for matches
+ * @param completer Completion source
+ */
+void set_completer(Completer completer);
+
+/**
+ * @brief Sets where inline suggestions come from
+ *
+ * The rest of the suggested line is drawn greyed out after the cursor
+ * when it sits at the end of the line. Right arrow, Ctrl-F, End or
+ * Ctrl-E accept it and Alt-F accepts its next word.
+ *
+ * @param suggester Suggestion source
+ */
+void set_suggester(Suggester suggester);
+
+/**
+ * @brief Runs a hook every `interval` while waiting for input
+ * @param hook Hook to run, or nullptr to stop (also from within the hook)
+ * @param interval Time between runs
+ */
+void set_idle_hook(IdleHook hook,
+                   std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+
+/**
+ * @brief Prints a note under the line being edited, then redraws it
+ *
+ * Meant for use from within a completer.
+ *
+ * @param text Note to print
+ */
+void show_message(const std::string& text);
+
+} // namespace lineedit
+} // namespace shell
+
+#endif // LINEEDIT_HPP
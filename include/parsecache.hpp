@@ -0,0 +1,72 @@
+#ifndef PARSECACHE_HPP
+#define PARSECACHE_HPP
+
+#include "parser.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace shell {
+namespace parsecache {
+
+/**
+ * @brief One command line of a script
+ *
+ * Lines whose tokens depend on shell state (variable expansions) cannot
+ * be tokenized ahead of time; they keep their text and are tokenized
+ * each time they run.
+ */
+struct ParsedLine {
+    bool dynamic = false;             ///< Tokenize `text` at run time
+    std::string text;                 ///< Raw line (dynamic lines only)
+    parser::Tokens tokens;            ///< Tokens (static lines only)
+};
+
+/// Tokenized script, one entry per command line
+using ParsedScript = std::vector<ParsedLine>;
+
+/**
+ * @brief Identifies one version of a script file
+ */
+struct FileKey {
+    int64_t mtime_sec = 0;
+    int64_t mtime_nsec = 0;
+    uint64_t size = 0;
+    uint64_t content_hash = 0;
+};
+
+/**
+ * @brief Hashes file contents for use in a FileKey (64-bit FNV-1a)
+ * @param data File contents
+ * @return Content hash
+ */
+uint64_t hash_content(const std::string& data);
+
+/**
+ * @brief Gets the directory holding cached parses
+ * @return $XDG_CACHE_HOME/myshell or ~/.cache/myshell, empty if neither
+ */
+std::string cache_dir();
+
+/**
+ * @brief Loads a cached parse of a script
+ * @param path Script path (as given to source)
+ * @param key Current identity of the script
+ * @param out Receives the parsed lines on a hit
+ * @return true on a cache hit whose key matches exactly
+ */
+bool load(const std::string& path, const FileKey& key, ParsedScript& out);
+
+/**
+ * @brief Stores a parse of a script, replacing any previous entry
+ * @param path Script path (as given to source)
+ * @param key Identity of the script that was parsed
+ * @param script Parsed lines
+ */
+void store(const std::string& path, const FileKey& key,
+           const ParsedScript& script);
+
+} // namespace parsecache
+} // namespace shell
+
+#endif // PARSECACHE_HPP
@@ -7,36 +7,110 @@
 namespace shell {
 namespace parser {
 
+/// What a token was typed as. Quoted text and expanded values never
+/// carry a flag, so a quoted '|' or a variable holding "<(cmd)" stays
+/// an ordinary word.
+enum TokenFlags : unsigned {
+    PLAIN = 0,
+    /// A '|', or a redirection operator (see extract_redirections()),
+    /// typed unquoted
+    OPERATOR = 1u << 0,
+    /// A process substitution, <(cmd) or >(cmd), typed unquoted
+    SUBSTITUTION = 1u << 1,
+};
+
+/**
+ * @brief Words of a command line, each with its TokenFlags
+ */
+struct Tokens {
+    std::vector<std::string> words;
+    std::vector<unsigned> flags;  ///< One entry per word
+    bool error = false;           ///< Tokenizing failed; the error is reported
+
+    bool empty() const { return words.empty(); }
+};
+
+/**
+ * @brief Tokenizes input string handling quotes, escapes and expansions
+ *
+ * $name, ${name}, ${name[i]}, ${name[@]}, ${#name}, $?, $$, $#, $@ and
+ * the positional parameters $0-$9 and ${N} are expanded outside single
+ * quotes. Expanded values are not split further.
+ *
+ * Unquoted braces then expand a word into several: a{b,c}d gives abd
+ * acd, and {1..10}, {01..10..3} and {a..z} give sequences, zero-padded
+ * when an end point has a leading zero. Braces that come from a
+ * parameter's value do not expand, but {1..$n} does.
+ *
+ * @param input Raw input string
+ * @return Tokens; on a parse or expansion error, none with `error` set
+ */
+Tokens tokenize(const std::string& input);
+
 /**
- * @brief Tokenizes input string handling quotes and escapes
+ * @brief Splits a command line into the commands of a ';' list
+ *
+ * Each command is tokenized only when its turn comes, so `x=1; echo $x`
+ * sees the new value. Quoted and bracketed ';' (as in <(a; b)) stay put.
+ *
  * @param input Raw input string
- * @return Vector of tokens, empty if parse error
+ * @return Commands in order, without blank ones
  */
-std::vector<std::string> tokenize(const std::string& input);
+std::vector<std::string> split_commands(const std::string& input);
 
 /**
- * @brief Splits tokens into pipeline commands
+ * @brief Checks whether tokenizing a line depends on shell state
+ * @param input Raw input string
+ * @return true if the line contains a '$' outside single quotes
+ */
+bool has_expansions(const std::string& input);
+
+/**
+ * @brief Splits tokens into pipeline commands at each unquoted '|'
  * @param tokens Tokenized input
- * @return Vector of commands (each command is a vector of arguments)
+ * @return Vector of commands, each with its own words and flags
  */
-std::vector<std::vector<std::string>> split_pipeline(const std::vector<std::string>& tokens);
+std::vector<Tokens> split_pipeline(const Tokens& tokens);
 
 /**
  * @brief Structure to hold redirection information
+ *
+ * The *_fd fields come from `>&N`, `2>&N` and `<&N`, which make the
+ * stream a copy of descriptor N. They are applied after the files.
  */
 struct Redirections {
+    std::string stdin_file;
     std::string stdout_file;
     std::string stderr_file;
     bool stdout_append = false;
     bool stderr_append = false;
+    int stdin_fd = -1;   ///< Descriptor to duplicate onto stdin, or -1
+    int stdout_fd = -1;  ///< Descriptor to duplicate onto stdout, or -1
+    int stderr_fd = -1;  ///< Descriptor to duplicate onto stderr, or -1
 };
 
 /**
  * @brief Extracts redirections from command arguments
- * @param args Command arguments (modified to remove redirection tokens)
+ *
+ * Understands > >> 1> 1>> 2> 2>> < 0< followed by a file, and the
+ * attached forms >&N 1>&N 2>&N <&N 0<&N. Only words flagged OPERATOR
+ * count. A later redirection of the same stream replaces an earlier one.
+ *
+ * @param command Command words (modified to remove redirection tokens)
  * @return Redirection information
  */
-Redirections extract_redirections(std::vector<std::string>& args);
+Redirections extract_redirections(Tokens& command);
+
+/**
+ * @brief Extracts an input redirection (< file or <&N) from command arguments
+ *
+ * Used for the first stage of a pipeline, whose stdin is the only one
+ * not fed by a pipe.
+ *
+ * @param command Command words (modified to remove the redirection)
+ * @param redir Receives stdin_file or stdin_fd
+ */
+void extract_input_redirection(Tokens& command, Redirections& redir);
 
 } // namespace parser
 } // namespace shell
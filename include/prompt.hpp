@@ -0,0 +1,41 @@
+#ifndef PROMPT_HPP
+#define PROMPT_HPP
+
+#include <chrono>
+#include <string>
+
+namespace shell {
+namespace prompt {
+
+/**
+ * @brief Renders PS1 for the next line read
+ *
+ * PS1 (default "$ ") understands these escapes:
+ *   \w  working directory (~ for $HOME)   \W  its last component
+ *   \u  user name                         \h  host name up to the first '.'
+ *   \H  full host name                    \$  '#' for root, '$' otherwise
+ *   \?  exit status of the last command   \C  duration of the last command
+ *   \j  number of running coprocesses      \n  newline
+ *   \e  escape (for colours)              \a  bell
+ *   \[ \]  bracket non-printing sequences \\  backslash
+ *   \{name}  output of the segment command in $PROMPT_SEGMENT_name
+ *
+ * Segment commands run in the background through /bin/sh. The prompt
+ * shows their last output for the current directory (or a placeholder)
+ * and is redrawn when fresh output arrives. A segment running longer
+ * than PROMPT_SEGMENT_TIMEOUT milliseconds (default 2000) is killed.
+ *
+ * @return Prompt string, with \[ \] turned into the editor's markers
+ */
+std::string begin();
+
+/**
+ * @brief Records how long the last command line took, for \C
+ * @param elapsed Wall-clock time spent executing it
+ */
+void command_finished(std::chrono::steady_clock::duration elapsed);
+
+} // namespace prompt
+} // namespace shell
+
+#endif // PROMPT_HPP
@@ -0,0 +1,76 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace shell {
+namespace protocol {
+
+/// Frame magic ("MSH1"); rejects peers speaking anything else
+constexpr uint32_t MAGIC = 0x3148534d;
+
+/// Largest request body accepted, guarding against garbage lengths
+constexpr uint32_t MAX_BODY = 16 * 1024 * 1024;
+
+/**
+ * @brief A command to run on the server
+ *
+ * The client's stdin, stdout and stderr travel alongside the frame as
+ * SCM_RIGHTS ancillary data, so the command reads and writes them
+ * directly with no copying through the socket.
+ */
+struct Request {
+    std::string command;            ///< Command line, as typed at a prompt
+    std::string cwd;                ///< Working directory for the command
+    std::vector<std::string> env;   ///< Complete environment, NAME=value
+    int fds[3] = {-1, -1, -1};      ///< stdin, stdout, stderr
+};
+
+/**
+ * @brief Outcome of a request
+ */
+struct Response {
+    int32_t status = 0;     ///< Exit status of the command line
+    uint64_t wall_ns = 0;   ///< Wall-clock time spent running it
+    uint64_t user_us = 0;   ///< User CPU time, including children
+    uint64_t sys_us = 0;    ///< System CPU time, including children
+};
+
+/**
+ * @brief Sends a request frame with its three descriptors
+ * @param sock Connected Unix stream socket
+ * @param req Request to send
+ * @return true on success
+ */
+bool send_request(int sock, const Request& req);
+
+/**
+ * @brief Receives a request frame (blocking)
+ * @param sock Connected Unix stream socket
+ * @param req Receives the request; its fds are owned by the caller
+ * @return true on success, false on EOF or a malformed frame
+ */
+bool recv_request(int sock, Request& req);
+
+/**
+ * @brief Sends a response frame
+ * @param sock Connected Unix stream socket
+ * @param resp Response to send
+ * @return true on success
+ */
+bool send_response(int sock, const Response& resp);
+
+/**
+ * @brief Receives a response frame (blocking)
+ * @param sock Connected Unix stream socket
+ * @param resp Receives the response
+ * @return true on success, false on EOF or a malformed frame
+ */
+bool recv_response(int sock, Response& resp);
+
+} // namespace protocol
+} // namespace shell
+
+#endif // PROTOCOL_HPP
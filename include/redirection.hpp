@@ -11,9 +11,36 @@ namespace redirection {
  * @param fd File descriptor to redirect (e.g., STDOUT_FILENO)
  * @param file Target file path
  * @param append Whether to append instead of truncate
+ * @param input Open the file for reading instead (append is ignored)
  * @return Saved file descriptor for restoration, or -1 on error/skip
  */
-int redirect_fd(int fd, const std::string& file, bool append);
+int redirect_fd(int fd, const std::string& file, bool append, bool input = false);
+
+/**
+ * @brief Makes a file descriptor a copy of another, as `N>&M` does
+ * @param fd File descriptor to redirect
+ * @param source Descriptor to duplicate onto fd
+ * @return Saved file descriptor for restoration, or -1 on error
+ */
+int redirect_dup(int fd, int source);
+
+/**
+ * @brief Redirects a file descriptor to a file for good, as `exec > file` does
+ * @param fd File descriptor to redirect
+ * @param file Target file path (nothing happens if empty)
+ * @param append Whether to append instead of truncate
+ * @param input Open the file for reading instead
+ * @return false if the file could not be opened
+ */
+bool replace_fd(int fd, const std::string& file, bool append, bool input = false);
+
+/**
+ * @brief Makes a file descriptor a copy of another for good
+ * @param fd File descriptor to redirect
+ * @param source Descriptor to duplicate (nothing happens if negative)
+ * @return false if source is not open
+ */
+bool replace_dup(int fd, int source);
 
 /**
  * @brief Restores a file descriptor from saved state
@@ -27,18 +54,20 @@ void restore_fd(int fd, int saved);
  */
 class RedirectGuard {
 public:
-    RedirectGuard(int fd, const std::string& file, bool append);
+    RedirectGuard(int fd, const std::string& file, bool append, bool input = false);
+    /// Duplicates source onto fd instead; nothing happens if source is negative
+    RedirectGuard(int fd, int source);
     ~RedirectGuard();
     
     RedirectGuard(const RedirectGuard&) = delete;
     RedirectGuard& operator=(const RedirectGuard&) = delete;
     
-    bool is_valid() const { return saved_fd_ >= 0 || file_.empty(); }
+    bool is_valid() const { return saved_fd_ >= 0 || !requested_; }
 
 private:
     int fd_;
     int saved_fd_;
-    std::string file_;
+    bool requested_;
 };
 
 } // namespace redirection
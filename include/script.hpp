@@ -0,0 +1,44 @@
+#ifndef SCRIPT_HPP
+#define SCRIPT_HPP
+
+#include <string>
+
+namespace shell {
+namespace script {
+
+/**
+ * @brief Runs every command line of a file in the current shell
+ *
+ * Blank lines and lines starting with '#' are skipped. Tokenized lines are
+ * cached on disk (see parsecache) and reused while the file is unchanged.
+ *
+ * @param path File to read
+ * @param tail Let the file's last command replace the shell (see
+ *             executor::execute())
+ * @return 0 on success, 1 if the file could not be read or parsed
+ */
+int source_file(const std::string& path, bool tail = false);
+
+/**
+ * @brief Runs a script non-interactively: `shell file [args...]`
+ * @param path Script file
+ * @return Exit status of its last command, 127 if it cannot be read
+ */
+int run_file(const std::string& path);
+
+/**
+ * @brief Runs a command string non-interactively: `shell -c 'commands'`
+ * @param text Command line, possibly a ';' list
+ * @return Exit status of its last command
+ */
+int run_command(const std::string& text);
+
+/**
+ * @brief Sources ~/.myshellrc if it exists
+ */
+void load_rc();
+
+} // namespace script
+} // namespace shell
+
+#endif // SCRIPT_HPP
@@ -0,0 +1,31 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <string>
+
+namespace shell {
+namespace server {
+
+/// Most connections served at once; further clients wait in the backlog
+constexpr int MAX_WORKERS = 64;
+
+/**
+ * @brief Serves command requests on a Unix socket until SIGINT/SIGTERM
+ *
+ * Each connection is handed to a forked worker that runs its requests
+ * through executor::execute() with the client's cwd, environment and
+ * stdio (see protocol.hpp). Other shell state (shell variables, `enable`
+ * changes, coprocesses) carries over from one request to the next on
+ * the same connection. `exit N` answers its request with status N and
+ * closes the connection; `exec cmd` runs cmd in a child and answers
+ * with its status.
+ *
+ * @param socket_path Filesystem path to listen on (replaced if present)
+ * @return Process exit code
+ */
+int serve(const std::string& socket_path);
+
+} // namespace server
+} // namespace shell
+
+#endif // SERVER_HPP
@@ -0,0 +1,51 @@
+/*
+ * Stable C ABI for loadable builtins (enable -f lib.so name).
+ *
+ * A shared object providing the builtin NAME exports a
+ *
+ *     struct shell_builtin NAME_builtin = {
+ *         SHELL_BUILTIN_ABI_VERSION, 0, "NAME", NAME_main, "NAME [args]"
+ *     };
+ *
+ * run() is called in the shell process (or a pipeline child) with the
+ * command's argv; stdin, stdout and stderr are already redirected, and
+ * exported variables are visible through getenv(). Its return value is
+ * the command's exit status. Anything written through stdio is flushed
+ * by the shell after run() returns.
+ *
+ * Build with e.g.: cc -shared -fPIC -o NAME.so NAME.c
+ */
+
+#ifndef SHELL_BUILTIN_H
+#define SHELL_BUILTIN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped on any incompatible change to struct shell_builtin. */
+#define SHELL_BUILTIN_ABI_VERSION 1u
+
+/* Suffix of the exported descriptor symbol: NAME_builtin. */
+#define SHELL_BUILTIN_SYMBOL_SUFFIX "_builtin"
+
+/* run() may be called in the shell process as the last stage of a
+ * pipeline instead of in a forked child. Only set this if run() leaves
+ * no state behind (open files, signal handlers, environment changes). */
+#define SHELL_BUILTIN_NOFORK_LAST 0x1u
+
+struct shell_builtin {
+    uint32_t abi_version;                    /* SHELL_BUILTIN_ABI_VERSION */
+    uint32_t flags;                          /* SHELL_BUILTIN_* flags */
+    const char *name;                        /* Command name */
+    int (*run)(int argc, char *const argv[]);
+    const char *usage;                       /* One-line usage, may be NULL */
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHELL_BUILTIN_H */
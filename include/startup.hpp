@@ -0,0 +1,59 @@
+#ifndef STARTUP_HPP
+#define STARTUP_HPP
+
+#include <chrono>
+
+namespace shell {
+namespace startup {
+
+/**
+ * @brief Turns on per-phase startup timing (--startup-profile)
+ */
+void enable_profile();
+
+/**
+ * @brief Checks whether startup timing is enabled
+ * @return true if phases are being recorded
+ */
+bool profiling();
+
+/**
+ * @brief Records the time spent in an init phase
+ * @param name Phase name
+ * @param elapsed Time spent
+ * @param background Whether the phase ran off the main thread
+ */
+void record(const char* name, std::chrono::steady_clock::duration elapsed,
+            bool background);
+
+/**
+ * @brief Records the moment the first prompt is about to be shown
+ */
+void mark_first_prompt();
+
+/**
+ * @brief Prints the startup profile to stderr (once, if enabled)
+ */
+void report();
+
+/**
+ * @brief RAII timer that records an init phase when it goes out of scope
+ */
+class Phase {
+public:
+    explicit Phase(const char* name, bool background = false);
+    ~Phase();
+
+    Phase(const Phase&) = delete;
+    Phase& operator=(const Phase&) = delete;
+
+private:
+    const char* name_;
+    bool background_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace startup
+} // namespace shell
+
+#endif // STARTUP_HPP
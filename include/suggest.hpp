@@ -0,0 +1,39 @@
+#ifndef SUGGEST_HPP
+#define SUGGEST_HPP
+
+#include <string>
+
+namespace shell {
+namespace suggest {
+
+/**
+ * @brief Starts loading the suggestion index and hooks it into the line editor
+ *
+ * As the user types, the most "frecent" past command starting with the
+ * line so far is shown greyed out after the cursor; Right arrow, Ctrl-F
+ * or End accept it, and Alt-F accepts its next word. Commands are ranked
+ * by an exponentially decaying use count (half-life three days), with
+ * uses in the current directory counting extra.
+ *
+ * The index lives in <HISTFILE>.frecency and is read on a background
+ * thread; until it arrives the editor simply shows no suggestion.
+ * Set AUTOSUGGEST=off to hide suggestions. Call after
+ * history::init_history_file().
+ */
+void init();
+
+/**
+ * @brief Records a command line entered in the current directory
+ * @param line Command line as typed
+ */
+void record(const std::string& line);
+
+/**
+ * @brief Writes the index to <HISTFILE>.frecency, waiting for it to load
+ */
+void save();
+
+} // namespace suggest
+} // namespace shell
+
+#endif // SUGGEST_HPP
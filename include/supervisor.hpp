@@ -0,0 +1,88 @@
+#ifndef SUPERVISOR_HPP
+#define SUPERVISOR_HPP
+
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/types.h>
+
+namespace shell {
+namespace supervisor {
+
+/**
+ * @brief Time limit placed on a pipeline by `timeout`
+ */
+struct Limits {
+    /// Limit on the pipeline's run time; zero means none
+    std::chrono::nanoseconds duration{0};
+    /// Signal sent to the pipeline's process group when the limit expires
+    int signal = SIGTERM;
+    /// Grace period before escalating to SIGKILL; zero means never
+    std::chrono::nanoseconds kill_after{std::chrono::seconds(5)};
+};
+
+/**
+ * @brief Outcome of waiting for a pipeline
+ */
+struct Outcome {
+    std::vector<int> statuses;  ///< waitpid() status of each process, in order
+    std::vector<rusage> usage;  ///< Resources each process used, from wait4()
+    bool timed_out = false;     ///< The time limit expired
+    bool killed = false;        ///< The pipeline had to be sent SIGKILL
+};
+
+/**
+ * @brief Parses the options of `timeout [-s SIG] [-k DURATION] DURATION cmd...`
+ *
+ * Options may also follow DURATION. Durations are decimal seconds with an
+ * optional s, m, h or d suffix.
+ *
+ * @param args Command words; args[0] == "timeout"
+ * @param limits Receives the parsed limits
+ * @return Index of the command word, or -1 after printing an error
+ */
+int parse_timeout(const std::vector<std::string>& args, Limits& limits);
+
+/**
+ * @brief Checks whether the shell is in the foreground of a terminal on stdin
+ * @return true if pipelines it starts may be handed the terminal
+ */
+bool owns_terminal();
+
+/**
+ * @brief Moves a freshly forked child into a pipeline's process group
+ *
+ * Called in the child; the parent calls setpgid() too, so either order
+ * of scheduling works.
+ *
+ * @param pgid Group to join, or 0 to lead a new one
+ * @param foreground Also make the group the terminal's foreground group
+ */
+void join_group(pid_t pgid, bool foreground);
+
+/**
+ * @brief Makes the shell's own process group the terminal's foreground group again
+ */
+void reclaim_terminal();
+
+/**
+ * @brief Waits for a set of children, enforcing an optional time limit
+ *
+ * Each child is watched through a pidfd in an epoll set, together with a
+ * timerfd for the limit. When the limit expires, limits.signal and then
+ * (after limits.kill_after) SIGKILL go to the process group `pgid`.
+ *
+ * @param pids Children to wait for (non-positive entries are skipped)
+ * @param pgid Process group holding the children; required with a limit
+ * @param limits Time limit, if any
+ * @return The children's statuses and whether the limit fired
+ */
+Outcome supervise(const std::vector<pid_t>& pids, pid_t pgid,
+                  const Limits& limits = {});
+
+} // namespace supervisor
+} // namespace shell
+
+#endif // SUPERVISOR_HPP
@@ -0,0 +1,165 @@
+#ifndef VARIABLES_HPP
+#define VARIABLES_HPP
+
+#include <string>
+#include <vector>
+
+namespace shell {
+namespace variables {
+
+/**
+ * @brief Checks whether a string is a valid variable name
+ * @param name Candidate name ([A-Za-z_][A-Za-z0-9_]*)
+ * @return true if valid
+ */
+bool is_valid_name(const std::string& name);
+
+/**
+ * @brief Checks whether a variable is set (as a shell or environment variable)
+ * @param name Variable name
+ * @return true if set
+ */
+bool is_set(const std::string& name);
+
+/**
+ * @brief Gets a variable's value
+ *
+ * Shell variables shadow the environment. For arrays this is element 0.
+ * The special parameters $?, $$, $# and the positional parameters $0,
+ * $1, ... are also resolved here.
+ *
+ * @param name Variable name
+ * @return Value, or an empty string if unset
+ */
+std::string get(const std::string& name);
+
+/**
+ * @brief Gets one element of an array variable
+ * @param name Variable name
+ * @param index Element index
+ * @return Element value, or an empty string if unset
+ */
+std::string get_element(const std::string& name, size_t index);
+
+/**
+ * @brief Gets every element of a variable
+ * @param name Variable name; "@" or "*" for the positional parameters
+ * @return Elements (a scalar has one, an unset variable none)
+ */
+std::vector<std::string> get_all(const std::string& name);
+
+/**
+ * @brief Sets the positional parameters
+ * @param args $0 followed by $1, $2, ...
+ */
+void set_positional(std::vector<std::string> args);
+
+/**
+ * @brief Sets a scalar variable
+ *
+ * Variables inherited from the environment or marked with export_name()
+ * stay exported, so commands started afterwards see the new value.
+ *
+ * @param name Variable name
+ * @param value New value
+ */
+void set(const std::string& name, const std::string& value);
+
+/**
+ * @brief Sets one element of an array variable, growing it if needed
+ * @param name Variable name
+ * @param index Element index
+ * @param value New value
+ */
+void set_element(const std::string& name, size_t index, const std::string& value);
+
+/**
+ * @brief Replaces a variable with an array
+ * @param name Variable name
+ * @param values New elements
+ */
+void set_array(const std::string& name, std::vector<std::string> values);
+
+/**
+ * @brief Removes a variable (and its environment entry)
+ * @param name Variable name
+ */
+void unset(const std::string& name);
+
+/**
+ * @brief Exports a variable, as `export NAME` does
+ *
+ * A set variable enters the environment now; an unset one when it is
+ * first assigned.
+ *
+ * @param name Variable name
+ */
+void export_name(const std::string& name);
+
+/**
+ * @brief Counts the NAME=value words that prefix a command
+ *
+ * Array and subscripted assignments never count, so a command made of
+ * those still goes to assign().
+ *
+ * @param words Command words
+ * @return Number of leading NAME=value words
+ */
+size_t prefix_length(const std::vector<std::string>& words);
+
+/**
+ * @brief RAII wrapper giving one command its NAME=value prefixes
+ *
+ * The values are exported, and shadow shell variables of the same name,
+ * until the guard goes out of scope.
+ */
+class PrefixGuard {
+public:
+    /// Applies words, each a plain NAME=value
+    explicit PrefixGuard(const std::vector<std::string>& words);
+    ~PrefixGuard();
+
+    PrefixGuard(const PrefixGuard&) = delete;
+    PrefixGuard& operator=(const PrefixGuard&) = delete;
+
+private:
+    struct Saved {
+        std::string name;
+        bool had_var;
+        std::vector<std::string> var;
+        bool had_env;
+        std::string env;
+    };
+    std::vector<Saved> saved_;
+};
+
+/**
+ * @brief Evaluates an array subscript
+ * @param expr Subscript text, an arithmetic expression
+ * @param index Receives the index
+ * @return true if the subscript is valid
+ */
+bool resolve_index(const std::string& expr, size_t& index);
+
+/**
+ * @brief Checks whether a word is an assignment, NAME=value or NAME[i]=value
+ * @param word Command word after tokenizing
+ * @return true if the word should be treated as an assignment
+ */
+bool is_assignment(const std::string& word);
+
+/**
+ * @brief Runs a command consisting only of assignments
+ *
+ * Accepts NAME=value, NAME[i]=value and NAME=(a b c), where the array
+ * elements arrive as separate words.
+ *
+ * @param words Command words; every one must start an assignment
+ * @return Exit code (1 if a word is malformed)
+ */
+int assign(const std::vector<std::string>& words);
+
+} // namespace variables
+} // namespace shell
+
+#endif // VARIABLES_HPP
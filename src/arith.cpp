@@ -0,0 +1,563 @@
+#include "arith.hpp"
+#include "variables.hpp"
+#include <cctype>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace shell {
+namespace arith {
+
+namespace {
+
+enum class Op : uint8_t {
+    PUSH,           // push value
+    LOAD,           // push variable `name`
+    LOAD_ELEM,      // pop index, push element of `name`
+    STORE,          // store top of stack into `name` (value stays)
+    STORE_ELEM,     // pop value and index, store, push value
+    INC,            // add `value` to `name`; push the new value
+    INC_POST,       // add `value` to `name`; push the old value
+    INC_ELEM,       // as INC/INC_POST for an element, index popped first
+    INC_ELEM_POST,
+    DUP,
+    POP,
+    JUMP,           // jump to `value`
+    JUMP_IF_ZERO,   // pop; jump to `value` if zero
+    JUMP_IF_SET,    // pop; jump to `value` if non-zero
+    BOOL,           // normalise top of stack to 0 or 1
+    NEG, NOT, BNOT,
+    MUL, DIV, MOD, POW, ADD, SUB, SHL, SHR,
+    LT, LE, GT, GE, EQ, NE, BAND, BXOR, BOR,
+};
+
+struct Instr {
+    Op op;
+    uint32_t name;  // index into Program::names
+    int64_t value;
+};
+
+struct Program {
+    std::vector<Instr> code;
+    std::vector<std::string> names;
+};
+
+// Variables may hold expressions that refer to other variables.
+constexpr int MAX_DEPTH = 32;
+constexpr size_t CACHE_LIMIT = 512;
+
+std::unordered_map<std::string, Program> cache;
+
+// --- Lexer ---
+
+enum class Tok { NUM, NAME, OP, END };
+
+struct Token {
+    Tok kind;
+    std::string text;
+    int64_t value = 0;
+};
+
+const char* const OPERATORS[] = {
+    "<<=", ">>=",
+    "**", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "+=", "-=", "*=", "/=", "%=", "&=", "^=", "|=",
+    "+", "-", "*", "/", "%", "<", ">", "&", "^", "|", "!", "~",
+    "=", "?", ":", ",", "(", ")", "[", "]",
+};
+
+// Parses an integer constant: decimal, 0x hex or 0 octal.
+bool parse_number(const std::string& text, int64_t& value) {
+    size_t i = 0;
+    int base = 10;
+    if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+        base = 16;
+        i = 2;
+    } else if (text.size() > 1 && text[0] == '0') {
+        base = 8;
+        i = 1;
+    }
+    if (i == text.size()) return false;
+
+    uint64_t v = 0;
+    for (; i < text.size(); ++i) {
+        int digit;
+        char c = static_cast<char>(std::tolower(static_cast<unsigned char>(text[i])));
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else {
+            return false;
+        }
+        if (digit >= base) return false;
+        v = v * static_cast<uint64_t>(base) + static_cast<uint64_t>(digit);
+    }
+    value = static_cast<int64_t>(v);
+    return true;
+}
+
+class Parser {
+public:
+    Parser(const std::string& text, Program& program)
+        : text_(text), program_(program) {
+        advance();
+    }
+
+    bool parse() {
+        expression(0);
+        if (ok_ && tok_.kind != Tok::END) {
+            fail("syntax error in expression", tok_.text);
+        }
+        return ok_;
+    }
+
+private:
+    // An operand whose load is deferred, because it may turn out to be
+    // the target of an assignment or ++/--.
+    struct Operand {
+        bool lvalue = false;
+        bool element = false;  // index already on the stack
+        uint32_t name = 0;
+    };
+
+    const std::string& text_;
+    Program& program_;
+    size_t pos_ = 0;
+    Token tok_{Tok::END, ""};
+    bool ok_ = true;
+
+    void fail(const char* message, const std::string& token) {
+        if (!ok_) return;
+        ok_ = false;
+        std::cerr << "shell: " << text_ << ": " << message;
+        if (!token.empty()) std::cerr << " (error token is \"" << token << "\")";
+        std::cerr << "\n";
+    }
+
+    void advance() {
+        while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+            ++pos_;
+        }
+        if (pos_ == text_.size()) {
+            tok_ = {Tok::END, ""};
+            return;
+        }
+
+        char c = text_[pos_];
+        if (std::isalnum(static_cast<unsigned char>(c)) || c == '_') {
+            size_t start = pos_;
+            while (pos_ < text_.size() &&
+                   (std::isalnum(static_cast<unsigned char>(text_[pos_])) || text_[pos_] == '_')) {
+                ++pos_;
+            }
+            std::string word = text_.substr(start, pos_ - start);
+            if (std::isdigit(static_cast<unsigned char>(c))) {
+                tok_ = {Tok::NUM, word};
+                if (!parse_number(word, tok_.value)) fail("invalid number", word);
+            } else {
+                tok_ = {Tok::NAME, word};
+            }
+            return;
+        }
+
+        for (const char* op : OPERATORS) {
+            size_t len = std::strlen(op);
+            if (text_.compare(pos_, len, op) == 0) {
+                tok_ = {Tok::OP, op};
+                pos_ += len;
+                return;
+            }
+        }
+        fail("syntax error: invalid arithmetic operator", std::string(1, c));
+        tok_ = {Tok::END, ""};
+    }
+
+    bool is_op(const char* op) const {
+        return tok_.kind == Tok::OP && tok_.text == op;
+    }
+
+    void expect(const char* op) {
+        if (!is_op(op)) {
+            fail(tok_.kind == Tok::END ? "syntax error: operand expected"
+                                       : "syntax error in expression",
+                 tok_.text);
+            return;
+        }
+        advance();
+    }
+
+    size_t emit(Op op, int64_t value = 0, uint32_t name = 0) {
+        program_.code.push_back({op, name, value});
+        return program_.code.size() - 1;
+    }
+
+    void patch(size_t jump) {
+        program_.code[jump].value = static_cast<int64_t>(program_.code.size());
+    }
+
+    uint32_t intern(const std::string& name) {
+        for (size_t i = 0; i < program_.names.size(); ++i) {
+            if (program_.names[i] == name) return static_cast<uint32_t>(i);
+        }
+        program_.names.push_back(name);
+        return static_cast<uint32_t>(program_.names.size() - 1);
+    }
+
+    void load(const Operand& operand) {
+        if (operand.lvalue) {
+            emit(operand.element ? Op::LOAD_ELEM : Op::LOAD, 0, operand.name);
+        }
+    }
+
+    // Left binding power of the current token as an infix operator.
+    static int binding_power(const std::string& op) {
+        static const std::unordered_map<std::string, int> powers = {
+            {",", 1},
+            {"=", 2}, {"+=", 2}, {"-=", 2}, {"*=", 2}, {"/=", 2}, {"%=", 2},
+            {"<<=", 2}, {">>=", 2}, {"&=", 2}, {"^=", 2}, {"|=", 2},
+            {"?", 3}, {"||", 4}, {"&&", 5}, {"|", 6}, {"^", 7}, {"&", 8},
+            {"==", 9}, {"!=", 9}, {"<", 10}, {"<=", 10}, {">", 10}, {">=", 10},
+            {"<<", 11}, {">>", 11}, {"+", 12}, {"-", 12},
+            {"*", 13}, {"/", 13}, {"%", 13}, {"**", 14},
+            {"++", 16}, {"--", 16},
+        };
+        auto it = powers.find(op);
+        return it == powers.end() ? 0 : it->second;
+    }
+
+    static Op binary_op(const std::string& op) {
+        static const std::unordered_map<std::string, Op> ops = {
+            {"*", Op::MUL}, {"/", Op::DIV}, {"%", Op::MOD}, {"**", Op::POW},
+            {"+", Op::ADD}, {"-", Op::SUB}, {"<<", Op::SHL}, {">>", Op::SHR},
+            {"<", Op::LT}, {"<=", Op::LE}, {">", Op::GT}, {">=", Op::GE},
+            {"==", Op::EQ}, {"!=", Op::NE}, {"&", Op::BAND}, {"^", Op::BXOR},
+            {"|", Op::BOR},
+        };
+        return ops.at(op);
+    }
+
+    void expression(int min_power) {
+        Operand left = prefix();
+        while (ok_ && tok_.kind == Tok::OP) {
+            std::string op = tok_.text;
+            int power = binding_power(op);
+            if (power <= min_power) break;
+            advance();
+            left = infix(op, power, left);
+        }
+        load(left);
+    }
+
+    Operand prefix() {
+        Operand operand;
+        if (tok_.kind == Tok::NUM) {
+            emit(Op::PUSH, tok_.value);
+            advance();
+            return operand;
+        }
+        if (tok_.kind == Tok::NAME) {
+            operand.lvalue = true;
+            operand.name = intern(tok_.text);
+            advance();
+            if (is_op("[")) {
+                advance();
+                expression(1);
+                expect("]");
+                operand.element = true;
+            }
+            return operand;
+        }
+        if (tok_.kind == Tok::END || tok_.kind != Tok::OP) {
+            fail("syntax error: operand expected", tok_.text);
+            return operand;
+        }
+
+        std::string op = tok_.text;
+        advance();
+        if (op == "(") {
+            expression(0);
+            expect(")");
+        } else if (op == "++" || op == "--") {
+            Operand target = prefix();
+            if (!target.lvalue) {
+                fail("syntax error: assignment requires a variable", op);
+                return operand;
+            }
+            emit(target.element ? Op::INC_ELEM : Op::INC, op == "++" ? 1 : -1, target.name);
+        } else if (op == "-" || op == "+" || op == "!" || op == "~") {
+            expression(15);
+            if (op == "-") emit(Op::NEG);
+            if (op == "!") emit(Op::NOT);
+            if (op == "~") emit(Op::BNOT);
+        } else {
+            fail("syntax error: operand expected", op);
+        }
+        return operand;
+    }
+
+    Operand infix(const std::string& op, int power, Operand left) {
+        Operand result;
+
+        if (op == "++" || op == "--") {
+            if (!left.lvalue) {
+                fail("syntax error in expression", op);
+                return result;
+            }
+            emit(left.element ? Op::INC_ELEM_POST : Op::INC_POST,
+                 op == "++" ? 1 : -1, left.name);
+            return result;
+        }
+
+        if (power == 2) {
+            if (!left.lvalue) {
+                fail("attempted assignment to non-variable", op);
+                return result;
+            }
+            if (op != "=") {
+                if (left.element) emit(Op::DUP);
+                load(left);
+            }
+            expression(power - 1);
+            if (op != "=") emit(binary_op(op.substr(0, op.size() - 1)));
+            emit(left.element ? Op::STORE_ELEM : Op::STORE, 0, left.name);
+            return result;
+        }
+
+        load(left);
+        if (op == ",") {
+            emit(Op::POP);
+            expression(power);
+        } else if (op == "&&" || op == "||") {
+            emit(Op::BOOL);
+            emit(Op::DUP);
+            size_t jump = emit(op == "&&" ? Op::JUMP_IF_ZERO : Op::JUMP_IF_SET);
+            emit(Op::POP);
+            expression(power);
+            emit(Op::BOOL);
+            patch(jump);
+        } else if (op == "?") {
+            size_t to_else = emit(Op::JUMP_IF_ZERO);
+            expression(0);
+            expect(":");
+            size_t to_end = emit(Op::JUMP);
+            patch(to_else);
+            expression(power - 1);
+            patch(to_end);
+        } else {
+            expression(op == "**" ? power - 1 : power);
+            emit(binary_op(op));
+        }
+        return result;
+    }
+};
+
+// --- Evaluator ---
+
+bool evaluate_at(const std::string& expr, int64_t& result, int depth);
+
+bool fail(const std::string& expr, const char* message) {
+    std::cerr << "shell: " << expr << ": " << message << "\n";
+    return false;
+}
+
+// A variable's value as a number: empty is 0, otherwise a constant or
+// an expression of its own.
+bool to_number(const std::string& text, int64_t& value, int depth) {
+    size_t first = text.find_first_not_of(" \t\n");
+    if (first == std::string::npos) {
+        value = 0;
+        return true;
+    }
+    size_t last = text.find_last_not_of(" \t\n");
+    std::string trimmed = text.substr(first, last - first + 1);
+    bool negative = trimmed[0] == '-';
+    if ((negative || trimmed[0] == '+') && parse_number(trimmed.substr(1), value)) {
+        if (negative) value = static_cast<int64_t>(0 - static_cast<uint64_t>(value));
+        return true;
+    }
+    if (parse_number(trimmed, value)) return true;
+    return evaluate_at(trimmed, value, depth + 1);
+}
+
+bool element_index(const std::string& expr, int64_t index, size_t& out) {
+    if (index < 0) return fail(expr, "bad array subscript");
+    out = static_cast<size_t>(index);
+    return true;
+}
+
+bool run(const std::string& expr, const Program& program, int64_t& result, int depth) {
+    std::vector<int64_t> stack;
+    stack.reserve(16);
+    const auto& code = program.code;
+
+    auto pop = [&stack] {
+        int64_t v = stack.back();
+        stack.pop_back();
+        return v;
+    };
+    auto wrap = [](uint64_t v) { return static_cast<int64_t>(v); };
+    auto bits = [](int64_t v) { return static_cast<uint64_t>(v); };
+
+    for (size_t pc = 0; pc < code.size(); ++pc) {
+        const Instr& in = code[pc];
+        auto name = [&]() -> const std::string& { return program.names[in.name]; };
+
+        switch (in.op) {
+        case Op::PUSH:
+            stack.push_back(in.value);
+            break;
+        case Op::LOAD: {
+            int64_t v;
+            if (!to_number(variables::get(name()), v, depth)) return false;
+            stack.push_back(v);
+            break;
+        }
+        case Op::LOAD_ELEM: {
+            size_t index;
+            int64_t v;
+            if (!element_index(expr, pop(), index) ||
+                !to_number(variables::get_element(name(), index), v, depth)) {
+                return false;
+            }
+            stack.push_back(v);
+            break;
+        }
+        case Op::STORE:
+            variables::set(name(), std::to_string(stack.back()));
+            break;
+        case Op::STORE_ELEM: {
+            int64_t v = pop();
+            size_t index;
+            if (!element_index(expr, pop(), index)) return false;
+            variables::set_element(name(), index, std::to_string(v));
+            stack.push_back(v);
+            break;
+        }
+        case Op::INC:
+        case Op::INC_POST: {
+            int64_t old;
+            if (!to_number(variables::get(name()), old, depth)) return false;
+            int64_t updated = wrap(bits(old) + bits(in.value));
+            variables::set(name(), std::to_string(updated));
+            stack.push_back(in.op == Op::INC ? updated : old);
+            break;
+        }
+        case Op::INC_ELEM:
+        case Op::INC_ELEM_POST: {
+            size_t index;
+            int64_t old;
+            if (!element_index(expr, pop(), index) ||
+                !to_number(variables::get_element(name(), index), old, depth)) {
+                return false;
+            }
+            int64_t updated = wrap(bits(old) + bits(in.value));
+            variables::set_element(name(), index, std::to_string(updated));
+            stack.push_back(in.op == Op::INC_ELEM ? updated : old);
+            break;
+        }
+        case Op::DUP:
+            stack.push_back(stack.back());
+            break;
+        case Op::POP:
+            stack.pop_back();
+            break;
+        case Op::JUMP:
+            pc = static_cast<size_t>(in.value) - 1;
+            break;
+        case Op::JUMP_IF_ZERO:
+            if (pop() == 0) pc = static_cast<size_t>(in.value) - 1;
+            break;
+        case Op::JUMP_IF_SET:
+            if (pop() != 0) pc = static_cast<size_t>(in.value) - 1;
+            break;
+        case Op::BOOL:
+            stack.back() = stack.back() != 0;
+            break;
+        case Op::NEG:
+            stack.back() = wrap(0 - bits(stack.back()));
+            break;
+        case Op::NOT:
+            stack.back() = !stack.back();
+            break;
+        case Op::BNOT:
+            stack.back() = ~stack.back();
+            break;
+        default: {
+            int64_t b = pop();
+            int64_t a = pop();
+            int64_t r = 0;
+            switch (in.op) {
+            case Op::MUL: r = wrap(bits(a) * bits(b)); break;
+            case Op::ADD: r = wrap(bits(a) + bits(b)); break;
+            case Op::SUB: r = wrap(bits(a) - bits(b)); break;
+            case Op::DIV:
+            case Op::MOD:
+                if (b == 0) return fail(expr, "division by 0");
+                if (a == std::numeric_limits<int64_t>::min() && b == -1) {
+                    r = in.op == Op::DIV ? a : 0;
+                } else {
+                    r = in.op == Op::DIV ? a / b : a % b;
+                }
+                break;
+            case Op::POW:
+                if (b < 0) return fail(expr, "exponent less than 0");
+                r = 1;
+                for (uint64_t base = bits(a), e = bits(b); e; e >>= 1) {
+                    if (e & 1) r = wrap(bits(r) * base);
+                    base *= base;
+                }
+                break;
+            case Op::SHL: r = wrap(bits(a) << (b & 63)); break;
+            case Op::SHR: r = a >> (b & 63); break;
+            case Op::LT: r = a < b; break;
+            case Op::LE: r = a <= b; break;
+            case Op::GT: r = a > b; break;
+            case Op::GE: r = a >= b; break;
+            case Op::EQ: r = a == b; break;
+            case Op::NE: r = a != b; break;
+            case Op::BAND: r = a & b; break;
+            case Op::BXOR: r = a ^ b; break;
+            case Op::BOR: r = a | b; break;
+            default: break;
+            }
+            stack.push_back(r);
+        }
+        }
+    }
+
+    result = stack.empty() ? 0 : stack.back();
+    return true;
+}
+
+bool evaluate_at(const std::string& expr, int64_t& result, int depth) {
+    if (depth > MAX_DEPTH) {
+        return fail(expr, "expression recursion level exceeded");
+    }
+    if (expr.find_first_not_of(" \t\n") == std::string::npos) {
+        result = 0;
+        return true;
+    }
+
+    auto it = cache.find(expr);
+    if (it == cache.end()) {
+        Program program;
+        if (!Parser(expr, program).parse()) return false;
+        // Only at the outermost level: a program being run must survive
+        // nested compiles (rehashing keeps references valid, clear() not).
+        if (cache.size() >= CACHE_LIMIT && depth == 0) cache.clear();
+        it = cache.emplace(expr, std::move(program)).first;
+    }
+    return run(expr, it->second, result, depth);
+}
+
+} // namespace
+
+bool evaluate(const std::string& expr, int64_t& result) {
+    return evaluate_at(expr, result, 0);
+}
+
+} // namespace arith
+} // namespace shell
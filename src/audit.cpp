@@ -0,0 +1,327 @@
+#include "audit.hpp"
+#include "fdtable.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+
+namespace shell {
+namespace audit {
+
+namespace {
+    constexpr size_t RING_SIZE = 1024;  // power of two
+    constexpr int FLUSH_INTERVAL_MS = 200;
+    constexpr uint64_t DEFAULT_MAX_BYTES = 10ull << 20;
+
+    // Single-producer, single-consumer ring of heap-allocated records.
+    // The main thread pushes; the writer thread pops. `tail` is written
+    // only by the producer and `head` only by the consumer.
+    struct Ring {
+        Record* slots[RING_SIZE] = {};
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+    };
+
+    enum class State { UNCHECKED, OFF, ON };
+
+    State state = State::UNCHECKED;
+    pid_t owner = 0;  // process whose writer thread serves the ring
+    Ring ring;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> stopping{false};
+    std::thread* writer = nullptr;  // never destroyed, so exit() in a fork is safe
+    int wake_fd = -1;
+    int log_fd = -1;
+    std::string log_path;
+    uint64_t max_bytes = DEFAULT_MAX_BYTES;
+    uint64_t log_size = 0;
+
+    uint64_t parse_size(const char* text) {
+        char* end = nullptr;
+        errno = 0;
+        unsigned long long value = std::strtoull(text, &end, 10);
+        if (end == text || errno != 0) return DEFAULT_MAX_BYTES;
+        switch (*end) {
+            case 'G': case 'g': value <<= 10; [[fallthrough]];
+            case 'M': case 'm': value <<= 10; [[fallthrough]];
+            case 'K': case 'k': value <<= 10; break;
+            default: break;
+        }
+        return value;
+    }
+
+    void append_json_string(std::string& out, const std::string& s) {
+        out += '"';
+        for (char c : s) {
+            auto uc = static_cast<unsigned char>(c);
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\t': out += "\\t"; break;
+                case '\r': out += "\\r"; break;
+                default:
+                    if (uc < 0x20) {
+                        char esc[8];
+                        snprintf(esc, sizeof(esc), "\\u%04x", uc);
+                        out += esc;
+                    } else {
+                        out += c;
+                    }
+            }
+        }
+        out += '"';
+    }
+
+    void append_field(std::string& out, const char* key, long long value) {
+        out += ",\"";
+        out += key;
+        out += "\":";
+        out += std::to_string(value);
+    }
+
+    long long micros(const timeval& tv) {
+        return static_cast<long long>(tv.tv_sec) * 1000000 + tv.tv_usec;
+    }
+
+    void format(std::string& out, const Record& record) {
+        char stamp[48];
+        tm utc;
+        gmtime_r(&record.started.tv_sec, &utc);
+        size_t len = strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &utc);
+        snprintf(stamp + len, sizeof(stamp) - len, ".%06ldZ",
+                 record.started.tv_nsec / 1000);
+
+        out += "{\"ts\":\"";
+        out += stamp;
+        out += '"';
+        append_field(out, "pid", owner);
+        out += ",\"cwd\":";
+        append_json_string(out, record.cwd);
+        append_field(out, "status", record.status);
+        append_field(out, "duration_us", static_cast<long long>(record.duration.count()));
+        if (record.timed_out) out += ",\"timed_out\":true";
+
+        out += ",\"stages\":[";
+        for (size_t i = 0; i < record.stages.size(); ++i) {
+            const Stage& stage = record.stages[i];
+            if (i > 0) out += ',';
+            out += "{\"argv\":[";
+            for (size_t k = 0; k < stage.argv.size(); ++k) {
+                if (k > 0) out += ',';
+                append_json_string(out, stage.argv[k]);
+            }
+            out += "],\"path\":";
+            if (stage.path.empty()) {
+                out += "null";
+            } else {
+                append_json_string(out, stage.path);
+            }
+            append_field(out, "status", stage.status);
+            append_field(out, "utime_us", micros(stage.usage.ru_utime));
+            append_field(out, "stime_us", micros(stage.usage.ru_stime));
+            append_field(out, "maxrss_kb", stage.usage.ru_maxrss);
+            append_field(out, "minflt", stage.usage.ru_minflt);
+            append_field(out, "majflt", stage.usage.ru_majflt);
+            append_field(out, "inblock", stage.usage.ru_inblock);
+            append_field(out, "oublock", stage.usage.ru_oublock);
+            append_field(out, "nvcsw", stage.usage.ru_nvcsw);
+            append_field(out, "nivcsw", stage.usage.ru_nivcsw);
+            out += '}';
+        }
+        out += "]}\n";
+    }
+
+    // Moves the full log aside to FILE.1 and starts a new one under the
+    // same descriptor number, so the fd table entry stays valid.
+    void rotate() {
+        std::string old = log_path + ".1";
+        if (rename(log_path.c_str(), old.c_str()) != 0) return;
+        int fresh = open(log_path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+        if (fresh < 0) return;
+        dup3(fresh, log_fd, O_CLOEXEC);
+        close(fresh);
+        log_size = 0;
+    }
+
+    void write_all(const char* p, size_t left) {
+        while (left > 0) {
+            ssize_t n = write(log_fd, p, left);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            p += n;
+            left -= static_cast<size_t>(n);
+            log_size += static_cast<uint64_t>(n);
+        }
+    }
+
+    // End of the whole lines of batch, from start, that fit in room bytes.
+    static size_t fitting_end(const std::string& batch, size_t start, uint64_t room) {
+        if (room >= batch.size() - start) return batch.size();
+        if (room == 0) return start;
+        size_t nl = batch.rfind('\n', start + static_cast<size_t>(room) - 1);
+        return nl == std::string::npos || nl < start ? start : nl + 1;
+    }
+
+    // Writes whole lines, rotating wherever the log would grow past
+    // max_bytes. Only a single record longer than that overshoots it.
+    void write_batch(const std::string& batch) {
+        size_t start = 0;
+        while (start < batch.size()) {
+            size_t end = batch.size();
+            if (max_bytes > 0) {
+                uint64_t room = log_size < max_bytes ? max_bytes - log_size : 0;
+                end = fitting_end(batch, start, room);
+                if (end == start && log_size > 0) {
+                    rotate();
+                    if (log_size == 0) continue;
+                }
+                if (end == start) {
+                    end = batch.find('\n', start);
+                    end = end == std::string::npos ? batch.size() : end + 1;
+                }
+            }
+            write_all(batch.data() + start, end - start);
+            start = end;
+        }
+    }
+
+    // Pops everything queued and writes it with one write().
+    void drain(std::string& batch) {
+        batch.clear();
+        size_t head = ring.head.load(std::memory_order_relaxed);
+        size_t tail = ring.tail.load(std::memory_order_acquire);
+        for (; head != tail; ++head) {
+            Record*& slot = ring.slots[head & (RING_SIZE - 1)];
+            format(batch, *slot);
+            delete slot;
+            slot = nullptr;
+        }
+        ring.head.store(head, std::memory_order_release);
+
+        uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            batch += "{\"dropped\":" + std::to_string(lost) + "}\n";
+        }
+        if (!batch.empty()) write_batch(batch);
+    }
+
+    void writer_loop() {
+        std::string batch;
+        for (;;) {
+            pollfd p{wake_fd, POLLIN, 0};
+            if (poll(&p, 1, FLUSH_INTERVAL_MS) > 0) {
+                uint64_t count;
+                ssize_t r = read(wake_fd, &count, sizeof(count));
+                (void)r;
+            }
+            bool last = stopping.load(std::memory_order_acquire);
+            drain(batch);
+            if (last) return;
+        }
+    }
+
+    void wake() {
+        uint64_t one = 1;
+        ssize_t r = write(wake_fd, &one, sizeof(one));
+        (void)r;
+    }
+
+    // Reads the configuration and opens the log. The writer thread is
+    // started by the first record.
+    void configure() {
+        state = State::OFF;
+        const char* path = getenv("SHELL_AUDIT_LOG");
+        if (!path || !*path) return;
+        if (const char* max = getenv("SHELL_AUDIT_LOG_MAX")) {
+            max_bytes = parse_size(max);
+        }
+
+        log_path = path;
+        log_fd = fdtable::open_file(log_path, O_WRONLY | O_APPEND | O_CREAT, 0600, "audit log");
+        if (log_fd < 0) {
+            perror(path);
+            return;
+        }
+        owner = getpid();
+        state = State::ON;
+    }
+
+    bool start_writer() {
+        wake_fd = fdtable::adopt(eventfd(0, EFD_NONBLOCK), "audit wakeup");
+        if (wake_fd < 0) {
+            state = State::OFF;
+            return false;
+        }
+
+        struct stat st;
+        log_size = fstat(log_fd, &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+        writer = new std::thread(writer_loop);
+        std::atexit(shutdown);
+        return true;
+    }
+}
+
+bool enabled() {
+    if (state == State::UNCHECKED) configure();
+    // Forked children inherit the ring but not the writer thread, so they
+    // stay quiet unless they take over().
+    return state == State::ON && owner == getpid();
+}
+
+void take_over() {
+    if (state != State::ON) return;
+    owner = getpid();
+    writer = nullptr;
+    stopping.store(false, std::memory_order_relaxed);
+    // Anything queued belongs to the parent's writer.
+    ring.head.store(ring.tail.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    dropped.store(0, std::memory_order_relaxed);
+}
+
+void begin(Record& record) {
+    clock_gettime(CLOCK_REALTIME, &record.started);
+    record.start = std::chrono::steady_clock::now();
+    char buf[4096];
+    if (getcwd(buf, sizeof(buf))) record.cwd = buf;
+}
+
+void submit(Record&& record) {
+    record.duration = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - record.start);
+    if (!writer && !start_writer()) return;
+
+    size_t tail = ring.tail.load(std::memory_order_relaxed);
+    size_t head = ring.head.load(std::memory_order_acquire);
+    if (tail - head == RING_SIZE) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.slots[tail & (RING_SIZE - 1)] = new Record(std::move(record));
+    ring.tail.store(tail + 1, std::memory_order_release);
+
+    // The writer flushes on a timer; only a filling queue wakes it early.
+    if (tail + 1 - head == RING_SIZE / 2) wake();
+}
+
+void shutdown() {
+    if (state != State::ON || owner != getpid() || !writer) return;
+    stopping.store(true, std::memory_order_release);
+    wake();
+    writer->join();
+    fdtable::release(wake_fd);
+    fdtable::release(log_fd);
+    state = State::OFF;
+}
+
+} // namespace audit
+} // namespace shell
@@ -0,0 +1,181 @@
+#include "batch.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace shell {
+namespace batch {
+
+namespace {
+
+const char* const MARKER = "+batch";
+// Left unused in every exec, as POSIX suggests for xargs-style tools.
+constexpr size_t HEADROOM = 2048;
+
+struct Options {
+    size_t parallel = 1;
+    size_t max_items = 0;  // 0: as many as fit
+};
+
+// Bytes one argument takes in the exec: its text, its NUL and its
+// argv pointer.
+size_t cost(const std::string& arg) {
+    return arg.size() + 1 + sizeof(char*);
+}
+
+// Room left for argv once the environment is accounted for.
+size_t arg_space() {
+    long max = sysconf(_SC_ARG_MAX);
+    size_t limit = max > 0 ? static_cast<size_t>(max) : 131072;
+    size_t used = HEADROOM + 2 * sizeof(char*);  // argv and envp terminators
+    for (char** env = environ; *env; ++env) {
+        used += std::strlen(*env) + 1 + sizeof(char*);
+    }
+    return limit > used ? limit - used : 0;
+}
+
+bool parse_count(const std::string& text, size_t& value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    value = std::strtoul(text.c_str(), nullptr, 10);
+    return true;
+}
+
+// Parses the options after the marker; returns the index of the first
+// item, or 0 after printing a usage error.
+size_t parse_options(const std::vector<std::string>& args, size_t marker, Options& opts) {
+    size_t i = marker + 1;
+    while (i < args.size()) {
+        const std::string& arg = args[i];
+        if (arg == "--") return i + 1;
+        if (arg != "-P" && arg != "-n") return i;
+        size_t value;
+        if (i + 1 == args.size() || !parse_count(args[i + 1], value) ||
+            (arg == "-n" && value == 0)) {
+            std::cerr << "+batch: " << arg << ": invalid count\n"
+                      << "+batch: usage: cmd [args...] +batch [-P N] [-n N] [--] items...\n";
+            return 0;
+        }
+        if (arg == "-P") {
+            opts.parallel = value;
+        } else {
+            opts.max_items = value;
+        }
+        i += 2;
+    }
+    return i;
+}
+
+std::vector<char*> make_argv(const std::vector<std::string>& fixed,
+                             const std::vector<std::string>& items,
+                             size_t begin, size_t end) {
+    std::vector<char*> argv;
+    argv.reserve(fixed.size() + end - begin + 1);
+    for (const auto& arg : fixed) argv.push_back(const_cast<char*>(arg.c_str()));
+    for (size_t i = begin; i < end; ++i) argv.push_back(const_cast<char*>(items[i].c_str()));
+    argv.push_back(nullptr);
+    return argv;
+}
+
+[[noreturn]] void exec_batch(const std::string& path, std::vector<char*>& argv) {
+    execv(path.c_str(), argv.data());
+    int err = errno;
+    std::cerr << argv[0] << ": " << strerror(err) << "\n";
+    _exit(err == ENOENT ? 127 : 126);
+}
+
+} // namespace
+
+bool requested(const std::vector<std::string>& args) {
+    return std::find(args.begin() + (args.empty() ? 0 : 1), args.end(), MARKER) != args.end();
+}
+
+int run(const std::vector<std::string>& args, const std::string& path) {
+    size_t marker = static_cast<size_t>(
+        std::find(args.begin() + 1, args.end(), MARKER) - args.begin());
+    Options opts;
+    size_t first = parse_options(args, marker, opts);
+    if (first == 0) return 2;
+    if (opts.parallel == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        opts.parallel = cpus > 0 ? static_cast<size_t>(cpus) : 1;
+    }
+
+    std::vector<std::string> fixed(args.begin(), args.begin() + static_cast<std::ptrdiff_t>(marker));
+    std::vector<std::string> items(args.begin() + static_cast<std::ptrdiff_t>(first), args.end());
+
+    size_t space = arg_space();
+    size_t base = 0;
+    for (const auto& arg : fixed) base += cost(arg);
+
+    // Greedy split: each batch takes as many items as still fit.
+    std::vector<std::pair<size_t, size_t>> batches;
+    for (size_t begin = 0; begin < items.size();) {
+        size_t used = base;
+        size_t end = begin;
+        while (end < items.size() && (opts.max_items == 0 || end - begin < opts.max_items) &&
+               used + cost(items[end]) <= space) {
+            used += cost(items[end++]);
+        }
+        if (end == begin) {
+            std::cerr << "+batch: " << fixed[0] << ": argument list too long even for one item\n";
+            return 126;
+        }
+        batches.emplace_back(begin, end);
+        begin = end;
+    }
+
+    if (batches.size() <= 1) {
+        auto argv = make_argv(fixed, items, 0, items.size());
+        exec_batch(path, argv);
+    }
+
+    fflush(nullptr);
+    size_t running = 0;
+    bool failed = false;
+    int unrunnable = 0;
+
+    auto reap = [&]() {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == ECHILD) running = 0;
+            return;
+        }
+        --running;
+        int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        if (code == 126 || code == 127) {
+            unrunnable = std::max(unrunnable, code);
+        } else if (code != 0) {
+            failed = true;
+        }
+    };
+
+    for (const auto& [begin, end] : batches) {
+        while (running >= opts.parallel) reap();
+        auto argv = make_argv(fixed, items, begin, end);
+        pid_t pid = fork();
+        if (pid == 0) exec_batch(path, argv);
+        if (pid < 0) {
+            perror("fork");
+            failed = true;
+            break;
+        }
+        ++running;
+    }
+    while (running > 0) reap();
+
+    if (unrunnable) return unrunnable;
+    return failed ? 123 : 0;
+}
+
+} // namespace batch
+} // namespace shell
@@ -1,49 +1,51 @@
 #include "builtins.hpp"
+#include "arith.hpp"
+#include "batch.hpp"
+#include "condition.hpp"
 #include "utils.hpp"
 #include "history.hpp"
+#include "fdtable.hpp"
+#include "executor.hpp"
+#include "script.hpp"
+#include "stats.hpp"
+#include "supervisor.hpp"
+#include "variables.hpp"
+#include "shell_builtin.h"
 #include <iostream>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <map>
 #include <unistd.h>
 #include <limits.h>
 #include <cstring>
 #include <cerrno>
 #include <cstdlib>
 #include <cstdio>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <readline/history.h>
 
+extern char** environ;
+
 namespace shell {
 namespace builtins {
 
-// Complete list of shell builtins handled internally without forking a process.
-// Must be kept in sync with execute_builtin() dispatch logic.
-const std::vector<std::string> builtin_list = {
-    "cd", "pwd", "echo", "exit", "type", "history"
-};
-
-/**
- * @brief Checks whether the given command name is a shell builtin.
- *
- * @param cmd The command name to look up.
- * @return true if the command is a builtin, false otherwise.
- */
-bool is_builtin(const std::string& cmd) {
-    return std::find(builtin_list.begin(), builtin_list.end(), cmd)
-           != builtin_list.end();
-}
-
 /**
  * @brief Prints the shell's current working directory to stdout.
  *
  * Uses getcwd() rather than $PWD to reflect the true filesystem path,
  * avoiding stale values after symlink traversal.
  */
-void builtin_pwd() {
+int builtin_pwd(const std::vector<std::string>& /*args*/) {
     char cwd[PATH_MAX];
     if (getcwd(cwd, sizeof(cwd))) {
         std::cout << cwd << std::endl;
-    } else {
-        std::cerr << "pwd: " << strerror(errno) << std::endl;
+        return 0;
     }
+    std::cerr << "pwd: " << strerror(errno) << std::endl;
+    return 1;
 }
 
 /**
@@ -54,7 +56,7 @@ void builtin_pwd() {
  *
  * @param args Tokenised command line; args[0] == "cd".
  */
-void builtin_cd(const std::vector<std::string>& args) {
+int builtin_cd(const std::vector<std::string>& args) {
     std::string path;
 
     if (args.size() == 1) {
@@ -62,7 +64,7 @@ void builtin_cd(const std::vector<std::string>& args) {
         const char* home = getenv("HOME");
         if (!home) {
             std::cerr << "cd: HOME not set\n";
-            return;
+            return 1;
         }
         path = home;
     } else {
@@ -72,7 +74,9 @@ void builtin_cd(const std::vector<std::string>& args) {
 
     if (chdir(path.c_str()) != 0) {
         std::cerr << "cd: " << path << ": " << strerror(errno) << std::endl;
+        return 1;
     }
+    return 0;
 }
 
 /**
@@ -83,7 +87,7 @@ void builtin_cd(const std::vector<std::string>& args) {
  *
  * @param args Tokenised command line; args[0] == "echo".
  */
-void builtin_echo(const std::vector<std::string>& args) {
+int builtin_echo(const std::vector<std::string>& args) {
     bool newline = true;
     size_t i = 1;
 
@@ -104,6 +108,7 @@ void builtin_echo(const std::vector<std::string>& args) {
     if (newline) {
         std::cout << std::endl;
     }
+    return 0;
 }
 
 /**
@@ -114,10 +119,10 @@ void builtin_echo(const std::vector<std::string>& args) {
  *
  * @param args Tokenised command line; args[0] == "type".
  */
-void builtin_type(const std::vector<std::string>& args) {
+int builtin_type(const std::vector<std::string>& args) {
     if (args.size() < 2) {
         std::cerr << "type: missing operand\n";
-        return;
+        return 1;
     }
 
     const std::string& name = args[1];
@@ -130,8 +135,10 @@ void builtin_type(const std::vector<std::string>& args) {
             std::cout << name << " is " << path << std::endl;
         } else {
             std::cout << name << ": not found\n";
+            return 1;
         }
     }
+    return 0;
 }
 
 /**
@@ -148,7 +155,8 @@ void builtin_type(const std::vector<std::string>& args) {
  *
  * @param args Tokenised command line; args[0] == "history".
  */
-void builtin_history(const std::vector<std::string>& args) {
+int builtin_history(const std::vector<std::string>& args) {
+    history::ensure_history_loaded();
     const char* hist_file = history::get_history_file();
 
     // -c: wipe both the in-memory list and the on-disk file so that
@@ -158,10 +166,10 @@ void builtin_history(const std::vector<std::string>& args) {
         history::set_last_history_length(0);
         if (hist_file) {
             // Truncate the file rather than deleting it to preserve permissions.
-            FILE* f = fopen(hist_file, "w");
+            FILE* f = fopen(hist_file, "we");
             if (f) fclose(f);
         }
-        return;
+        return 0;
     }
 
     // -r <file>: load (merge) history from an explicit file path.
@@ -172,20 +180,21 @@ void builtin_history(const std::vector<std::string>& args) {
         // so detect that case to avoid a misleading errno message.
         if (filepath == args[2] && args[2][0] == '~') {
             std::cerr << "history: HOME not set\n";
-            return;
+            return 1;
         }
 
         if (read_history(filepath.c_str()) != 0) {
             std::cerr << "history: " << filepath << ": "
                       << strerror(errno) << std::endl;
+            return 1;
         }
-        return;
+        return 0;
     }
 
     // Guard against -r being passed without a filename argument.
     if (args.size() == 2 && args[1] == "-r") {
         std::cerr << "history: -r: option requires an argument\n";
-        return;
+        return 1;
     }
 
     // -w <file>: overwrite the target file with the full history list.
@@ -193,21 +202,22 @@ void builtin_history(const std::vector<std::string>& args) {
         std::string filepath = expand_tilde(args[2]);
         if (filepath == args[2] && args[2][0] == '~') {
             std::cerr << "history: HOME not set\n";
-            return;
+            return 1;
         }
 
         if (write_history(filepath.c_str()) != 0) {
             std::cerr << "history: " << filepath << ": "
                       << strerror(errno) << std::endl;
+            return 1;
         }
         // Record the baseline so that a later -a only appends truly new entries.
         history::set_last_history_length(history_length);
-        return;
+        return 0;
     }
 
     if (args.size() == 2 && args[1] == "-w") {
         std::cerr << "history: -w: option requires an argument\n";
-        return;
+        return 1;
     }
 
     // -a <file>: append only the entries added in this session, preventing
@@ -216,31 +226,33 @@ void builtin_history(const std::vector<std::string>& args) {
         std::string filepath = expand_tilde(args[2]);
         if (filepath == args[2] && args[2][0] == '~') {
             std::cerr << "history: HOME not set\n";
-            return;
+            return 1;
         }
 
         // Calculate how many new entries have accumulated since the last save.
         int new_entries = history_length - history::get_last_history_length();
 
+        int status = 0;
         if (new_entries > 0) {
             if (append_history(new_entries, filepath.c_str()) != 0) {
                 std::cerr << "history: " << filepath << ": "
                           << strerror(errno) << std::endl;
+                status = 1;
             }
         }
         history::set_last_history_length(history_length);
-        return;
+        return status;
     }
 
     if (args.size() == 2 && args[1] == "-a") {
         std::cerr << "history: -a: option requires an argument\n";
-        return;
+        return 1;
     }
 
     // --- Display history ---
 
     HIST_ENTRY** hist_list = history_list();
-    if (!hist_list) return;  // Nothing to display if the list is empty.
+    if (!hist_list) return 0;  // Nothing to display if the list is empty.
 
     int count = history_length;
     int start = 0;  // Default: show the entire list.
@@ -256,7 +268,7 @@ void builtin_history(const std::vector<std::string>& args) {
         } catch (...) {
             std::cerr << "history: " << args[1]
                       << ": numeric argument required\n";
-            return;
+            return 1;
         }
     }
 
@@ -266,14 +278,781 @@ void builtin_history(const std::vector<std::string>& args) {
         std::cout << "  " << (i + history_base) << "  "
                   << hist_list[i]->line << std::endl;
     }
+    return 0;
+}
+
+/**
+ * @brief Lists the shell's open file descriptors (debugging aid).
+ *
+ * Shell-internal descriptors are labelled with their owner, which makes
+ * leaked pipe ends and saved stdio copies easy to spot.
+ */
+int builtin_shellfds(const std::vector<std::string>& /*args*/) {
+    fdtable::dump(std::cout);
+    return 0;
+}
+
+/**
+ * @brief Shows the shell's runtime counters and latency percentiles.
+ *
+ * --json prints one JSON object (the format SHELL_STATS_FILE gets) and
+ * --reset starts the counts over after printing; given alone it prints
+ * nothing.
+ *
+ * @param args Tokenised command line; args[0] == "shellstats".
+ * @return 0, or 2 on an unknown option.
+ */
+int builtin_shellstats(const std::vector<std::string>& args) {
+    bool json = false;
+    bool reset = false;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (args[i] == "--json") {
+            json = true;
+        } else if (args[i] == "--reset") {
+            reset = true;
+        } else {
+            std::cerr << "shellstats: " << args[i] << ": invalid option\n"
+                      << "shellstats: usage: shellstats [--json] [--reset]\n";
+            return 2;
+        }
+    }
+    if (json || !reset) {
+        stats::print(std::cout, json);
+    }
+    if (reset) {
+        stats::reset();
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs the commands in a file within the current shell.
+ *
+ * Invoked as either 'source <file>' or '. <file>'. Unlike running a
+ * script as a child process, state changes such as cd persist.
+ *
+ * @param args Tokenised command line; args[0] is "source" or ".".
+ */
+int builtin_source(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << args[0] << ": filename argument required\n";
+        return 1;
+    }
+    return script::source_file(expand_tilde(args[1]));
+}
+
+// First and largest chunk 'read' requests from a regular file. Chunks
+// start small so short lines don't cost a large copy, and double while
+// the delimiter hasn't been found.
+static constexpr size_t READ_CHUNK_MIN = 128;
+static constexpr size_t READ_CHUNK_MAX = 8192;
+
+/**
+ * @brief Reads one delimiter-terminated record for the read builtin.
+ *
+ * Bash reads one byte per syscall so that it never consumes input meant
+ * for the next reader of the same descriptor. That is only necessary for
+ * pipes and terminals: a regular file is read in chunks and the offset
+ * is moved back to just past the delimiter afterwards.
+ *
+ * @param fd Descriptor to read from.
+ * @param delim Record delimiter.
+ * @param raw If false, a backslash escapes the next character and
+ *            backslash-newline is removed.
+ * @param out Receives the record, without the delimiter.
+ * @return true if a delimiter was found, false on EOF or error.
+ */
+static bool read_record(int fd, char delim, bool raw, std::string& out) {
+    struct stat sb;
+    bool seekable = fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode) &&
+                    lseek(fd, 0, SEEK_CUR) >= 0;
+
+    char buf[READ_CHUNK_MAX];
+    size_t chunk = seekable ? READ_CHUNK_MIN : 1;
+    bool escaped = false;
+
+    for (;;) {
+        ssize_t n = read(fd, buf, chunk);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+
+        for (ssize_t k = 0; k < n; ++k) {
+            char c = buf[k];
+            if (escaped) {
+                escaped = false;
+                if (c != '\n') out += c;
+            } else if (!raw && c == '\\') {
+                escaped = true;
+            } else if (c == delim) {
+                if (k + 1 < n) {
+                    lseek(fd, k + 1 - n, SEEK_CUR);
+                }
+                return true;
+            } else {
+                out += c;
+            }
+        }
+        if (seekable) chunk = std::min(chunk * 2, READ_CHUNK_MAX);
+    }
+}
+
+/**
+ * @brief Checks for a whitespace character that is also in IFS.
+ */
+static bool is_ifs_space(const std::string& ifs, char c) {
+    return (c == ' ' || c == '\t' || c == '\n') && ifs.find(c) != std::string::npos;
+}
+
+/**
+ * @brief Splits the next field off a record using IFS rules.
+ *
+ * IFS whitespace around a field is skipped and runs of it separate fields;
+ * any other IFS character separates exactly one pair of fields.
+ *
+ * @param line Record being split.
+ * @param pos In: where to start. Out: start of the following field.
+ * @param ifs Field separators.
+ * @return The field.
+ */
+static std::string next_field(const std::string& line, size_t& pos,
+                              const std::string& ifs) {
+    auto is_sep = [&](char c) { return ifs.find(c) != std::string::npos; };
+    auto is_sep_space = [&](char c) { return is_ifs_space(ifs, c); };
+
+    while (pos < line.size() && is_sep_space(line[pos])) ++pos;
+    size_t start = pos;
+    while (pos < line.size() && !is_sep(line[pos])) ++pos;
+    std::string field = line.substr(start, pos - start);
+
+    while (pos < line.size() && is_sep_space(line[pos])) ++pos;
+    if (pos < line.size() && is_sep(line[pos])) {
+        ++pos;
+        while (pos < line.size() && is_sep_space(line[pos])) ++pos;
+    }
+    return field;
+}
+
+/**
+ * @brief Reads a record from stdin and splits it into variables.
+ *
+ * Usage: read [-r] [-d delim] [-a array] [-u fd] [name...]
+ *   -r        Backslashes are literal.
+ *   -d delim  End the record at the first character of delim (NUL if
+ *             empty) instead of newline.
+ *   -a array  Assign the fields to consecutive elements of array.
+ *   -u fd     Read from descriptor fd instead of stdin.
+ * With no names the record is stored unsplit in REPLY. Otherwise each
+ * name gets one IFS-separated field and the last gets the rest.
+ *
+ * @param args Tokenised command line; args[0] == "read".
+ * @return 0 if a whole record was read, 1 on EOF, 2 on a usage error.
+ */
+int builtin_read(const std::vector<std::string>& args) {
+    bool raw = false;
+    char delim = '\n';
+    std::string array;
+    int fd = STDIN_FILENO;
+    size_t i = 1;
+
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i) {
+        const std::string& opt = args[i];
+        if (opt == "--") {
+            ++i;
+            break;
+        }
+        if (opt == "-r") {
+            raw = true;
+        } else if ((opt == "-d" || opt == "-a") && i + 1 < args.size()) {
+            if (opt == "-d") {
+                delim = args[++i].empty() ? '\0' : args[i][0];
+            } else {
+                array = args[++i];
+            }
+        } else if (opt == "-u" && i + 1 < args.size()) {
+            // Reading a coprocess's output: read -u ${NAME[0]}
+            const std::string& spec = args[++i];
+            char* end = nullptr;
+            errno = 0;
+            long n = std::strtol(spec.c_str(), &end, 10);
+            if (spec.empty() || *end != '\0' || errno != 0 || n < 0 || n > INT_MAX ||
+                fcntl(static_cast<int>(n), F_GETFD) < 0) {
+                std::cerr << "read: " << spec << ": invalid file descriptor\n";
+                return 1;
+            }
+            fd = static_cast<int>(n);
+        } else {
+            std::cerr << "read: " << opt << ": invalid option\n"
+                      << "read: usage: read [-r] [-d delim] [-a array] [-u fd] [name...]\n";
+            return 2;
+        }
+    }
+
+    std::vector<std::string> names(args.begin() + static_cast<std::ptrdiff_t>(i),
+                                   args.end());
+    for (const auto& name : names) {
+        if (!variables::is_valid_name(name)) {
+            std::cerr << "read: `" << name << "': not a valid identifier\n";
+            return 2;
+        }
+    }
+    if (!array.empty() && !variables::is_valid_name(array)) {
+        std::cerr << "read: `" << array << "': not a valid identifier\n";
+        return 2;
+    }
+
+    std::string line;
+    bool complete = read_record(fd, delim, raw, line);
+    if (!complete && line.empty()) {
+        // EOF: like bash, the variables are still assigned (empty).
+        if (!array.empty()) variables::set_array(array, {});
+        for (const auto& name : names) variables::set(name, "");
+        return 1;
+    }
+
+    std::string ifs = variables::is_set("IFS") ? variables::get("IFS") : " \t\n";
+    size_t pos = 0;
+
+    if (!array.empty()) {
+        std::vector<std::string> fields;
+        while (pos < line.size() && is_ifs_space(ifs, line[pos])) ++pos;
+        while (pos < line.size()) {
+            fields.push_back(next_field(line, pos, ifs));
+        }
+        variables::set_array(array, std::move(fields));
+    } else if (names.empty()) {
+        variables::set("REPLY", line);
+    } else {
+        for (size_t n = 0; n + 1 < names.size(); ++n) {
+            variables::set(names[n], next_field(line, pos, ifs));
+        }
+        // The last name takes the remainder, minus trailing IFS whitespace.
+        size_t end = line.size();
+        while (pos < end && is_ifs_space(ifs, line[pos])) ++pos;
+        while (end > pos && is_ifs_space(ifs, line[end - 1])) --end;
+        variables::set(names.back(), line.substr(pos, end - pos));
+    }
+    return complete ? 0 : 1;
+}
+
+/**
+ * @brief Marks variables for export to the commands the shell starts.
+ *
+ * NAME=value assigns and exports in one go. With no arguments the
+ * environment is listed.
+ *
+ * @param args Tokenised command line; args[0] == "export".
+ * @return 0, or 1 if a name is not a valid identifier.
+ */
+int builtin_export(const std::vector<std::string>& args) {
+    if (args.size() == 1) {
+        std::vector<std::string> entries;
+        for (char** env = environ; *env; ++env) {
+            entries.push_back(*env);
+        }
+        std::sort(entries.begin(), entries.end());
+        for (const auto& entry : entries) {
+            size_t eq = entry.find('=');
+            std::cout << "export " << entry.substr(0, eq) << "=\""
+                      << entry.substr(eq + 1) << "\"\n";
+        }
+        return 0;
+    }
+
+    int code = 0;
+    for (size_t i = 1; i < args.size(); ++i) {
+        std::string name = args[i].substr(0, args[i].find('='));
+        if (!variables::is_valid_name(name)) {
+            std::cerr << "export: `" << args[i] << "': not a valid identifier\n";
+            code = 1;
+            continue;
+        }
+        if (name.size() < args[i].size() && variables::assign({args[i]}) != 0) {
+            code = 1;
+            continue;
+        }
+        variables::export_name(name);
+    }
+    return code;
+}
+
+/**
+ * @brief Evaluates arithmetic expressions, setting any variables assigned.
+ *
+ * Each argument is one expression, so spaces need quoting:
+ * let i++ "j = i * 2".
+ *
+ * @param args Tokenised command line; args[0] == "let".
+ * @return 0 if the last expression is non-zero, 1 if it is zero or invalid.
+ */
+int builtin_let(const std::vector<std::string>& args) {
+    if (args.size() < 2) {
+        std::cerr << "let: expression expected\n";
+        return 1;
+    }
+    int64_t value = 0;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (!arith::evaluate(args[i], value)) return 1;
+    }
+    return value != 0 ? 0 : 1;
+}
+
+/**
+ * @brief Evaluates the arithmetic command (( expr )).
+ *
+ * The tokenizer delivers the expression between "((" and "))" as a
+ * single word, with parameter references already expanded.
+ *
+ * @param args Tokenised command line: "((", expression, "))".
+ * @return 0 if the expression is non-zero, 1 if it is zero or invalid.
+ */
+int builtin_arith(const std::vector<std::string>& args) {
+    std::string expr;
+    for (size_t i = 1; i < args.size(); ++i) {
+        if (i + 1 == args.size() && args[i] == "))") break;
+        if (!expr.empty()) expr += ' ';
+        expr += args[i];
+    }
+    int64_t value;
+    if (!arith::evaluate(expr, value)) return 1;
+    return value != 0 ? 0 : 1;
+}
+
+/**
+ * @brief Evaluates a conditional expression in-process.
+ *
+ * One handler serves test, [ and [[; the command name picks the
+ * syntax, so conditions in scripts never exec /usr/bin/[.
+ *
+ * @param args Tokenised command line; args[0] is "test", "[" or "[[".
+ * @return 0 if the condition holds, 1 if not, 2 on a syntax error.
+ */
+int builtin_test(const std::vector<std::string>& args) {
+    return condition::evaluate(args);
+}
+
+/**
+ * @brief Runs a command under a time limit.
+ *
+ * The command gets its own process group, which receives the signal when
+ * the limit expires and SIGKILL after the grace period.
+ *
+ * @param args Tokenised command line; args[0] == "timeout".
+ * @return The command's status, 124 on timeout, 137 if killed, 125 on misuse.
+ */
+int builtin_timeout(const std::vector<std::string>& args) {
+    supervisor::Limits limits;
+    int start = supervisor::parse_timeout(args, limits);
+    if (start < 0) return 125;
+
+    std::vector<std::vector<std::string>> pipeline{
+        {args.begin() + start, args.end()}};
+    return executor::execute_pipeline(pipeline, {}, {}, limits);
+}
+
+/**
+ * @brief Starts a coprocess from within a pipeline stage.
+ *
+ * @param args Tokenised command line; args[0] == "coproc".
+ * @return 0 once started, 1 on error, 2 on misuse.
+ */
+int builtin_coproc(const std::vector<std::string>& args) {
+    // Redirections were taken off already; what is left is plain words.
+    return executor::start_coprocess({args, std::vector<unsigned>(args.size(), parser::PLAIN)});
+}
+
+/**
+ * @brief Waits for coprocesses to finish and reports their status.
+ *
+ * With no operands every coprocess is waited for. Each one's input is
+ * closed first, so filters like `sort` can finish.
+ *
+ * @param args Tokenised command line; args[0] == "wait".
+ * @return Status of the last pid waited for, 127 if one is unknown.
+ */
+int builtin_wait(const std::vector<std::string>& args) {
+    if (args.size() == 1) {
+        return executor::wait_coprocess(-1);
+    }
+
+    int code = 0;
+    for (size_t i = 1; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        char* end = nullptr;
+        errno = 0;
+        long pid = std::strtol(arg.c_str(), &end, 10);
+        if (arg.empty() || *end != '\0' || errno != 0 || pid <= 0 || pid > INT_MAX) {
+            std::cerr << "wait: `" << arg << "': not a pid\n";
+            code = 2;
+            continue;
+        }
+        code = executor::wait_coprocess(static_cast<pid_t>(pid));
+        if (code < 0) {
+            std::cerr << "wait: pid " << arg << " is not a child of this shell\n";
+            code = 127;
+        }
+    }
+    return code;
+}
+
+/**
+ * @brief Replaces the shell with a command.
+ *
+ * Redirections on a lone `exec` are applied for good by the executor
+ * before this runs, so with no command there is nothing left to do.
+ *
+ * @param args Tokenised command line; args[0] == "exec".
+ * @return Only on failure: 127 if not found, 126 if not executable, 2 on misuse.
+ */
+int builtin_exec(const std::vector<std::string>& args) {
+    std::string argv0;
+    bool clear_env = false;
+    bool login = false;
+
+    size_t i = 1;
+    for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i) {
+        if (args[i] == "--") {
+            ++i;
+            break;
+        }
+        if (args[i] == "-a" && i + 1 < args.size()) {
+            argv0 = args[++i];
+            continue;
+        }
+        for (char c : args[i].substr(1)) {
+            if (c == 'c') {
+                clear_env = true;
+            } else if (c == 'l') {
+                login = true;
+            } else {
+                std::cerr << "exec: -" << c << ": invalid option\n"
+                          << "exec: usage: exec [-cl] [-a name] [command [argument ...]]\n";
+                return 2;
+            }
+        }
+    }
+    if (i == args.size()) return 0;
+
+    std::vector<std::string> command(args.begin() + static_cast<std::ptrdiff_t>(i), args.end());
+    if (argv0.empty()) argv0 = command[0];
+    if (login) argv0 = "-" + argv0;
+    return executor::exec_command(command, argv0, clear_env);
+}
+
+/**
+ * @brief Parses the status argument of 'exit'.
+ *
+ * @param args Tokenised command line; args[0] == "exit".
+ * @return The requested status, 0 without one, 1 if it is not a number.
+ */
+int builtin_exit(const std::vector<std::string>& args) {
+    if (args.size() < 2) return 0;
+    try {
+        return std::stoi(args[1]);
+    } catch (...) {
+        std::cerr << "exit: numeric argument required\n";
+        return 1;
+    }
+}
+
+// --- Registry ---
+
+// Every native builtin. Lookups go through a perfect hash computed at
+// compile time, so adding an entry here is all it takes to register one.
+static constexpr Builtin registry[] = {
+    {"cd", builtin_cd, NO_FLAGS},
+    {"pwd", builtin_pwd, NOFORK_LAST},
+    {"echo", builtin_echo, NOFORK_LAST},
+    {"exit", builtin_exit, NO_FLAGS},
+    {"exec", builtin_exec, NO_FLAGS},
+    {"type", builtin_type, NOFORK_LAST},
+    {"history", builtin_history, NO_FLAGS},
+    {"shellfds", builtin_shellfds, NOFORK_LAST},
+    {"shellstats", builtin_shellstats, NOFORK_LAST},
+    {"source", builtin_source, NO_FLAGS},
+    {"timeout", builtin_timeout, RUNS_COMMAND},
+    {"coproc", builtin_coproc, RUNS_COMMAND},
+    {"wait", builtin_wait, NO_FLAGS},
+    {"export", builtin_export, NO_FLAGS},
+    {"let", builtin_let, NO_FLAGS},
+    {"((", builtin_arith, NO_FLAGS},
+    {"test", builtin_test, NO_FLAGS},
+    {"[", builtin_test, NO_FLAGS},
+    {"[[", builtin_test, NO_FLAGS},
+    {".", builtin_source, NO_FLAGS},
+    {"enable", builtin_enable, NO_FLAGS},
+    {"read", builtin_read, NOFORK_LAST},
+    {"cat", builtin_cat, NOFORK_LAST | OPTIONAL},
+    {"head", builtin_head, NOFORK_LAST | OPTIONAL},
+    {"tail", builtin_tail, NOFORK_LAST | OPTIONAL},
+    {"wc", builtin_wc, NOFORK_LAST | OPTIONAL},
+};
+
+static constexpr size_t REGISTRY_SIZE = sizeof(registry) / sizeof(registry[0]);
+
+// Hash table size; a power of two comfortably above the entry count so a
+// collision-free seed turns up after a few hundred tries.
+static constexpr size_t SLOTS = 64;
+static_assert(REGISTRY_SIZE < SLOTS, "grow SLOTS along with the registry");
+
+// Seeded 32-bit FNV-1a.
+static constexpr uint32_t hash_name(std::string_view name, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (char c : name) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// The low bits of an FNV product depend only on the low bits of its
+// inputs, so the high half is folded in before masking.
+static constexpr size_t slot_of(std::string_view name, uint32_t seed) {
+    uint32_t h = hash_name(name, seed);
+    return (h ^ (h >> 16)) & (SLOTS - 1);
+}
+
+// Smallest seed under which no two builtin names share a slot.
+static constexpr uint32_t find_seed() {
+    for (uint32_t seed = 0;; ++seed) {
+        bool used[SLOTS] = {};
+        bool ok = true;
+        for (const auto& b : registry) {
+            size_t slot = slot_of(b.name, seed);
+            if (used[slot]) {
+                ok = false;
+                break;
+            }
+            used[slot] = true;
+        }
+        if (ok) return seed;
+    }
+}
+
+static constexpr uint32_t SEED = find_seed();
+
+// Slot -> registry index, or -1 for an empty slot.
+struct SlotTable {
+    int8_t index[SLOTS];
+};
+
+static constexpr SlotTable build_slots() {
+    SlotTable table{};
+    for (auto& entry : table.index) entry = -1;
+    for (size_t i = 0; i < REGISTRY_SIZE; ++i) {
+        table.index[slot_of(registry[i].name, SEED)] = static_cast<int8_t>(i);
+    }
+    return table;
+}
+
+static constexpr SlotTable slots = build_slots();
+
+// Index of a native builtin, or -1. One hash, one compare.
+static int registry_index(std::string_view name) {
+    int index = slots.index[slot_of(name, SEED)];
+    return index >= 0 && registry[static_cast<size_t>(index)].name == name ? index : -1;
+}
+
+// Whether each native builtin is switched on. OPTIONAL ones start off so
+// that scripts get the full utilities unless asked otherwise.
+static constexpr std::array<bool, REGISTRY_SIZE> initially_enabled() {
+    std::array<bool, REGISTRY_SIZE> on{};
+    for (size_t i = 0; i < REGISTRY_SIZE; ++i) {
+        on[i] = (registry[i].flags & OPTIONAL) == 0;
+    }
+    return on;
+}
+
+static std::array<bool, REGISTRY_SIZE> enabled = initially_enabled();
+
+// Builtins loaded with 'enable -f'. Map nodes never move, so each entry's
+// name can view the key.
+struct LoadedBuiltin {
+    void* handle;
+    Builtin entry;
+    bool enabled;
+};
+static std::map<std::string, LoadedBuiltin> loaded;
+
+const Builtin* find_builtin(const std::string& cmd) {
+    int index = registry_index(cmd);
+    if (index >= 0) {
+        return enabled[static_cast<size_t>(index)] ? &registry[static_cast<size_t>(index)] : nullptr;
+    }
+    if (loaded.empty()) return nullptr;
+
+    auto it = loaded.find(cmd);
+    return it != loaded.end() && it->second.enabled ? &it->second.entry : nullptr;
+}
+
+/**
+ * @brief Checks whether the given command name is a shell builtin.
+ *
+ * Builtins disabled with 'enable -n' are not, so PATH lookup finds the
+ * external command of the same name.
+ *
+ * @param cmd The command name to look up.
+ * @return true if the command is an enabled builtin, false otherwise.
+ */
+bool is_builtin(const std::string& cmd) {
+    return find_builtin(cmd) != nullptr;
+}
+
+std::vector<std::string> builtin_names() {
+    std::vector<std::string> names;
+    for (size_t i = 0; i < REGISTRY_SIZE; ++i) {
+        if (enabled[i]) names.emplace_back(registry[i].name);
+    }
+    for (const auto& [name, builtin] : loaded) {
+        if (builtin.enabled) names.push_back(name);
+    }
+    return names;
+}
+
+/**
+ * @brief Loads builtins from a shared object for 'enable -f'.
+ *
+ * Each NAME is resolved as the symbol NAME_builtin, a struct
+ * shell_builtin (see shell_builtin.h) whose ABI version must match.
+ *
+ * @return 0 if every name loaded, 1 otherwise.
+ */
+static int load_builtins(const std::string& path,
+                         const std::vector<std::string>& names) {
+    int status = 0;
+    for (const auto& name : names) {
+        if (registry_index(name) >= 0) {
+            std::cerr << "enable: " << name << ": cannot replace a native builtin\n";
+            status = 1;
+            continue;
+        }
+
+        // Each name holds its own reference so 'enable -d' can drop it alone.
+        void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) {
+            std::cerr << "enable: " << dlerror() << "\n";
+            return 1;
+        }
+
+        std::string symbol = name + SHELL_BUILTIN_SYMBOL_SUFFIX;
+        auto* def = static_cast<const shell_builtin*>(dlsym(handle, symbol.c_str()));
+        if (!def || !def->run) {
+            std::cerr << "enable: " << path << ": no " << symbol << " defined\n";
+        } else if (def->abi_version != SHELL_BUILTIN_ABI_VERSION) {
+            std::cerr << "enable: " << path << ": " << name << " built for ABI version "
+                      << def->abi_version << ", shell has " << SHELL_BUILTIN_ABI_VERSION << "\n";
+        } else {
+            auto old = loaded.find(name);
+            if (old != loaded.end()) {
+                dlclose(old->second.handle);
+                loaded.erase(old);
+            }
+            unsigned flags = (def->flags & SHELL_BUILTIN_NOFORK_LAST) ? NOFORK_LAST : NO_FLAGS;
+            auto it = loaded.emplace(name, LoadedBuiltin{handle, {}, true}).first;
+            it->second.entry = Builtin{it->first, nullptr, flags, def};
+            continue;
+        }
+        dlclose(handle);
+        status = 1;
+    }
+    return status;
+}
+
+// Runs a loaded builtin through its C entry point.
+static int run_loaded(const shell_builtin* def, const std::vector<std::string>& args) {
+    std::vector<char*> argv;
+    for (const auto& arg : args) {
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    int status = def->run(static_cast<int>(args.size()), argv.data());
+    fflush(stdout);
+    fflush(stderr);
+    return status;
+}
+
+/**
+ * @brief Enables, disables, loads and unloads builtins.
+ *
+ *   enable                    List every builtin as 'enable name' or 'enable -n name'.
+ *   enable name...            Enable the named builtins.
+ *   enable -n name...         Disable them; the PATH command of that name runs instead.
+ *   enable -f lib.so name...  Load builtins from a shared object (see shell_builtin.h).
+ *   enable -d name...         Unload builtins loaded with -f.
+ *
+ * @param args Tokenised command line; args[0] == "enable".
+ * @return 0 on success, 1 if a name is not a builtin or fails to load.
+ */
+int builtin_enable(const std::vector<std::string>& args) {
+    size_t i = 1;
+    std::string mode = i < args.size() && args[i].size() == 2 && args[i][0] == '-'
+                           ? args[i] : "";
+    if (!mode.empty()) {
+        if (mode != "-n" && mode != "-f" && mode != "-d") {
+            std::cerr << "enable: " << mode << ": invalid option\n"
+                      << "enable: usage: enable [-n|-d] [name...] | enable -f file name...\n";
+            return 2;
+        }
+        ++i;
+    }
+
+    if (mode == "-f") {
+        if (i + 1 >= args.size()) {
+            std::cerr << "enable: usage: enable -f file name...\n";
+            return 2;
+        }
+        std::string path = args[i];
+        // Like dlopen's own search, but a bare name means the current
+        // directory rather than the library path.
+        if (path.find('/') == std::string::npos) path = "./" + path;
+        return load_builtins(path, {args.begin() + static_cast<std::ptrdiff_t>(i) + 1,
+                                    args.end()});
+    }
+
+    if (i == args.size()) {
+        for (size_t k = 0; k < REGISTRY_SIZE; ++k) {
+            std::cout << (enabled[k] ? "enable " : "enable -n ")
+                      << registry[k].name << "\n";
+        }
+        for (const auto& [name, builtin] : loaded) {
+            std::cout << (builtin.enabled ? "enable " : "enable -n ") << name << "\n";
+        }
+        return 0;
+    }
+
+    int status = 0;
+    for (; i < args.size(); ++i) {
+        const std::string& name = args[i];
+        int index = registry_index(name);
+        auto it = loaded.find(name);
+
+        if (mode == "-d") {
+            if (it == loaded.end()) {
+                std::cerr << "enable: " << name << ": not a loaded builtin\n";
+                status = 1;
+            } else {
+                dlclose(it->second.handle);
+                loaded.erase(it);
+            }
+        } else if (index >= 0) {
+            // 'enable -n enable' would leave no way back.
+            enabled[static_cast<size_t>(index)] = mode != "-n" || name == "enable";
+        } else if (it != loaded.end()) {
+            it->second.enabled = mode != "-n";
+        } else {
+            std::cerr << "enable: " << name << ": not a shell builtin\n";
+            status = 1;
+        }
+    }
+    return status;
 }
 
 /**
  * @brief Dispatches a parsed command to its builtin implementation.
  *
  * This is the single entry point called by the main execution loop when
- * is_builtin() returns true. Returns 0 on success, 1 if the command is
- * not recognised as a builtin (should not normally occur).
+ * is_builtin() returns true. Returns the builtin's exit status, or 1 if
+ * the command is not recognised as a builtin (should not normally occur).
  *
  * @param args Tokenised command line; args[0] is the command name.
  * @return Exit-status integer (0 == success).
@@ -281,23 +1060,19 @@ void builtin_history(const std::vector<std::string>& args) {
 int execute_builtin(const std::vector<std::string>& args) {
     if (args.empty()) return 1;
 
-    const std::string& cmd = args[0];
-
-    if (cmd == "pwd") {
-        builtin_pwd();
-    } else if (cmd == "cd") {
-        builtin_cd(args);
-    } else if (cmd == "echo") {
-        builtin_echo(args);
-    } else if (cmd == "type") {
-        builtin_type(args);
-    } else if (cmd == "history") {
-        builtin_history(args);
-    } else {
-        return 1;  // Caller should not reach here if is_builtin() was checked.
+    const Builtin* builtin = find_builtin(args[0]);
+    if (!builtin) return 1;  // Caller should not reach here if is_builtin() was checked.
+
+    // Batching needs a separate process per batch, which only external
+    // commands get.
+    if (!(builtin->flags & RUNS_COMMAND) && batch::requested(args)) {
+        std::cerr << args[0] << ": +batch only applies to external commands\n";
+        return 2;
     }
 
-    return 0;
+    stats::add(stats::Counter::BUILTINS);
+    return builtin->loaded ? run_loaded(builtin->loaded, args)
+                           : builtin->handler(args);
 }
 
 } // namespace builtins
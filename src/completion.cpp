@@ -1,28 +1,209 @@
 #include "completion.hpp"
 #include "builtins.hpp"
+#include "dircache.hpp"
+#include "fuzzy.hpp"
+#include "history.hpp"
+#include "lineedit.hpp"
+#include "startup.hpp"
+#include "stats.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
 #include <vector>
 #include <string>
 #include <set>
 #include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <cctype>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <dirent.h>
+#include <readline/history.h>
 
 namespace shell {
 namespace completion {
 
-char* completion_generator(const char* text, int state) {
-    static std::vector<std::string> matches;
-    static size_t index;
+namespace {
+    // Directories whose scan had not finished when the last completion
+    // gave up waiting; used to tell the user the result is partial.
+    std::vector<std::string> pending_dirs;
 
-    if (state == 0) {
-        matches.clear();
-        index = 0;
+    using Clock = std::chrono::steady_clock;
+
+    // Lists a directory, sharing one wait budget across every directory
+    // a single completion touches.
+    dircache::Listing list_within(const std::string& dir,
+                                  Clock::time_point deadline) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - Clock::now());
+        auto listing = dircache::list(
+            dir, std::max(left, std::chrono::milliseconds(0)));
+        if (!listing.complete) {
+            pending_dirs.push_back(dir);
+        }
+        return listing;
+    }
+
+    // A word is in command position at the start of the line or right
+    // after a pipe.
+    bool in_command_position(const std::string& line, size_t start) {
+        size_t i = start;
+        while (i > 0 && std::isspace(static_cast<unsigned char>(line[i - 1]))) {
+            --i;
+        }
+        return i == 0 || line[i - 1] == '|';
+    }
+
+    // --- Fuzzy mode ---
+
+    /// Most matches offered in fuzzy mode, best first
+    constexpr size_t MAX_FUZZY_MATCHES = 200;
+
+    /// Words seen within this many history entries earn a recency bonus
+    constexpr int RECENCY_WINDOW = 200;
+    constexpr int RECENCY_BONUS = 32;
+
+    bool fuzzy_mode() {
+        const char* mode = getenv("COMPLETION_MODE");
+        return mode && std::strcmp(mode, "fuzzy") == 0;
+    }
+
+    // Maps every word in recent history to how many entries ago it was
+    // last used.
+    std::unordered_map<std::string, int> recent_words() {
+        std::unordered_map<std::string, int> ages;
+        HIST_ENTRY** list = history_list();
+        if (!list) return ages;
+
+        int oldest = std::max(0, history_length - RECENCY_WINDOW);
+        for (int i = history_length - 1; i >= oldest; --i) {
+            std::istringstream words(list[i]->line);
+            std::string word;
+            while (words >> word) {
+                ages.emplace(word, history_length - 1 - i);
+            }
+        }
+        return ages;
+    }
+
+    // Command-position candidates are rebuilt only when one of the
+    // directory listings behind them, or the set of builtins, has changed.
+    struct CommandIndex {
+        std::vector<std::pair<std::string, uint64_t>> sources;
+        std::vector<std::string> builtins;
+        fuzzy::CandidateSet candidates;
+    };
+    CommandIndex command_index;
+
+    const fuzzy::CandidateSet& command_candidates() {
+        auto deadline = Clock::now() + dircache::SCAN_BUDGET;
+        std::vector<std::string> dirs;
+
+        char* path_env = getenv("PATH");
+        if (path_env) {
+            std::string dir;
+            std::stringstream ss(path_env);
+            while (std::getline(ss, dir, ':')) {
+                if (!dir.empty()) dirs.push_back(dir);
+            }
+        }
+        dirs.push_back(".");
+
+        std::vector<dircache::Listing> listings;
+        std::vector<std::pair<std::string, uint64_t>> sources;
+        for (const auto& dir : dirs) {
+            listings.push_back(list_within(dir, deadline));
+            sources.emplace_back(dir, listings.back().version);
+        }
+        auto names = builtins::builtin_names();
+        if (sources == command_index.sources && names == command_index.builtins) {
+            return command_index.candidates;
+        }
+
+        std::set<std::string> unique(names.begin(), names.end());
+        for (const auto& listing : listings) {
+            for (const auto& ent : listing.entries) {
+                unique.insert(ent.name);
+            }
+        }
+        command_index.candidates.assign({unique.begin(), unique.end()});
+        command_index.sources = std::move(sources);
+        command_index.builtins = std::move(names);
+        return command_index.candidates;
+    }
+
+    // Scores candidates against `pattern`, boosts recently used words and
+    // returns the best first. `shown` is prepended to each candidate (the
+    // directory part of a path being completed).
+    std::vector<std::string> ranked_matches(const std::string& pattern,
+                                            const fuzzy::CandidateSet& set,
+                                            const std::string& shown) {
+        auto matches = set.match(pattern);
+        if (matches.empty()) return {};
+
+        const auto& items = set.items();
+        auto recent = recent_words();
+        for (auto& m : matches) {
+            auto it = recent.find(shown + items[m.index]);
+            if (it != recent.end()) {
+                m.score += RECENCY_BONUS * (RECENCY_WINDOW - it->second) /
+                           RECENCY_WINDOW;
+            }
+        }
+
+        size_t count = std::min(matches.size(), MAX_FUZZY_MATCHES);
+        std::partial_sort(matches.begin(),
+                          matches.begin() + static_cast<std::ptrdiff_t>(count),
+                          matches.end(),
+                          [&items](const fuzzy::Match& a, const fuzzy::Match& b) {
+            if (a.score != b.score) return a.score > b.score;
+            const auto& x = items[a.index];
+            const auto& y = items[b.index];
+            return x.size() != y.size() ? x.size() < y.size() : x < y;
+        });
+
+        std::vector<std::string> out;
+        out.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            out.push_back(shown + items[matches[i].index]);
+        }
+        return out;
+    }
+
+    std::vector<std::string> fuzzy_command_matches(const std::string& text) {
+        return ranked_matches(text, command_candidates(), "");
+    }
+
+    std::vector<std::string> fuzzy_path_matches(const std::string& text) {
+        size_t slash = text.rfind('/');
+        std::string shown = slash == std::string::npos
+            ? "" : text.substr(0, slash + 1);
+        std::string base = text.substr(shown.size());
+        std::string dir = shown.empty() ? "." : expand_tilde(shown);
+
+        std::vector<std::string> names;
+        auto deadline = Clock::now() + dircache::SCAN_BUDGET;
+        for (const auto& ent : list_within(dir, deadline).entries) {
+            if (ent.name[0] == '.' && (base.empty() || base[0] != '.')) {
+                continue;
+            }
+            names.push_back(ent.name);
+        }
+
+        fuzzy::CandidateSet set;
+        set.assign(std::move(names));
+        return ranked_matches(base, set, shown);
+    }
+
+
+    // Builtins, PATH executables and local files starting with `prefix`.
+    std::vector<std::string> command_matches(const std::string& prefix) {
         std::set<std::string> unique;
-        std::string prefix(text);
+        auto deadline = Clock::now() + dircache::SCAN_BUDGET;
 
         // Add matching builtins
-        for (const auto& builtin : builtins::builtin_list) {
+        for (const auto& builtin : builtins::builtin_names()) {
             if (builtin.rfind(prefix, 0) == 0) {
                 unique.insert(builtin);
             }
@@ -34,56 +215,97 @@ char* completion_generator(const char* text, int state) {
             std::string dir;
             std::stringstream ss(path_env);
             while (std::getline(ss, dir, ':')) {
-                DIR* dp = opendir(dir.c_str());
-                if (!dp) continue;
-                
-                dirent* ent;
-                while ((ent = readdir(dp))) {
-                    std::string name = ent->d_name;
-                    if (name.rfind(prefix, 0) == 0) {
-                        unique.insert(name);
+                if (dir.empty()) continue;
+                for (const auto& ent : list_within(dir, deadline).entries) {
+                    if (ent.name.rfind(prefix, 0) == 0) {
+                        unique.insert(ent.name);
                     }
                 }
-                closedir(dp);
             }
         }
 
         // Add matching files from current directory
-        DIR* cwd = opendir(".");
-        if (cwd) {
-            dirent* ent;
-            while ((ent = readdir(cwd))) {
-                std::string name = ent->d_name;
-                if (name.rfind(prefix, 0) == 0) {
-                    unique.insert(name);
-                }
+        for (const auto& ent : list_within(".", deadline).entries) {
+            if (ent.name.rfind(prefix, 0) == 0) {
+                unique.insert(ent.name);
             }
-            closedir(cwd);
         }
 
-        matches.assign(unique.begin(), unique.end());
+        return {unique.begin(), unique.end()};
     }
 
-    if (index >= matches.size()) {
-        return nullptr;
-    }
+    std::vector<std::string> path_matches(const std::string& word) {
+        if (word == "~") return {"~/"};
 
-    return strdup(matches[index++].c_str());
+        // Complete the last path component inside the directory named by
+        // everything up to the final slash, keeping the user's spelling
+        // (including a leading ~) in the results.
+        std::vector<std::string> matches;
+        size_t slash = word.rfind('/');
+        std::string shown = slash == std::string::npos
+            ? "" : word.substr(0, slash + 1);
+        std::string base = word.substr(shown.size());
+        std::string dir = shown.empty() ? "." : expand_tilde(shown);
+
+        auto deadline = Clock::now() + dircache::SCAN_BUDGET;
+        for (const auto& ent : list_within(dir, deadline).entries) {
+            // Hidden entries only when explicitly asked for
+            if (ent.name[0] == '.' && (base.empty() || base[0] != '.')) {
+                continue;
+            }
+            if (ent.name.rfind(base, 0) == 0) {
+                matches.push_back(shown + ent.name);
+            }
+        }
+        std::sort(matches.begin(), matches.end());
+        return matches;
+    }
 }
 
-char** completion_function(const char* text, int start, int /*end*/) {
-    // Only complete commands at the beginning of the line
-    if (start != 0) {
-        return nullptr;
+lineedit::Completions complete(const std::string& line, size_t start, size_t end) {
+    stats::add(stats::Counter::COMPLETIONS);
+    stats::Timer timer(stats::Latency::COMPLETION);
+    // Fuzzy ranking reads history
+    history::ensure_history_loaded();
+    pending_dirs.clear();
+
+    std::string text = line.substr(start, end - start);
+    bool command = in_command_position(line, start) && text.find('/') == std::string::npos;
+    bool fuzzy = fuzzy_mode();
+
+    lineedit::Completions result;
+    // Fuzzy results arrive ranked; the editor must not re-sort them.
+    result.ranked = fuzzy;
+    if (command) {
+        result.matches = fuzzy ? fuzzy_command_matches(text) : command_matches(text);
+    } else {
+        result.filenames = true;
+        result.matches = fuzzy ? fuzzy_path_matches(text) : path_matches(text);
+    }
+
+    if (result.matches.empty() && !pending_dirs.empty()) {
+        lineedit::show_message("(scanning " + pending_dirs.front() + "...)");
     }
-    
-    rl_attempted_completion_over = 1;
-    return rl_completion_matches(text, completion_generator);
+    return result;
 }
 
 void init_completion() {
-    rl_attempted_completion_function = completion_function;
+    lineedit::set_completer(complete);
+}
+
+void warm_up() {
+    startup::Phase phase("completion warm-up", true);
+
+    // Start scanning every PATH directory so the first TAB finds them cached
+    if (const char* path_env = getenv("PATH")) {
+        std::string dir;
+        std::stringstream ss(path_env);
+        while (std::getline(ss, dir, ':')) {
+            if (!dir.empty()) dircache::prefetch(dir);
+        }
+    }
+    dircache::prefetch(".");
 }
 
 } // namespace completion
-} // namespace shell
\ No newline at end of file
+} // namespace shell
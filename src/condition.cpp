@@ -0,0 +1,501 @@
+#include "condition.hpp"
+#include "arith.hpp"
+#include "variables.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <regex.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace shell {
+namespace condition {
+
+namespace {
+
+constexpr size_t REGEX_CACHE_LIMIT = 64;
+
+struct Regex {
+    regex_t re;
+    bool compiled = false;
+    ~Regex() {
+        if (compiled) regfree(&re);
+    }
+};
+
+// Compiled =~ patterns by their ERE text; a loop testing the same
+// pattern against many strings compiles it once.
+std::unordered_map<std::string, std::unique_ptr<Regex>> regex_cache;
+
+const char* const UNARY_OPS[] = {
+    "-a", "-b", "-c", "-d", "-e", "-f", "-g", "-h", "-k", "-p", "-r", "-s",
+    "-t", "-u", "-w", "-x", "-G", "-L", "-N", "-O", "-S", "-n", "-z", "-v", "-o",
+};
+
+const char* const BINARY_OPS[] = {
+    "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+    "-nt", "-ot", "-ef",
+};
+
+bool is_unary(const std::string& word) {
+    for (const char* op : UNARY_OPS) {
+        if (word == op) return true;
+    }
+    return false;
+}
+
+bool is_binary(const std::string& word, bool extended) {
+    for (const char* op : BINARY_OPS) {
+        if (word == op) return true;
+    }
+    return extended ? word == "=~" : word == "-a" || word == "-o";
+}
+
+// Removes the tokenizer's quoting escapes from a [[ word.
+std::string unescape(const std::string& word) {
+    std::string out;
+    out.reserve(word.size());
+    for (size_t i = 0; i < word.size(); ++i) {
+        if (word[i] == '\\' && i + 1 < word.size()) ++i;
+        out += word[i];
+    }
+    return out;
+}
+
+// Turns a [[ word into an ERE: escapes stay only on characters the ERE
+// grammar gives a meaning, since glibc reads "\<" and "\w" as operators.
+std::string to_regex(const std::string& word) {
+    std::string out;
+    out.reserve(word.size());
+    for (size_t i = 0; i < word.size(); ++i) {
+        if (word[i] == '\\' && i + 1 < word.size()) {
+            char c = word[++i];
+            if (std::strchr(".[]()*+?{}|^$\\", c)) out += '\\';
+            out += c;
+        } else {
+            out += word[i];
+        }
+    }
+    return out;
+}
+
+const Regex* compile(const std::string& pattern, std::string& error) {
+    auto it = regex_cache.find(pattern);
+    if (it != regex_cache.end()) return it->second.get();
+
+    auto regex = std::make_unique<Regex>();
+    int rc = regcomp(&regex->re, pattern.c_str(), REG_EXTENDED);
+    if (rc != 0) {
+        char buf[256];
+        regerror(rc, &regex->re, buf, sizeof(buf));
+        error = buf;
+        return nullptr;
+    }
+    regex->compiled = true;
+
+    if (regex_cache.size() >= REGEX_CACHE_LIMIT) regex_cache.clear();
+    return regex_cache.emplace(pattern, std::move(regex)).first->second.get();
+}
+
+// Parses a test(1) integer: optional blanks and sign around decimal digits.
+bool parse_integer(const std::string& text, int64_t& value) {
+    const char* start = text.c_str();
+    while (*start == ' ' || *start == '\t') ++start;
+    if (!*start) return false;
+
+    char* end;
+    errno = 0;
+    long long v = std::strtoll(start, &end, 10);
+    if (end == start || errno == ERANGE || !std::isdigit(static_cast<unsigned char>(end[-1]))) {
+        return false;
+    }
+    while (*end == ' ' || *end == '\t') ++end;
+    if (*end) return false;
+    value = v;
+    return true;
+}
+
+bool newer(const struct stat& a, const struct stat& b) {
+    return a.st_mtim.tv_sec != b.st_mtim.tv_sec ? a.st_mtim.tv_sec > b.st_mtim.tv_sec
+                                                : a.st_mtim.tv_nsec > b.st_mtim.tv_nsec;
+}
+
+// Evaluates one conditional command. Parsing and evaluation happen in a
+// single pass; operands skipped by && || short-circuiting are parsed with
+// `active` false so they have no side effects.
+class Evaluator {
+public:
+    Evaluator(const std::vector<std::string>& words, size_t begin, size_t end,
+              std::string name, bool extended)
+        : words_(words), pos_(begin), end_(end), name_(std::move(name)),
+          extended_(extended) {}
+
+    int run() {
+        bool result = extended_ ? run_extended() : run_test();
+        if (failed_) return 2;
+        return result ? 0 : 1;
+    }
+
+private:
+    const std::vector<std::string>& words_;
+    size_t pos_;
+    size_t end_;
+    std::string name_;
+    bool extended_;
+    bool failed_ = false;
+    // stat()/lstat() results by path, shared by the tests in this command
+    std::map<std::string, std::optional<struct stat>> stats_[2];
+
+    size_t left() const { return end_ - pos_; }
+    const std::string& peek(size_t ahead = 0) const { return words_[pos_ + ahead]; }
+
+    bool fail(const std::string& message) {
+        if (!failed_) std::cerr << name_ << ": " << message << "\n";
+        failed_ = true;
+        return false;
+    }
+
+    // Operand text: [[ words carry quoting escapes, test words don't.
+    std::string text(const std::string& word) const {
+        return extended_ ? unescape(word) : word;
+    }
+
+    const struct stat* stat_of(const std::string& path, bool follow) {
+        auto& cache = stats_[follow ? 1 : 0];
+        auto it = cache.find(path);
+        if (it == cache.end()) {
+            struct stat st;
+            int rc = follow ? stat(path.c_str(), &st) : lstat(path.c_str(), &st);
+            it = cache.emplace(path, rc == 0 ? std::optional<struct stat>(st)
+                                             : std::nullopt).first;
+        }
+        return it->second ? &*it->second : nullptr;
+    }
+
+    bool integer(const std::string& word, int64_t& value) {
+        std::string operand = text(word);
+        if (extended_) {
+            if (arith::evaluate(operand, value)) return true;
+            failed_ = true;
+            return false;
+        }
+        if (parse_integer(operand, value)) return true;
+        return fail(operand + ": integer expression expected");
+    }
+
+    bool unary(const std::string& op, const std::string& word) {
+        std::string operand = text(word);
+        char c = op[1];
+        switch (c) {
+            case 'n': return !operand.empty();
+            case 'z': return operand.empty();
+            case 'v': return variables::is_set(operand);
+            case 'o': return false;  // no shell options to query
+            case 'r': return faccessat(AT_FDCWD, operand.c_str(), R_OK, AT_EACCESS) == 0;
+            case 'w': return faccessat(AT_FDCWD, operand.c_str(), W_OK, AT_EACCESS) == 0;
+            case 'x': return faccessat(AT_FDCWD, operand.c_str(), X_OK, AT_EACCESS) == 0;
+            case 't': {
+                int64_t fd;
+                if (!parse_integer(operand, fd)) return fail(operand + ": integer expression expected");
+                return fd >= 0 && fd <= INT32_MAX && isatty(static_cast<int>(fd));
+            }
+            case 'h':
+            case 'L': {
+                const struct stat* st = stat_of(operand, false);
+                return st && S_ISLNK(st->st_mode);
+            }
+            default:
+                break;
+        }
+
+        const struct stat* st = stat_of(operand, true);
+        if (!st) return false;
+        switch (c) {
+            case 'a':
+            case 'e': return true;
+            case 'b': return S_ISBLK(st->st_mode);
+            case 'c': return S_ISCHR(st->st_mode);
+            case 'd': return S_ISDIR(st->st_mode);
+            case 'f': return S_ISREG(st->st_mode);
+            case 'p': return S_ISFIFO(st->st_mode);
+            case 'S': return S_ISSOCK(st->st_mode);
+            case 'g': return st->st_mode & S_ISGID;
+            case 'u': return st->st_mode & S_ISUID;
+            case 'k': return st->st_mode & S_ISVTX;
+            case 's': return st->st_size > 0;
+            case 'O': return st->st_uid == geteuid();
+            case 'G': return st->st_gid == getegid();
+            case 'N': {
+                const struct timespec& m = st->st_mtim;
+                const struct timespec& a = st->st_atim;
+                return m.tv_sec != a.tv_sec ? m.tv_sec > a.tv_sec : m.tv_nsec > a.tv_nsec;
+            }
+            default: return false;
+        }
+    }
+
+    bool match_regex(const std::string& subject, const std::string& word) {
+        std::string error;
+        const Regex* regex = compile(to_regex(word), error);
+        if (!regex) return fail(unescape(word) + ": " + error);
+
+        std::vector<regmatch_t> groups(regex->re.re_nsub + 1);
+        if (regexec(&regex->re, subject.c_str(), groups.size(), groups.data(), 0) != 0) {
+            variables::set_array("BASH_REMATCH", {});
+            return false;
+        }
+        std::vector<std::string> captured;
+        for (const auto& group : groups) {
+            captured.push_back(group.rm_so < 0
+                ? std::string()
+                : subject.substr(static_cast<size_t>(group.rm_so),
+                                 static_cast<size_t>(group.rm_eo - group.rm_so)));
+        }
+        variables::set_array("BASH_REMATCH", std::move(captured));
+        return true;
+    }
+
+    bool binary(const std::string& lhs, const std::string& op, const std::string& rhs) {
+        if (op == "-a") return !lhs.empty() && !rhs.empty();
+        if (op == "-o") return !lhs.empty() || !rhs.empty();
+
+        std::string a = text(lhs);
+        if (extended_ && (op == "==" || op == "=" || op == "!=")) {
+            int flags = 0;
+#ifdef FNM_EXTMATCH
+            flags |= FNM_EXTMATCH;
+#endif
+            bool matched = fnmatch(rhs.c_str(), a.c_str(), flags) == 0;
+            return op == "!=" ? !matched : matched;
+        }
+        if (op == "=~") return match_regex(a, rhs);
+
+        std::string b = text(rhs);
+        if (op == "=" || op == "==") return a == b;
+        if (op == "!=") return a != b;
+        // [[ sorts in the current locale, test by byte value.
+        if (op == "<") return (extended_ ? strcoll(a.c_str(), b.c_str()) : a.compare(b)) < 0;
+        if (op == ">") return (extended_ ? strcoll(a.c_str(), b.c_str()) : a.compare(b)) > 0;
+
+        if (op == "-nt" || op == "-ot" || op == "-ef") {
+            const struct stat* sa = stat_of(a, true);
+            const struct stat* sb = stat_of(b, true);
+            if (op == "-ef") {
+                return sa && sb && sa->st_dev == sb->st_dev && sa->st_ino == sb->st_ino;
+            }
+            if (op == "-ot") std::swap(sa, sb);
+            return sa && (!sb || newer(*sa, *sb));
+        }
+
+        int64_t x, y;
+        if (!integer(lhs, x) || !integer(rhs, y)) return false;
+        if (op == "-eq") return x == y;
+        if (op == "-ne") return x != y;
+        if (op == "-lt") return x < y;
+        if (op == "-le") return x <= y;
+        if (op == "-gt") return x > y;
+        return x >= y;
+    }
+
+    // --- test and [ ---
+
+    // POSIX decides by argument count first, so `[ -f ]` and `[ = ]`
+    // are plain strings rather than operators missing their operands.
+    bool run_test() {
+        bool result = false;
+        switch (left()) {
+            case 0:
+                return false;
+            case 1:
+                return !peek().empty();
+            case 2:
+                result = test_two();
+                break;
+            case 3:
+                result = test_three();
+                break;
+            case 4:
+                if (peek() == "!") {
+                    ++pos_;
+                    result = !test_three();
+                } else if (peek() == "(" && peek(3) == ")") {
+                    ++pos_;
+                    result = test_two();
+                    ++pos_;
+                } else {
+                    result = test_or(true);
+                }
+                break;
+            default:
+                result = test_or(true);
+        }
+        if (!failed_ && left() > 0) fail("too many arguments");
+        return result;
+    }
+
+    bool test_two() {
+        const std::string& first = peek();
+        const std::string& second = peek(1);
+        pos_ += 2;
+        if (first == "!") return second.empty();
+        if (is_unary(first)) return unary(first, second);
+        return fail(first + ": unary operator expected");
+    }
+
+    bool test_three() {
+        if (is_binary(peek(1), false)) {
+            pos_ += 3;
+            return binary(words_[pos_ - 3], words_[pos_ - 2], words_[pos_ - 1]);
+        }
+        if (peek() == "!") {
+            ++pos_;
+            return !test_two();
+        }
+        if (peek() == "(" && peek(2) == ")") {
+            pos_ += 3;
+            return !words_[pos_ - 2].empty();
+        }
+        return test_or(true);
+    }
+
+    bool test_or(bool active) {
+        bool result = test_and(active);
+        while (!failed_ && left() > 0 && peek() == "-o") {
+            ++pos_;
+            bool rhs = test_and(active && !result);
+            result = result || rhs;
+        }
+        return result;
+    }
+
+    bool test_and(bool active) {
+        bool result = test_term(active);
+        while (!failed_ && left() > 0 && peek() == "-a") {
+            ++pos_;
+            bool rhs = test_term(active && result);
+            result = result && rhs;
+        }
+        return result;
+    }
+
+    bool test_term(bool active) {
+        if (left() == 0) return fail("argument expected");
+        const std::string& word = peek();
+
+        if (word == "!") {
+            ++pos_;
+            return !test_term(active);
+        }
+        if (word == "(" && left() > 1) {
+            ++pos_;
+            bool result = test_or(active);
+            if (left() == 0 || peek() != ")") return fail("`)' expected");
+            ++pos_;
+            return result;
+        }
+        if (left() >= 3 && is_binary(peek(1), false) && peek(1) != "-a" && peek(1) != "-o") {
+            pos_ += 3;
+            return active && binary(words_[pos_ - 3], words_[pos_ - 2], words_[pos_ - 1]);
+        }
+        if (left() >= 2 && is_unary(word)) {
+            pos_ += 2;
+            return active && unary(word, words_[pos_ - 1]);
+        }
+        ++pos_;
+        return !word.empty();
+    }
+
+    // --- [[ ---
+
+    bool run_extended() {
+        if (left() == 0) return fail("syntax error in conditional expression");
+        bool result = ext_or(true);
+        if (!failed_ && left() > 0) {
+            fail("syntax error near `" + text(peek()) + "'");
+        }
+        return result;
+    }
+
+    bool ext_or(bool active) {
+        bool result = ext_and(active);
+        while (!failed_ && left() > 0 && peek() == "||") {
+            ++pos_;
+            bool rhs = ext_and(active && !result);
+            result = result || rhs;
+        }
+        return result;
+    }
+
+    bool ext_and(bool active) {
+        bool result = ext_not(active);
+        while (!failed_ && left() > 0 && peek() == "&&") {
+            ++pos_;
+            bool rhs = ext_not(active && result);
+            result = result && rhs;
+        }
+        return result;
+    }
+
+    bool ext_not(bool active) {
+        if (left() > 0 && peek() == "!") {
+            ++pos_;
+            return !ext_not(active);
+        }
+        return ext_primary(active);
+    }
+
+    bool ext_primary(bool active) {
+        if (left() == 0) return fail("syntax error in conditional expression");
+        const std::string& word = peek();
+
+        if (word == "(") {
+            ++pos_;
+            bool result = ext_or(active);
+            if (left() == 0 || peek() != ")") return fail("expected `)'");
+            ++pos_;
+            return result;
+        }
+        if (left() >= 2 && is_binary(peek(1), true)) {
+            if (left() < 3) return fail("unexpected argument to conditional binary operator");
+            pos_ += 3;
+            return active && binary(words_[pos_ - 3], words_[pos_ - 2], words_[pos_ - 1]);
+        }
+        if (is_unary(word)) {
+            if (left() < 2) return fail("unexpected argument to conditional unary operator");
+            pos_ += 2;
+            return active && unary(word, words_[pos_ - 1]);
+        }
+        ++pos_;
+        return !text(word).empty();
+    }
+};
+
+} // namespace
+
+int evaluate(const std::vector<std::string>& args) {
+    const std::string& name = args[0];
+    size_t end = args.size();
+
+    if (name == "[" || name == "[[") {
+        const char* close = name == "[" ? "]" : "]]";
+        if (end < 2 || args[end - 1] != close) {
+            std::cerr << name << ": missing `" << close << "'\n";
+            return 2;
+        }
+        --end;
+    }
+    return Evaluator(args, 1, end, name, name == "[[").run();
+}
+
+} // namespace condition
+} // namespace shell
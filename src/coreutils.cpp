@@ -0,0 +1,724 @@
+// Native cat, head, tail and wc. They are off by default; `enable cat`
+// turns one on, after which `cat f | grep x` saves a fork+exec per stage.
+// Only the options scripts commonly use are supported, and anything else
+// is rejected rather than guessed at.
+
+#include "builtins.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace shell {
+namespace builtins {
+
+namespace {
+
+/// Read size for the user-space paths
+constexpr size_t BLOCK = 128 * 1024;
+
+/// Chunk handed to the kernel per copy_file_range/sendfile/splice call
+constexpr size_t KERNEL_CHUNK = 1024 * 1024;
+
+/// Count width wc uses when an input's size isn't known up front
+constexpr int WC_DEFAULT_WIDTH = 7;
+
+// One input operand: a named file, or stdin for "-".
+struct Input {
+    int fd = -1;
+    std::string name;
+    bool owned = false;
+};
+
+bool open_input(const char* cmd, const std::string& operand, Input& in) {
+    if (operand == "-") {
+        in = {STDIN_FILENO, "standard input", false};
+        return true;
+    }
+    int fd = open(operand.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << cmd << ": " << operand << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    in = {fd, operand, true};
+    return true;
+}
+
+void close_input(const Input& in) {
+    if (in.owned) close(in.fd);
+}
+
+void report_error(const char* cmd, const Input& in) {
+    std::cerr << cmd << ": " << in.name << ": " << strerror(errno) << std::endl;
+}
+
+void unsupported_option(const char* cmd, const std::string& opt) {
+    std::cerr << cmd << ": " << opt << ": option not supported by the builtin"
+              << " (run 'enable -n " << cmd << "' to use " << cmd << " from PATH)\n";
+}
+
+ssize_t read_some(int fd, char* buf, size_t len) {
+    ssize_t n;
+    do {
+        n = read(fd, buf, len);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+bool write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool write_str(const std::string& s) {
+    return write_all(STDOUT_FILENO, s.data(), s.size());
+}
+
+#ifdef __linux__
+
+enum class Copy { DONE, UNSUPPORTED, FAILED };
+
+// Runs one zero-copy primitive until EOF. Each of them advances the file
+// offsets, so after UNSUPPORTED the caller can carry on with a slower
+// method from wherever this one stopped.
+template <typename Step>
+Copy kernel_copy(Step step) {
+    for (;;) {
+        ssize_t n = step();
+        if (n > 0) continue;
+        if (n == 0) return Copy::DONE;
+        if (errno == EINTR) continue;
+        if (errno == EINVAL || errno == ENOSYS || errno == EXDEV ||
+            errno == EOPNOTSUPP || errno == EBADF) {
+            return Copy::UNSUPPORTED;
+        }
+        return Copy::FAILED;
+    }
+}
+
+#endif
+
+// Copies `in` to `out` until EOF, picking the cheapest path the pair of
+// descriptors allows: copy_file_range between regular files (a reflink on
+// CoW filesystems), sendfile from a regular file, splice when either end
+// is a pipe, and read/write otherwise.
+bool copy_fd(int in, int out) {
+#ifdef __linux__
+    struct stat in_sb, out_sb;
+    if (fstat(in, &in_sb) == 0 && fstat(out, &out_sb) == 0) {
+        Copy result = Copy::UNSUPPORTED;
+        if (S_ISREG(in_sb.st_mode) && S_ISREG(out_sb.st_mode)) {
+            result = kernel_copy([&] {
+                return copy_file_range(in, nullptr, out, nullptr, KERNEL_CHUNK, 0);
+            });
+        }
+        if (result == Copy::UNSUPPORTED && S_ISREG(in_sb.st_mode)) {
+            result = kernel_copy([&] {
+                return sendfile(out, in, nullptr, KERNEL_CHUNK);
+            });
+        }
+        if (result == Copy::UNSUPPORTED &&
+            (S_ISFIFO(in_sb.st_mode) || S_ISFIFO(out_sb.st_mode))) {
+            result = kernel_copy([&] {
+                return splice(in, nullptr, out, nullptr, KERNEL_CHUNK, SPLICE_F_MOVE);
+            });
+        }
+        if (result != Copy::UNSUPPORTED) return result == Copy::DONE;
+    }
+#endif
+
+    std::vector<char> buf(BLOCK);
+    for (;;) {
+        ssize_t n = read_some(in, buf.data(), buf.size());
+        if (n < 0) return false;
+        if (n == 0) return true;
+        if (!write_all(out, buf.data(), static_cast<size_t>(n))) return false;
+    }
+}
+
+// Parses a non-negative decimal count; rejects signs and trailing junk.
+bool parse_count(const std::string& s, uint64_t& out) {
+    if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    errno = 0;
+    out = std::strtoull(s.c_str(), nullptr, 10);
+    return errno == 0;
+}
+
+// Options shared by head and tail: -n N, -c N, -N (and +N for tail).
+struct CountOptions {
+    uint64_t count = 10;
+    bool bytes = false;
+    bool from_start = false;  ///< tail +N: start at line/byte N
+    std::vector<std::string> operands;
+};
+
+bool parse_count_options(const char* cmd, const std::vector<std::string>& args,
+                         bool allow_plus, CountOptions& opts) {
+    size_t i = 1;
+    for (; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg == "--") {
+            ++i;
+            break;
+        }
+        if (arg.size() < 2 || arg[0] != '-') break;
+
+        std::string value;
+        if (arg[1] == 'n' || arg[1] == 'c') {
+            opts.bytes = arg[1] == 'c';
+            if (arg.size() > 2) {
+                value = arg.substr(2);
+            } else if (i + 1 < args.size()) {
+                value = args[++i];
+            } else {
+                std::cerr << cmd << ": option requires an argument -- '" << arg[1] << "'\n";
+                return false;
+            }
+        } else if (std::isdigit(static_cast<unsigned char>(arg[1]))) {
+            value = arg.substr(1);
+        } else {
+            unsupported_option(cmd, arg);
+            return false;
+        }
+
+        opts.from_start = false;
+        if (allow_plus && !value.empty() && value[0] == '+') {
+            opts.from_start = true;
+            value.erase(0, 1);
+        }
+        if (!parse_count(value, opts.count)) {
+            std::cerr << cmd << ": invalid number of "
+                      << (opts.bytes ? "bytes" : "lines") << ": '" << value << "'\n";
+            return false;
+        }
+    }
+
+    opts.operands.assign(args.begin() + static_cast<std::ptrdiff_t>(i), args.end());
+    if (opts.operands.empty()) opts.operands.push_back("-");
+    return true;
+}
+
+// Prints the "==> name <==" banner head and tail use for several files.
+bool write_banner(const Input& in, bool first) {
+    return write_str((first ? "==> " : "\n==> ") + in.name + " <==\n");
+}
+
+// Writes the first `count` lines (or bytes) of `fd` to `out`, or drops
+// them if `out` is negative. Input is read in blocks; the over-read tail
+// of the last block goes to `leftover` if given, otherwise the offset is
+// moved back to just past what was consumed (a no-op on pipes), so the
+// next reader of a shared descriptor starts where head stopped.
+bool head_fd(int fd, int out, uint64_t count, bool bytes,
+             std::string* leftover = nullptr) {
+    std::vector<char> buf(BLOCK);
+    uint64_t left = count;
+
+    while (left > 0) {
+        ssize_t got = read_some(fd, buf.data(), buf.size());
+        if (got < 0) return false;
+        if (got == 0) break;
+
+        auto len = static_cast<size_t>(got);
+        size_t used = len;
+        if (bytes) {
+            used = static_cast<size_t>(std::min<uint64_t>(left, len));
+            left -= used;
+        } else {
+            const char* p = buf.data();
+            const char* end = p + len;
+            while (left > 0) {
+                auto nl = static_cast<const char*>(
+                    std::memchr(p, '\n', static_cast<size_t>(end - p)));
+                if (!nl) break;
+                p = nl + 1;
+                --left;
+            }
+            if (left == 0) used = static_cast<size_t>(p - buf.data());
+        }
+
+        if (out >= 0 && !write_all(out, buf.data(), used)) return false;
+        if (used < len) {
+            if (leftover) {
+                leftover->assign(buf.data() + used, len - used);
+            } else {
+                lseek(fd, -static_cast<off_t>(len - used), SEEK_CUR);
+            }
+        }
+    }
+    return true;
+}
+
+// Finds the last '\n' in [p, p + len), or nullptr.
+const char* find_last_newline(const char* p, size_t len) {
+#ifdef __GLIBC__
+    return static_cast<const char*>(memrchr(p, '\n', len));
+#else
+    while (len > 0) {
+        if (p[--len] == '\n') return p + len;
+    }
+    return nullptr;
+#endif
+}
+
+// Offset where the last `count` lines of a seekable file start. Blocks are
+// read backwards from the end, so a 10-line tail of a huge log touches
+// one block instead of the whole file.
+bool tail_start(int fd, off_t begin, off_t size, uint64_t count, off_t& start) {
+    start = begin;
+    if (count == 0) {
+        start = size;
+        return true;
+    }
+
+    std::vector<char> buf(BLOCK);
+    uint64_t seen = 0;
+    off_t pos = size;
+    while (pos > begin) {
+        auto len = static_cast<size_t>(std::min<off_t>(static_cast<off_t>(BLOCK), pos - begin));
+        pos -= static_cast<off_t>(len);
+        ssize_t got = pread(fd, buf.data(), len, pos);
+        if (got != static_cast<ssize_t>(len)) return false;
+
+        // A newline in the file's final byte ends the last line rather
+        // than starting a new one.
+        size_t scan = len;
+        if (pos + static_cast<off_t>(len) == size && buf[len - 1] == '\n') --scan;
+
+        while (const char* nl = find_last_newline(buf.data(), scan)) {
+            if (++seen == count) {
+                start = pos + (nl - buf.data()) + 1;
+                return true;
+            }
+            scan = static_cast<size_t>(nl - buf.data());
+        }
+    }
+    return true;
+}
+
+// Tail of a pipe or terminal: keeps only as many trailing blocks as can
+// still contain the answer, so memory stays bounded by the output size.
+bool tail_stream(int fd, uint64_t count, bool bytes) {
+    std::deque<std::string> chunks;
+    std::deque<uint64_t> newlines;
+    uint64_t total_bytes = 0;
+    uint64_t total_newlines = 0;
+    std::vector<char> buf(BLOCK);
+
+    for (;;) {
+        ssize_t got = read_some(fd, buf.data(), buf.size());
+        if (got < 0) return false;
+        if (got == 0) break;
+
+        auto len = static_cast<size_t>(got);
+        chunks.emplace_back(buf.data(), len);
+        auto nl = static_cast<uint64_t>(std::count(buf.data(), buf.data() + len, '\n'));
+        newlines.push_back(nl);
+        total_bytes += len;
+        total_newlines += nl;
+
+        // The front chunk can go once the rest alone covers the answer.
+        while (chunks.size() > 1) {
+            uint64_t rest_bytes = total_bytes - chunks.front().size();
+            uint64_t rest_newlines = total_newlines - newlines.front();
+            if (bytes ? rest_bytes < count : rest_newlines <= count) break;
+            total_bytes = rest_bytes;
+            total_newlines = rest_newlines;
+            chunks.pop_front();
+            newlines.pop_front();
+        }
+    }
+
+    std::string data;
+    data.reserve(static_cast<size_t>(total_bytes));
+    for (const auto& chunk : chunks) data += chunk;
+
+    size_t start = 0;
+    if (bytes) {
+        if (count < data.size()) start = data.size() - static_cast<size_t>(count);
+    } else if (count == 0) {
+        start = data.size();
+    } else {
+        size_t scan = data.size();
+        if (scan > 0 && data[scan - 1] == '\n') --scan;
+        uint64_t seen = 0;
+        while (const char* nl = find_last_newline(data.data(), scan)) {
+            scan = static_cast<size_t>(nl - data.data());
+            if (++seen == count) {
+                start = scan + 1;
+                break;
+            }
+        }
+    }
+    return write_all(STDOUT_FILENO, data.data() + start, data.size() - start);
+}
+
+bool tail_fd(int fd, const CountOptions& opts) {
+    if (opts.from_start) {
+        // +N: discard everything before line/byte N, then copy the rest.
+        std::string rest;
+        if (opts.count > 1 && !head_fd(fd, -1, opts.count - 1, opts.bytes, &rest)) {
+            return false;
+        }
+        return write_str(rest) && copy_fd(fd, STDOUT_FILENO);
+    }
+
+    struct stat sb;
+    off_t begin = lseek(fd, 0, SEEK_CUR);
+    if (fstat(fd, &sb) != 0 || !S_ISREG(sb.st_mode) || begin < 0) {
+        return tail_stream(fd, opts.count, opts.bytes);
+    }
+
+    off_t start;
+    if (opts.bytes) {
+        auto want = static_cast<off_t>(std::min<uint64_t>(
+            opts.count, static_cast<uint64_t>(sb.st_size)));
+        start = std::max(begin, sb.st_size - want);
+    } else if (!tail_start(fd, begin, sb.st_size, opts.count, start)) {
+        return false;
+    }
+    return lseek(fd, start, SEEK_SET) >= 0 && copy_fd(fd, STDOUT_FILENO);
+}
+
+struct Counts {
+    uint64_t lines = 0;
+    uint64_t words = 0;
+    uint64_t bytes = 0;
+};
+
+// Whitespace in the C locale: space and \t \n \v \f \r.
+inline bool is_space(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Counts newlines and words. As with GNU wc, a word is started by a
+// printable character; other non-space bytes (controls, bytes >= 0x80)
+// neither start nor end one. `in_word` carries the state across calls.
+void count_scalar(const unsigned char* p, size_t len, Counts& c, bool& in_word) {
+    for (size_t i = 0; i < len; ++i) {
+        c.lines += p[i] == '\n';
+        if (is_space(p[i])) {
+            in_word = false;
+        } else if (p[i] > ' ' && p[i] < 0x7f) {
+            c.words += !in_word;
+            in_word = true;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// 32 bytes per step. In a block of only spaces and printable bytes, a byte
+// starts a word when it isn't whitespace and the byte before it is, so the
+// word starts are ~ws & (ws << 1 | carry-in). Blocks holding any other
+// byte are rare in text and go through the scalar loop.
+__attribute__((target("avx2")))
+size_t count_avx2(const unsigned char* p, size_t len, Counts& c, bool& in_word) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    const __m256i bang = _mm256_set1_epi8('!');
+    const __m256i graph_span = _mm256_set1_epi8('~' - '!');
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        // \t..\r is the range 9..13: (v - 9) <= 4 as unsigned bytes.
+        __m256i t = _mm256_sub_epi8(v, tab);
+        __m256i ctl = _mm256_cmpeq_epi8(_mm256_min_epu8(t, four), t);
+        __m256i ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, space), ctl);
+        __m256i g = _mm256_sub_epi8(v, bang);
+        __m256i graph = _mm256_cmpeq_epi8(_mm256_min_epu8(g, graph_span), g);
+
+        auto wsm = static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(ws)));
+        auto known = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(ws, graph)));
+        if (known != 0xFFFFFFFFu) {
+            count_scalar(p + i, 32, c, in_word);
+            continue;
+        }
+
+        auto nl = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)));
+        uint64_t starts = ~wsm & ((wsm << 1) | (in_word ? 0 : 1)) & 0xFFFFFFFFu;
+        c.lines += static_cast<uint64_t>(__builtin_popcount(nl));
+        c.words += static_cast<uint64_t>(__builtin_popcountll(starts));
+        in_word = (wsm >> 31) == 0;
+    }
+    return i;
+}
+
+#endif
+
+#ifdef __SSE2__
+
+size_t count_sse2(const unsigned char* p, size_t len, Counts& c, bool& in_word) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    const __m128i bang = _mm_set1_epi8('!');
+    const __m128i graph_span = _mm_set1_epi8('~' - '!');
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i t = _mm_sub_epi8(v, tab);
+        __m128i ctl = _mm_cmpeq_epi8(_mm_min_epu8(t, four), t);
+        __m128i ws = _mm_or_si128(_mm_cmpeq_epi8(v, space), ctl);
+        __m128i g = _mm_sub_epi8(v, bang);
+        __m128i graph = _mm_cmpeq_epi8(_mm_min_epu8(g, graph_span), g);
+
+        auto wsm = static_cast<uint32_t>(_mm_movemask_epi8(ws));
+        auto known = static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(ws, graph)));
+        if (known != 0xFFFFu) {
+            count_scalar(p + i, 16, c, in_word);
+            continue;
+        }
+
+        auto nl = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+        uint32_t starts = ~wsm & ((wsm << 1) | (in_word ? 0u : 1u)) & 0xFFFFu;
+        c.lines += static_cast<uint64_t>(__builtin_popcount(nl));
+        c.words += static_cast<uint64_t>(__builtin_popcount(starts));
+        in_word = (wsm >> 15) == 0;
+    }
+    return i;
+}
+
+#endif
+
+void count_block(const unsigned char* p, size_t len, Counts& c, bool& in_word) {
+    size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) {
+        done = count_avx2(p, len, c, in_word);
+    }
+#endif
+#ifdef __SSE2__
+    done += count_sse2(p + done, len - done, c, in_word);
+#endif
+    count_scalar(p + done, len - done, c, in_word);
+    c.bytes += len;
+}
+
+bool wc_fd(int fd, bool need_scan, Counts& c) {
+    struct stat sb;
+    if (!need_scan && fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode)) {
+        // Byte count only: the size is already known.
+        off_t pos = lseek(fd, 0, SEEK_CUR);
+        c.bytes = static_cast<uint64_t>(sb.st_size - std::min(std::max<off_t>(pos, 0), sb.st_size));
+        return true;
+    }
+
+    std::vector<unsigned char> buf(BLOCK);
+    bool in_word = false;
+    for (;;) {
+        ssize_t got = read_some(fd, reinterpret_cast<char*>(buf.data()), buf.size());
+        if (got < 0) return false;
+        if (got == 0) return true;
+        count_block(buf.data(), static_cast<size_t>(got), c, in_word);
+    }
+}
+
+} // namespace
+
+int builtin_cat(const std::vector<std::string>& args) {
+    std::vector<std::string> operands;
+    bool options = true;
+    for (size_t i = 1; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (options && arg == "--") {
+            options = false;
+        } else if (options && arg == "-u") {
+            // POSIX unbuffered output: already the case.
+        } else if (options && arg.size() > 1 && arg[0] == '-') {
+            unsupported_option("cat", arg);
+            return 2;
+        } else {
+            operands.push_back(arg);
+        }
+    }
+    if (operands.empty()) operands.push_back("-");
+
+    int status = 0;
+    for (const auto& operand : operands) {
+        Input in;
+        if (!open_input("cat", operand, in)) {
+            status = 1;
+            continue;
+        }
+        if (!copy_fd(in.fd, STDOUT_FILENO)) {
+            report_error("cat", in);
+            status = 1;
+        }
+        close_input(in);
+    }
+    return status;
+}
+
+int builtin_head(const std::vector<std::string>& args) {
+    CountOptions opts;
+    if (!parse_count_options("head", args, false, opts)) return 2;
+
+    int status = 0;
+    bool first = true;
+    for (const auto& operand : opts.operands) {
+        Input in;
+        if (!open_input("head", operand, in)) {
+            status = 1;
+            continue;
+        }
+        if (opts.operands.size() > 1) write_banner(in, first);
+        first = false;
+        if (!head_fd(in.fd, STDOUT_FILENO, opts.count, opts.bytes)) {
+            report_error("head", in);
+            status = 1;
+        }
+        close_input(in);
+    }
+    return status;
+}
+
+int builtin_tail(const std::vector<std::string>& args) {
+    CountOptions opts;
+    if (!parse_count_options("tail", args, true, opts)) return 2;
+
+    int status = 0;
+    bool first = true;
+    for (const auto& operand : opts.operands) {
+        Input in;
+        if (!open_input("tail", operand, in)) {
+            status = 1;
+            continue;
+        }
+        if (opts.operands.size() > 1) write_banner(in, first);
+        first = false;
+        if (!tail_fd(in.fd, opts)) {
+            report_error("tail", in);
+            status = 1;
+        }
+        close_input(in);
+    }
+    return status;
+}
+
+int builtin_wc(const std::vector<std::string>& args) {
+    bool lines = false, words = false, bytes = false;
+    std::vector<std::string> operands;
+    bool options = true;
+    for (size_t i = 1; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (options && arg == "--") {
+            options = false;
+        } else if (options && arg.size() > 1 && arg[0] == '-') {
+            for (size_t j = 1; j < arg.size(); ++j) {
+                switch (arg[j]) {
+                    case 'l': lines = true; break;
+                    case 'w': words = true; break;
+                    case 'c': bytes = true; break;
+                    default:
+                        unsupported_option("wc", arg);
+                        return 2;
+                }
+            }
+        } else {
+            operands.push_back(arg);
+        }
+    }
+    if (!lines && !words && !bytes) lines = words = bytes = true;
+
+    bool named = !operands.empty();
+    if (!named) operands.push_back("-");
+
+    // Open everything first: as with coreutils, the column width depends
+    // on the total size of the inputs.
+    std::vector<Input> inputs;
+    std::vector<std::string> names;
+    int status = 0;
+    int min_width = 1;
+    uint64_t regular_total = 0;
+    for (const auto& operand : operands) {
+        Input in;
+        if (!open_input("wc", operand, in)) {
+            status = 1;
+            continue;
+        }
+        struct stat sb;
+        if (fstat(in.fd, &sb) == 0 && S_ISREG(sb.st_mode)) {
+            regular_total += static_cast<uint64_t>(sb.st_size);
+        } else {
+            min_width = WC_DEFAULT_WIDTH;
+        }
+        inputs.push_back(in);
+        names.push_back(named ? operand : "");
+    }
+
+    int width = 1;
+    for (; regular_total >= 10; regular_total /= 10) ++width;
+    width = std::max(width, min_width);
+    if (operands.size() == 1 && lines + words + bytes == 1) width = 1;
+
+    auto print = [&](const Counts& c, const std::string& name) {
+        std::string line;
+        auto field = [&](bool on, uint64_t value) {
+            if (!on) return;
+            std::string num = std::to_string(value);
+            if (!line.empty()) line += ' ';
+            if (num.size() < static_cast<size_t>(width)) {
+                line.append(static_cast<size_t>(width) - num.size(), ' ');
+            }
+            line += num;
+        };
+        field(lines, c.lines);
+        field(words, c.words);
+        field(bytes, c.bytes);
+        if (!name.empty()) line += " " + name;
+        line += '\n';
+        write_str(line);
+    };
+
+    Counts total;
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const Input& in = inputs[i];
+        Counts c;
+        if (!wc_fd(in.fd, lines || words, c)) {
+            report_error("wc", in);
+            status = 1;
+        } else {
+            print(c, names[i]);
+        }
+        total.lines += c.lines;
+        total.words += c.words;
+        total.bytes += c.bytes;
+        close_input(in);
+    }
+    if (operands.size() > 1) print(total, "total");
+    return status;
+}
+
+} // namespace builtins
+} // namespace shell
@@ -0,0 +1,214 @@
+#include "dircache.hpp"
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace shell {
+namespace dircache {
+
+namespace {
+
+// Scans are published in batches so a slow directory still yields
+// partial results to a waiting completion.
+constexpr size_t BATCH_SIZE = 256;
+
+// A listing checked against its directory this recently is served as is;
+// an older one is revalidated by a scanner. One completion lists every
+// $PATH directory, so this spares a thread per directory per keystroke.
+constexpr std::chrono::milliseconds RECHECK_INTERVAL{1000};
+
+using Clock = std::chrono::steady_clock;
+
+// Identity plus modification time: a different directory reached through
+// the same path (e.g. "." after cd) must not reuse the old listing.
+struct Stamp {
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+    int64_t sec = -1;
+    int64_t nsec = -1;
+
+    bool operator==(const Stamp& o) const {
+        return dev == o.dev && ino == o.ino && sec == o.sec && nsec == o.nsec;
+    }
+};
+
+Stamp stamp_of(const struct stat& sb) {
+    Stamp s;
+    s.dev = static_cast<uint64_t>(sb.st_dev);
+    s.ino = static_cast<uint64_t>(sb.st_ino);
+#ifdef __linux__
+    s.sec = sb.st_mtim.tv_sec;
+    s.nsec = sb.st_mtim.tv_nsec;
+#else
+    s.sec = sb.st_mtime;
+    s.nsec = 0;
+#endif
+    return s;
+}
+
+struct DirState {
+    std::mutex mu;
+    std::condition_variable cv;
+    std::vector<Entry> entries;
+    Stamp mtime;
+    uint64_t version = 0;       // bumped whenever entries change
+    bool have_listing = false;  // entries describe a finished scan at mtime
+    bool busy = false;          // a scanner thread owns this directory
+    uint64_t generation = 0;    // bumped whenever a scanner finishes
+    Clock::time_point checked;  // when a scanner last confirmed entries
+};
+
+// Versions are unique across directories, so a caller comparing them
+// notices when the same relative path now names another directory.
+std::atomic<uint64_t> last_version{0};
+
+uint64_t next_version() {
+    return last_version.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+// Listings are kept under absolute paths: "." after cd is another entry,
+// not one that has to be found stale first.
+std::string absolute(const std::string& dir) {
+    if (!dir.empty() && dir[0] == '/') return dir;
+    char cwd[PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) return dir;
+    if (dir.empty() || dir == ".") return cwd;
+    return std::string(cwd) + "/" + dir;
+}
+
+std::mutex table_mu;
+std::unordered_map<std::string, std::shared_ptr<DirState>> table;
+
+std::shared_ptr<DirState> state_for(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(table_mu);
+    auto& slot = table[dir];
+    if (!slot) {
+        slot = std::make_shared<DirState>();
+    }
+    return slot;
+}
+
+void finish(DirState& st) {
+    st.busy = false;
+    st.checked = Clock::now();
+    ++st.generation;
+    st.cv.notify_all();
+}
+
+// Runs on a detached thread. The stat() and readdir() calls are the ones
+// that can hang on a slow mount, so none of them happen under the lock.
+void scan(std::shared_ptr<DirState> st, std::string dir) {
+    struct stat sb;
+    if (stat(dir.c_str(), &sb) != 0) {
+        std::lock_guard<std::mutex> lock(st->mu);
+        st->entries.clear();
+        st->have_listing = true;
+        st->version = next_version();
+        finish(*st);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(st->mu);
+        if (st->have_listing && st->mtime == stamp_of(sb)) {
+            finish(*st);
+            return;
+        }
+        st->entries.clear();
+        st->have_listing = false;
+        st->version = next_version();
+    }
+
+    std::vector<Entry> batch;
+    DIR* dp = opendir(dir.c_str());
+    if (dp) {
+        dirent* ent;
+        while ((ent = readdir(dp))) {
+            std::string name = ent->d_name;
+            if (name == "." || name == "..") continue;
+
+            Entry e;
+            e.name = std::move(name);
+            if (ent->d_type == DT_DIR) {
+                e.is_dir = true;
+            } else if (ent->d_type == DT_LNK || ent->d_type == DT_UNKNOWN) {
+                struct stat esb;
+                e.is_dir = fstatat(dirfd(dp), ent->d_name, &esb, 0) == 0 &&
+                           S_ISDIR(esb.st_mode);
+            }
+            batch.push_back(std::move(e));
+
+            if (batch.size() >= BATCH_SIZE) {
+                std::lock_guard<std::mutex> lock(st->mu);
+                for (auto& b : batch) st->entries.push_back(std::move(b));
+                batch.clear();
+                st->version = next_version();
+                st->cv.notify_all();
+            }
+        }
+        closedir(dp);
+    }
+
+    std::lock_guard<std::mutex> lock(st->mu);
+    for (auto& b : batch) st->entries.push_back(std::move(b));
+    st->version = next_version();
+    st->mtime = stamp_of(sb);
+    st->have_listing = true;
+    finish(*st);
+}
+
+// Starts a scanner for a missing or stale listing, unless one is already
+// running. Caller holds st->mu. Returns whether a scanner is running.
+bool start_scan(const std::shared_ptr<DirState>& st, const std::string& dir) {
+    if (st->busy) return true;
+    if (st->have_listing && Clock::now() - st->checked < RECHECK_INTERVAL) {
+        return false;
+    }
+    try {
+        std::thread(scan, st, dir).detach();
+        st->busy = true;
+    } catch (const std::system_error&) {
+        // Out of threads: keep serving whatever is cached.
+    }
+    return st->busy;
+}
+
+} // namespace
+
+Listing list(const std::string& path, std::chrono::milliseconds budget) {
+    std::string dir = absolute(path);
+    auto st = state_for(dir);
+    std::unique_lock<std::mutex> lock(st->mu);
+
+    uint64_t gen = st->generation;
+    bool fresh = !start_scan(st, dir) || st->cv.wait_for(lock, budget, [&] {
+        return st->generation != gen;
+    });
+
+    Listing result;
+    result.entries = st->entries;
+    result.complete = fresh && st->have_listing;
+    result.version = st->version;
+    return result;
+}
+
+void prefetch(const std::string& path) {
+    std::string dir = absolute(path);
+    auto st = state_for(dir);
+    std::lock_guard<std::mutex> lock(st->mu);
+    start_scan(st, dir);
+}
+
+} // namespace dircache
+} // namespace shell
@@ -1,25 +1,298 @@
 #include "executor.hpp"
+#include "audit.hpp"
+#include "batch.hpp"
 #include "builtins.hpp"
 #include "redirection.hpp"
+#include "stats.hpp"
 #include "utils.hpp"
 #include "history.hpp"
+#include "fdtable.hpp"
+#include "variables.hpp"
 #include <iostream>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <vector>
 
 namespace shell {
 namespace executor {
 
+namespace {
+
+// Returns the substitution fds consumed by one stage. Every other
+// shell-internal fd is closed in that stage's child: leaving a >(cmd) write
+// end open in an unrelated process would keep the reader from seeing EOF.
+std::vector<int> substitution_fds(const std::vector<ProcessSubstitution>& subs,
+                                  size_t stage) {
+    std::vector<int> fds;
+    for (const auto& sub : subs) {
+        if (sub.stage == stage) {
+            fds.push_back(sub.fd);
+        }
+    }
+    return fds;
+}
+
+// Releases the shell's ends of the substitution pipes and reaps the
+// substituted commands once their consumers are done.
+void finish_process_substitutions(const std::vector<ProcessSubstitution>& subs) {
+    for (const auto& sub : subs) {
+        fdtable::release(sub.fd);
+    }
+    for (const auto& sub : subs) {
+        waitpid(sub.pid, nullptr, 0);
+    }
+}
+
+// Exit status of the most recent command line, as reported by $? in
+// other shells.
+int last_exit_status = 0;
+
+void (*exit_handler)(int status) = nullptr;
+
+// Scripts and -c end when `exec` cannot run its command or a line
+// fails to expand.
+bool interactive = true;
+
+// Server workers answer for every command, so `exec cmd` forks and
+// waits there instead of replacing them.
+bool keep_process = false;
+
+// Set in children that go on running shell commands (process
+// substitutions, coprocesses), where `exit` ends only the child.
+bool subshell = false;
+
+int exit_code(int status) {
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+    return 1;
+}
+
+// fork(), counted and timed for shellstats.
+pid_t spawn() {
+    stats::add(stats::Counter::FORKS);
+    stats::Timer timer(stats::Latency::SPAWN);
+    pid_t pid = fork();
+    if (pid == 0) {
+        subshell = true;
+        exit_handler = nullptr;
+    }
+    return pid;
+}
+
+// Reports a failed execv in a child.
+void report_exec_error(const std::string& cmd) {
+    if (errno == E2BIG) {
+        std::cerr << cmd << ": argument list too long "
+                  << "(add +batch before the arguments to split them)\n";
+    } else {
+        perror("execv");
+    }
+}
+
+// A coprocess started by `coproc`. Finished ones stay listed, with their
+// status and read end, until their name is reused.
+struct Coprocess {
+    std::string name;
+    pid_t pid;
+    int read_fd;   // the command's output
+    int write_fd;  // the command's input; -1 once closed
+    int status;    // exit code, once finished
+    bool running;
+};
+
+std::vector<Coprocess> coprocesses;
+
+void close_input(Coprocess& co) {
+    fdtable::release(co.write_fd);
+    co.write_fd = -1;
+}
+
+// Records a coprocess's exit code; like bash, NAME_PID goes away with it.
+void finish(Coprocess& co, int code) {
+    co.running = false;
+    co.status = code;
+    close_input(co);
+    variables::set_array(co.name, {std::to_string(co.read_fd)});
+    variables::unset(co.name + "_PID");
+}
+
+} // namespace
+
+std::vector<ProcessSubstitution> start_process_substitutions(
+        std::vector<parser::Tokens>& pipeline) {
+    std::vector<ProcessSubstitution> subs;
+
+    for (size_t stage = 0; stage < pipeline.size(); ++stage) {
+        auto& command = pipeline[stage];
+        for (size_t k = 0; k < command.words.size(); ++k) {
+            // Only text the tokenizer saw typed as <(...) runs; the same
+            // characters from quotes or a variable are data.
+            if (!(command.flags[k] & parser::SUBSTITUTION)) continue;
+            std::string& arg = command.words[k];
+            command.flags[k] = parser::PLAIN;
+
+            // <(cmd): the shell keeps the read end and cmd writes into the
+            // pipe. >(cmd): the shell keeps the write end and cmd reads it.
+            bool reads = arg[0] == '<';
+            int p[2];
+            if (!fdtable::make_pipe(p, "process substitution")) {
+                continue;
+            }
+            int keep = reads ? p[0] : p[1];
+            int child_end = reads ? p[1] : p[0];
+
+            pid_t pid = spawn();
+            if (pid == 0) {
+                dup2(child_end, reads ? STDOUT_FILENO : STDIN_FILENO);
+                fdtable::prepare_child();
+
+                execute(arg.substr(2, arg.size() - 3));
+                _exit(last_exit_status);
+            }
+
+            fdtable::release(child_end);
+            if (pid < 0) {
+                perror("fork");
+                fdtable::release(keep);
+                continue;
+            }
+
+            subs.push_back({pid, keep, stage});
+            arg = "/dev/fd/" + std::to_string(keep);
+        }
+    }
+
+    return subs;
+}
+
+int start_coprocess(parser::Tokens tokens) {
+    reap_coprocesses();
+    auto& words = tokens.words;
+    auto drop_first = [&tokens]() {
+        tokens.words.erase(tokens.words.begin());
+        tokens.flags.erase(tokens.flags.begin());
+    };
+    drop_first();  // "coproc"
+
+    std::string name = "COPROC";
+    if (words.size() > 1 && !(tokens.flags[1] & parser::OPERATOR) &&
+        variables::is_valid_name(words[0]) &&
+        !builtins::is_builtin(words[0]) && resolve_exec(words[0]).empty()) {
+        name = words[0];
+        drop_first();
+    }
+    if (words.empty() || (tokens.flags[0] & parser::OPERATOR)) {
+        std::cerr << "coproc: usage: coproc [NAME] command [argument ...]\n";
+        return 2;
+    }
+
+    for (auto it = coprocesses.begin(); it != coprocesses.end(); ++it) {
+        if (it->name != name) continue;
+        if (it->running) {
+            std::cerr << "coproc: " << name << ": already running\n";
+            return 1;
+        }
+        fdtable::release(it->read_fd);
+        coprocesses.erase(it);
+        break;
+    }
+
+    // The command reads from `in` and writes to `out`; the shell keeps
+    // the other ends.
+    std::string label = "coproc " + name;
+    int in[2], out[2];
+    if (!fdtable::make_pipe(in, label)) {
+        return 1;
+    }
+    if (!fdtable::make_pipe(out, label)) {
+        fdtable::release(in[0]);
+        fdtable::release(in[1]);
+        return 1;
+    }
+
+    pid_t pid = spawn();
+    if (pid == 0) {
+        // Its own process group keeps Ctrl-C at the prompt away from it.
+        setpgid(0, 0);
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        fdtable::prepare_child();
+
+        // As the last thing this child runs, a plain external command
+        // is exec'd in its place rather than forked once more.
+        execute_tokens(tokens, true);
+        _exit(last_exit_status);
+    }
+
+    fdtable::release(in[0]);
+    fdtable::release(out[1]);
+    if (pid < 0) {
+        perror("fork");
+        fdtable::release(in[1]);
+        fdtable::release(out[0]);
+        return 1;
+    }
+    setpgid(pid, pid);
+
+    coprocesses.push_back({name, pid, out[0], in[1], 0, true});
+    variables::set_array(name, {std::to_string(out[0]), std::to_string(in[1])});
+    variables::set(name + "_PID", std::to_string(pid));
+    return 0;
+}
+
+size_t reap_coprocesses() {
+    size_t running = 0;
+    for (auto& co : coprocesses) {
+        if (!co.running) continue;
+        int status;
+        pid_t r = waitpid(co.pid, &status, WNOHANG);
+        if (r == 0) {
+            ++running;
+        } else {
+            finish(co, r == co.pid ? exit_code(status) : 127);
+        }
+    }
+    return running;
+}
+
+int wait_coprocess(pid_t pid) {
+    int code = pid < 0 ? 0 : -1;
+    for (auto& co : coprocesses) {
+        if (pid >= 0 && co.pid != pid) continue;
+        if (co.running) {
+            close_input(co);
+            int status;
+            pid_t r;
+            while ((r = waitpid(co.pid, &status, 0)) < 0 && errno == EINTR) {
+            }
+            finish(co, r == co.pid ? exit_code(status) : 127);
+        }
+        if (pid >= 0) code = co.status;
+    }
+    return code;
+}
+
 int execute_command(const std::vector<std::string>& args,
                     const parser::Redirections& redir) {
     if (args.empty()) return 1;
 
+    redirection::RedirectGuard stdin_guard(
+        STDIN_FILENO, redir.stdin_file, false, true);
+    if (!stdin_guard.is_valid()) return 1;
+    redirection::RedirectGuard stdin_dup(STDIN_FILENO, redir.stdin_fd);
+    if (!stdin_dup.is_valid()) return 1;
     redirection::RedirectGuard stdout_guard(
         STDOUT_FILENO, redir.stdout_file, redir.stdout_append);
     redirection::RedirectGuard stderr_guard(
         STDERR_FILENO, redir.stderr_file, redir.stderr_append);
+    redirection::RedirectGuard stdout_dup(STDOUT_FILENO, redir.stdout_fd);
+    if (!stdout_dup.is_valid()) return 1;
+    redirection::RedirectGuard stderr_dup(STDERR_FILENO, redir.stderr_fd);
+    if (!stderr_dup.is_valid()) return 1;
 
     if (builtins::is_builtin(args[0])) {
         return builtins::execute_builtin(args);
@@ -31,9 +304,12 @@ int execute_command(const std::vector<std::string>& args,
         return 127;
     }
 
-    pid_t pid = fork();
+    pid_t pid = spawn();
     if (pid == 0) {
         // Child process
+        if (batch::requested(args)) {
+            _exit(batch::run(args, exec_path));
+        }
         std::vector<char*> argv;
         for (const auto& s : args) {
             argv.push_back(const_cast<char*>(s.c_str()));
@@ -41,27 +317,60 @@ int execute_command(const std::vector<std::string>& args,
         argv.push_back(nullptr);
 
         execv(exec_path.c_str(), argv.data());
-        perror("execv");
+        report_exec_error(args[0]);
         _exit(1);
     }
 
+    if (pid > 0) stats::add(stats::Counter::EXECS);
     int status;
-    waitpid(pid, &status, 0);
+    {
+        stats::Timer timer(stats::Latency::WAIT);
+        status = supervisor::supervise({pid}, 0).statuses[0];
+    }
     return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
 }
 
 int execute_pipeline(std::vector<std::vector<std::string>>& pipeline,
-                     const parser::Redirections& redir) {
+                     const parser::Redirections& redir,
+                     const std::vector<ProcessSubstitution>& subs,
+                     const supervisor::Limits& limits,
+                     audit::Record* record,
+                     const std::vector<std::vector<std::string>>& prefixes) {
     const size_t n = pipeline.size();
+    auto prefix = [&prefixes](size_t i) {
+        return i < prefixes.size() ? prefixes[i] : std::vector<std::string>{};
+    };
+
+    // A time limit needs every stage in a child process, all in one
+    // process group that the limit can signal.
+    const bool grouped = limits.duration.count() > 0;
+    const bool foreground = grouped && supervisor::owns_terminal();
     
-    if (n == 1 && builtins::is_builtin(pipeline[0][0])) {
+    if (n == 1 && !grouped && builtins::is_builtin(pipeline[0][0])) {
         // Single builtin command
-        redirection::RedirectGuard stdout_guard(
-            STDOUT_FILENO, redir.stdout_file, redir.stdout_append);
-        redirection::RedirectGuard stderr_guard(
-            STDERR_FILENO, redir.stderr_file, redir.stderr_append);
-        
-        return builtins::execute_builtin(pipeline[0]);
+        int code = 1;
+        {
+            redirection::RedirectGuard stdin_guard(
+                STDIN_FILENO, redir.stdin_file, false, true);
+            redirection::RedirectGuard stdin_dup(STDIN_FILENO, redir.stdin_fd);
+            redirection::RedirectGuard stdout_guard(
+                STDOUT_FILENO, redir.stdout_file, redir.stdout_append);
+            redirection::RedirectGuard stderr_guard(
+                STDERR_FILENO, redir.stderr_file, redir.stderr_append);
+            redirection::RedirectGuard stdout_dup(STDOUT_FILENO, redir.stdout_fd);
+            redirection::RedirectGuard stderr_dup(STDERR_FILENO, redir.stderr_fd);
+
+            if (stdin_guard.is_valid() && stdin_dup.is_valid() &&
+                stdout_dup.is_valid() && stderr_dup.is_valid()) {
+                variables::PrefixGuard prefix_guard(prefix(0));
+                code = builtins::execute_builtin(pipeline[0]);
+            }
+        }
+        finish_process_substitutions(subs);
+        if (record) {
+            record->stages.push_back({pipeline[0], "", code, {}});
+        }
+        return code;
     }
 
     // Create pipes
@@ -69,19 +378,44 @@ int execute_pipeline(std::vector<std::vector<std::string>>& pipeline,
     const size_t num_pipes = n - 1;
     std::vector<int> fds(2 * num_pipes);
     for (size_t i = 0; i < num_pipes; ++i) {
-        pipe(&fds[i * 2]);
+        fdtable::make_pipe(&fds[i * 2], "pipeline");
+    }
+
+    // A builtin that can run in the shell itself ends the pipeline there,
+    // saving a fork (and making `... | read x` set x).
+    const builtins::Builtin* last = builtins::find_builtin(pipeline[n - 1][0]);
+    const bool lastpipe = !grouped && last && (last->flags & builtins::NOFORK_LAST);
+    const size_t forked = lastpipe ? n - 1 : n;
+
+    // Executables are looked up before forking, so the audit log can
+    // record where each one was found.
+    std::vector<std::string> paths(n);
+    for (size_t i = 0; i < forked; ++i) {
+        if (!builtins::is_builtin(pipeline[i][0])) {
+            paths[i] = resolve_exec(pipeline[i][0]);
+        }
     }
 
     // Fork processes
-    for (size_t i = 0; i < n; ++i) {
-        pid_t pid = fork();
+    std::vector<pid_t> pids;
+    for (size_t i = 0; i < forked; ++i) {
+        pid_t pid = spawn();
         
         if (pid == 0) {
             // Child process
+            if (grouped) {
+                supervisor::join_group(pids.empty() ? 0 : pids[0], foreground);
+            }
             
-            // Set up input from previous pipe
+            // Set up input from previous pipe, or the first command's < file
             if (i > 0) {
                 dup2(fds[(i - 1) * 2], STDIN_FILENO);
+            } else if ((!redir.stdin_file.empty() &&
+                        redirection::redirect_fd(STDIN_FILENO, redir.stdin_file,
+                                                 false, true) < 0) ||
+                       (redir.stdin_fd >= 0 &&
+                        redirection::redirect_dup(STDIN_FILENO, redir.stdin_fd) < 0)) {
+                _exit(1);
             }
             
             // Set up output to next pipe
@@ -95,79 +429,323 @@ int execute_pipeline(std::vector<std::vector<std::string>>& pipeline,
                     STDOUT_FILENO, redir.stdout_file, redir.stdout_append);
                 redirection::redirect_fd(
                     STDERR_FILENO, redir.stderr_file, redir.stderr_append);
+                if ((redir.stdout_fd >= 0 &&
+                     redirection::redirect_dup(STDOUT_FILENO, redir.stdout_fd) < 0) ||
+                    (redir.stderr_fd >= 0 &&
+                     redirection::redirect_dup(STDERR_FILENO, redir.stderr_fd) < 0)) {
+                    _exit(1);
+                }
             }
             
-            // Close all pipe fds
-            for (int fd : fds) {
-                close(fd);
-            }
+            // Close all pipe fds and anything else the shell owns
+            fdtable::prepare_child(substitution_fds(subs, i));
 
             auto& cmd = pipeline[i];
+            variables::PrefixGuard prefix_guard(prefix(i));
             
             if (builtins::is_builtin(cmd[0])) {
-                builtins::execute_builtin(cmd);
-                _exit(0);
+                _exit(builtins::execute_builtin(cmd));
             }
 
-            std::string exec_path = resolve_exec(cmd[0]);
-            if (exec_path.empty()) {
+            if (paths[i].empty()) {
                 std::cerr << cmd[0] << ": not found\n";
                 _exit(127);
             }
 
+            // The stage itself becomes the batches' parent, so pipes and
+            // redirections apply to all of them.
+            if (batch::requested(cmd)) {
+                _exit(batch::run(cmd, paths[i]));
+            }
+
             std::vector<char*> argv;
             for (auto& s : cmd) {
                 argv.push_back(const_cast<char*>(s.c_str()));
             }
             argv.push_back(nullptr);
 
-            execv(exec_path.c_str(), argv.data());
-            perror("execv");
+            execv(paths[i].c_str(), argv.data());
+            report_exec_error(cmd[0]);
             _exit(1);
         }
+        if (grouped && pid > 0) {
+            setpgid(pid, pids.empty() ? pid : pids[0]);
+        }
+        if (pid > 0 && !paths[i].empty()) {
+            stats::add(stats::Counter::EXECS);
+        }
+        pids.push_back(pid);
+    }
+
+    int saved_stdin = -1;
+    if (lastpipe) {
+        saved_stdin = fdtable::duplicate(STDIN_FILENO, "saved fd 0");
+        dup2(fds[(n - 2) * 2], STDIN_FILENO);
     }
 
     // Parent: close all pipes and wait
     for (int fd : fds) {
-        close(fd);
+        fdtable::release(fd);
+    }
+
+    int code = 0;
+    if (lastpipe) {
+        {
+            redirection::RedirectGuard stdout_guard(
+                STDOUT_FILENO, redir.stdout_file, redir.stdout_append);
+            redirection::RedirectGuard stderr_guard(
+                STDERR_FILENO, redir.stderr_file, redir.stderr_append);
+            redirection::RedirectGuard stdout_dup(STDOUT_FILENO, redir.stdout_fd);
+            redirection::RedirectGuard stderr_dup(STDERR_FILENO, redir.stderr_fd);
+            variables::PrefixGuard prefix_guard(prefix(n - 1));
+            code = stdout_dup.is_valid() && stderr_dup.is_valid()
+                       ? builtins::execute_builtin(pipeline[n - 1])
+                       : 1;
+        }
+        // Drops the shell's reference to the pipe, so writers still
+        // running get SIGPIPE instead of blocking.
+        redirection::restore_fd(STDIN_FILENO, saved_stdin);
     }
     
-    for (size_t i = 0; i < n; ++i) {
-        wait(nullptr);
+    // Wait for the pipeline's own children by pid so that process
+    // substitutions still running are not reaped in their place.
+    pid_t pgid = grouped && !pids.empty() && pids[0] > 0 ? pids[0] : 0;
+    supervisor::Outcome outcome;
+    {
+        stats::Timer timer(stats::Latency::WAIT);
+        outcome = supervisor::supervise(pids, pgid, limits);
     }
+    if (foreground) {
+        supervisor::reclaim_terminal();
+    }
+    finish_process_substitutions(subs);
 
-    return 0;
+    if (record) {
+        for (size_t i = 0; i < n; ++i) {
+            audit::Stage stage{pipeline[i], paths[i], code, {}};
+            if (i < pids.size()) {
+                stage.status = exit_code(outcome.statuses[i]);
+                stage.usage = outcome.usage[i];
+            }
+            record->stages.push_back(std::move(stage));
+        }
+        record->timed_out = outcome.timed_out;
+    }
+
+    if (lastpipe) return code;
+    if (outcome.killed) return 128 + SIGKILL;
+    if (outcome.timed_out) return 124;
+    return exit_code(outcome.statuses.back());
 }
 
-bool execute(const std::string& input) {
-    auto tokens = parser::tokenize(input);
-    if (tokens.empty()) return true;
+int exec_command(const std::vector<std::string>& args,
+                 const std::string& argv0, bool clear_env) {
+    std::string path = resolve_exec(args[0]);
+    // A path to a file that cannot be executed is left for execv() to
+    // reject, so that it reports 126 rather than "not found".
+    if (path.empty() && args[0].find('/') != std::string::npos &&
+        access(args[0].c_str(), F_OK) == 0) {
+        path = args[0];
+    }
+    if (path.empty()) {
+        std::cerr << "exec: " << args[0] << ": not found\n";
+        return 127;
+    }
 
-    auto pipeline = parser::split_pipeline(tokens);
-    if (pipeline.empty()) return true;
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(argv0.empty() ? args[0].c_str() : argv0.c_str()));
+    for (size_t i = 1; i < args.size(); ++i) {
+        argv.push_back(const_cast<char*>(args[i].c_str()));
+    }
+    argv.push_back(nullptr);
 
-    // Handle exit specially
-    if (pipeline.size() == 1 && pipeline[0][0] == "exit") {
-        auto& args = pipeline[0];
-        int code = 0;
-        if (args.size() > 1) {
-            try {
-                code = std::stoi(args[1]);
-            } catch (...) {
-                std::cerr << "exit: numeric argument required\n";
-                code = 1;
-            }
+    // The process has to outlive the command: run it in a child instead.
+    pid_t pid = keep_process ? spawn() : 0;
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid > 0) {
+        stats::add(stats::Counter::EXECS);
+        stats::Timer timer(stats::Latency::WAIT);
+        return exit_code(supervisor::supervise({pid}, 0).statuses[0]);
+    }
+
+    if (keep_process) {
+        fdtable::prepare_child();
+    } else {
+        audit::shutdown();
+    }
+    fflush(nullptr);
+
+    if (clear_env) {
+        char* no_env[] = {nullptr};
+        execve(path.c_str(), argv.data(), no_env);
+    } else {
+        execv(path.c_str(), argv.data());
+    }
+    int err = errno;
+    std::cerr << "exec: " << args[0] << ": " << strerror(err) << "\n";
+    if (keep_process) _exit(err == ENOENT ? 127 : 126);
+    return err == ENOENT ? 127 : 126;
+}
+
+bool execute(const std::string& input, bool tail) {
+    auto commands = parser::split_commands(input);
+    for (size_t i = 0; i < commands.size(); ++i) {
+        // Tokenized one at a time: expansions see the effects of the
+        // commands before them.
+        auto tokens = parser::tokenize(commands[i]);
+        if (!tokens.empty() || tokens.error) {
+            execute_tokens(tokens, tail && i + 1 == commands.size());
         }
+    }
+    return true;
+}
+
+bool execute_tokens(const parser::Tokens& tokens, bool tail) {
+    // A failed expansion, like $((1/0)), fails the command; scripts and
+    // -c stop there.
+    if (tokens.error) {
+        last_exit_status = 1;
+        if (!interactive) exit(last_exit_status);
+        return true;
+    }
+
+    auto stages = parser::split_pipeline(tokens);
+    if (stages.empty()) return true;
+    const auto& first = stages[0].words;
+
+    stats::dump_if_due();
+    stats::add(stats::Counter::COMMANDS);
+    reap_coprocesses();
+
+    // Handle exit specially
+    if (stages.size() == 1 && first[0] == "exit") {
+        int code = builtins::builtin_exit(first);
+        if (subshell) exit(code);
         history::save_history();
+        if (exit_handler) exit_handler(code);
         exit(code);
     }
 
-    // Extract redirections from last command
-    auto redir = parser::extract_redirections(pipeline.back());
+    // NAME=value ... on its own sets shell variables
+    size_t assignments = variables::prefix_length(first);
+    if (stages.size() == 1 && variables::is_assignment(first[0]) &&
+        (assignments == 0 || assignments == first.size())) {
+        last_exit_status = variables::assign(first);
+        return true;
+    }
+
+    // In front of a command, NAME=value words only go to its environment
+    std::vector<std::vector<std::string>> prefixes(stages.size());
+    for (size_t i = 0; i < stages.size(); ++i) {
+        auto& words = stages[i].words;
+        size_t count = variables::prefix_length(words);
+        if (count == 0 || count == words.size()) continue;
+        prefixes[i].assign(words.begin(), words.begin() + static_cast<std::ptrdiff_t>(count));
+        words.erase(words.begin(), words.begin() + static_cast<std::ptrdiff_t>(count));
+        stages[i].flags.erase(stages[i].flags.begin(),
+                              stages[i].flags.begin() + static_cast<std::ptrdiff_t>(count));
+    }
+
+    // The whole line, redirections included, belongs to a coprocess
+    if (first[0] == "coproc") {
+        last_exit_status = start_coprocess(tokens);
+        return true;
+    }
 
-    execute_pipeline(pipeline, redir);
+    // `timeout ...` in front of a pipeline limits all of its stages
+    supervisor::Limits limits;
+    if (first[0] == "timeout") {
+        int start = supervisor::parse_timeout(first, limits);
+        if (start < 0) {
+            last_exit_status = 125;
+            return true;
+        }
+        stages[0].words.erase(stages[0].words.begin(), stages[0].words.begin() + start);
+        stages[0].flags.erase(stages[0].flags.begin(), stages[0].flags.begin() + start);
+    }
+
+    // Substitutions are started first so that `> >(cmd)` redirects into
+    // the substituted command's /dev/fd path.
+    auto subs = start_process_substitutions(stages);
+
+    // Extract redirections from last command; input comes from the first
+    auto redir = parser::extract_redirections(stages.back());
+    if (stages.size() > 1) {
+        parser::extract_input_redirection(stages.front(), redir);
+    }
+
+    std::vector<std::vector<std::string>> pipeline;
+    for (auto& stage : stages) {
+        pipeline.push_back(std::move(stage.words));
+    }
+
+    // `exec`, and the last command of a script when it is a plain external
+    // command, replace the shell; their redirections are made for good.
+    // With the audit log on, the tail command still forks so that its
+    // status gets recorded.
+    const auto& command = pipeline[0];
+    bool replace = pipeline.size() == 1 && !command.empty() && limits.duration.count() == 0 &&
+                   (command[0] == "exec" ||
+                    (tail && subs.empty() && !audit::enabled() && !batch::requested(command) &&
+                     !builtins::is_builtin(command[0]) && !resolve_exec(command[0]).empty()));
+    if (replace) {
+        if (!redirection::replace_fd(STDIN_FILENO, redir.stdin_file, false, true) ||
+            !redirection::replace_fd(STDOUT_FILENO, redir.stdout_file, redir.stdout_append) ||
+            !redirection::replace_fd(STDERR_FILENO, redir.stderr_file, redir.stderr_append) ||
+            !redirection::replace_dup(STDIN_FILENO, redir.stdin_fd) ||
+            !redirection::replace_dup(STDOUT_FILENO, redir.stdout_fd) ||
+            !redirection::replace_dup(STDERR_FILENO, redir.stderr_fd)) {
+            last_exit_status = 1;
+            return true;
+        }
+        // Substitutions live on as the redirected fds; the shell no longer
+        // waits for them.
+        for (const auto& sub : subs) {
+            fdtable::release(sub.fd);
+        }
+        variables::PrefixGuard prefix_guard(prefixes[0]);
+        if (command[0] != "exec") {
+            last_exit_status = exec_command(command);
+            return true;
+        }
+        last_exit_status = builtins::execute_builtin(command);
+        if (!interactive && last_exit_status >= 126) {
+            exit(last_exit_status);
+        }
+        return true;
+    }
+
+    if (!audit::enabled()) {
+        last_exit_status = execute_pipeline(pipeline, redir, subs, limits, nullptr, prefixes);
+        return true;
+    }
+
+    audit::Record record;
+    audit::begin(record);
+    last_exit_status = execute_pipeline(pipeline, redir, subs, limits, &record, prefixes);
+    record.status = last_exit_status;
+    audit::submit(std::move(record));
     return true;
 }
 
+void set_exit_handler(void (*handler)(int status)) {
+    exit_handler = handler;
+}
+
+void set_interactive(bool value) {
+    interactive = value;
+}
+
+void set_keep_process(bool value) {
+    keep_process = value;
+}
+
+int last_status() {
+    return last_exit_status;
+}
+
 } // namespace executor
 } // namespace shell
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include "fdtable.hpp"
+#include <map>
+#include <algorithm>
+#include <iomanip>
+#include <climits>
+#include <cstdlib>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+
+namespace shell {
+namespace fdtable {
+
+namespace {
+    // Every descriptor the shell owns, keyed by number. Only the main
+    // thread touches the table; helper threads use the fds they are given.
+    std::map<int, std::string> owned;
+
+    // Closes [first, last] with a single syscall where the kernel supports
+    // close_range(), otherwise falls back to the registered descriptors.
+    void close_span(unsigned first, unsigned last) {
+        if (first > last) return;
+#if defined(__linux__) && defined(SYS_close_range)
+        if (syscall(SYS_close_range, first, last, 0) == 0) return;
+#endif
+        for (const auto& entry : owned) {
+            auto fd = static_cast<unsigned>(entry.first);
+            if (fd >= first && fd <= last) {
+                close(entry.first);
+            }
+        }
+    }
+}
+
+int adopt(int fd, const std::string& label) {
+    if (fd < 0) return -1;
+
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, FD_BASE);
+    close(fd);
+    if (high < 0) {
+        perror("fcntl");
+        return -1;
+    }
+    owned[high] = label;
+    return high;
+}
+
+int duplicate(int fd, const std::string& label) {
+    int high = fcntl(fd, F_DUPFD_CLOEXEC, FD_BASE);
+    if (high < 0) return -1;
+    owned[high] = label;
+    return high;
+}
+
+int open_file(const std::string& path, int flags, mode_t mode,
+              const std::string& label) {
+    int fd = open(path.c_str(), flags | O_CLOEXEC, mode);
+    if (fd < 0) return -1;
+    return adopt(fd, label);
+}
+
+bool make_pipe(int fds[2], const std::string& label) {
+    int raw[2];
+    if (pipe(raw) != 0) {
+        perror("pipe");
+        return false;
+    }
+
+    fds[0] = adopt(raw[0], label + " (read)");
+    fds[1] = adopt(raw[1], label + " (write)");
+    if (fds[0] < 0 || fds[1] < 0) {
+        release(fds[0]);
+        release(fds[1]);
+        return false;
+    }
+    return true;
+}
+
+void release(int fd) {
+    if (fd < 0) return;
+    close(fd);
+    owned.erase(fd);
+}
+
+void prepare_child(const std::vector<int>& keep) {
+    std::vector<int> sorted(keep);
+    std::sort(sorted.begin(), sorted.end());
+
+    // Close the gaps between the kept descriptors.
+    auto next = static_cast<unsigned>(FD_BASE);
+    for (int fd : sorted) {
+        if (fd < FD_BASE) continue;
+        close_span(next, static_cast<unsigned>(fd) - 1);
+        next = static_cast<unsigned>(fd) + 1;
+
+        int flags = fcntl(fd, F_GETFD);
+        if (flags >= 0) {
+            fcntl(fd, F_SETFD, flags & ~FD_CLOEXEC);
+        }
+    }
+    close_span(next, UINT_MAX);
+
+    // The child's view of the table must match what is still open, in
+    // case it goes on to run shell code (builtins, substitutions).
+    for (auto it = owned.begin(); it != owned.end();) {
+        if (std::binary_search(sorted.begin(), sorted.end(), it->first)) {
+            ++it;
+        } else {
+            it = owned.erase(it);
+        }
+    }
+}
+
+void dump(std::ostream& out) {
+    std::vector<int> fds;
+
+    DIR* dp = opendir("/proc/self/fd");
+    if (dp) {
+        int self = dirfd(dp);
+        dirent* ent;
+        while ((ent = readdir(dp))) {
+            if (ent->d_name[0] == '.') continue;
+            int fd = std::atoi(ent->d_name);
+            if (fd != self) fds.push_back(fd);
+        }
+        closedir(dp);
+    } else {
+        // No procfs: probe a reasonable range instead.
+        int limit = owned.empty() ? FD_BASE : owned.rbegin()->first + 1;
+        for (int fd = 0; fd < std::max(limit, 256); ++fd) {
+            if (fcntl(fd, F_GETFD) >= 0) fds.push_back(fd);
+        }
+    }
+    std::sort(fds.begin(), fds.end());
+
+    for (int fd : fds) {
+        int flags = fcntl(fd, F_GETFD);
+        if (flags < 0) continue;
+
+        std::string target;
+        char buf[PATH_MAX];
+        std::string link = "/proc/self/fd/" + std::to_string(fd);
+        ssize_t len = readlink(link.c_str(), buf, sizeof(buf) - 1);
+        if (len > 0) {
+            target.assign(buf, static_cast<size_t>(len));
+        }
+
+        auto it = owned.find(fd);
+        out << std::setw(4) << fd << "  "
+            << ((flags & FD_CLOEXEC) ? "cloexec" : "       ") << "  "
+            << std::left << std::setw(24)
+            << (it != owned.end() ? it->second : "-") << std::right
+            << "  " << target << '\n';
+    }
+}
+
+} // namespace fdtable
+} // namespace shell
@@ -0,0 +1,252 @@
+#include "fuzzy.hpp"
+#include <algorithm>
+#include <utility>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace shell {
+namespace fuzzy {
+
+namespace {
+
+// Scoring constants follow fzf's v1 algorithm.
+constexpr int SCORE_MATCH = 16;
+constexpr int GAP_START = -3;
+constexpr int GAP_EXTENSION = -1;
+constexpr int BONUS_BOUNDARY_WHITE = 10;
+constexpr int BONUS_BOUNDARY_DELIMITER = 9;
+constexpr int BONUS_BOUNDARY = 8;
+constexpr int BONUS_CAMEL = 7;
+constexpr int BONUS_CONSECUTIVE = 4;
+constexpr int FIRST_CHAR_MULTIPLIER = 2;
+
+enum class CharClass { White, Delimiter, NonWord, Lower, Upper, Number };
+
+inline char to_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+CharClass classify(char c) {
+    if (c >= 'a' && c <= 'z') return CharClass::Lower;
+    if (c >= 'A' && c <= 'Z') return CharClass::Upper;
+    if (c >= '0' && c <= '9') return CharClass::Number;
+    if (c == ' ' || c == '\t') return CharClass::White;
+    if (c == '/' || c == '-' || c == '_' || c == '.' || c == ':' ||
+        c == ',' || c == ';' || c == '|') {
+        return CharClass::Delimiter;
+    }
+    return CharClass::NonWord;
+}
+
+int bonus_for(CharClass prev, CharClass cur) {
+    bool word = cur == CharClass::Lower || cur == CharClass::Upper ||
+                cur == CharClass::Number;
+    if (!word) return 0;
+
+    switch (prev) {
+    case CharClass::White:     return BONUS_BOUNDARY_WHITE;
+    case CharClass::Delimiter: return BONUS_BOUNDARY_DELIMITER;
+    case CharClass::NonWord:   return BONUS_BOUNDARY;
+    default: break;
+    }
+    if ((prev == CharClass::Lower && cur == CharClass::Upper) ||
+        (prev != CharClass::Number && cur == CharClass::Number)) {
+        return BONUS_CAMEL;
+    }
+    return 0;
+}
+
+inline unsigned bit_of(char c) {
+    auto u = static_cast<unsigned char>(to_lower(c));
+    if (u >= 'a' && u <= 'z') return u - 'a';
+    if (u >= '0' && u <= '9') return 26 + (u - '0');
+    return 36 + u % 28;
+}
+
+size_t prefilter_scalar(const uint64_t* masks, size_t begin, size_t n,
+                        uint64_t q, uint32_t* out) {
+    size_t count = 0;
+    for (size_t i = begin; i < n; ++i) {
+        if ((masks[i] & q) == q) {
+            out[count++] = static_cast<uint32_t>(i);
+        }
+    }
+    return count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Four masks per step: AND with the pattern mask, compare to it, and turn
+// the per-lane result into a 4-bit survivor mask.
+__attribute__((target("avx2")))
+size_t prefilter_avx2(const uint64_t* masks, size_t n, uint64_t q,
+                      uint32_t* out) {
+    const __m256i qv = _mm256_set1_epi64x(static_cast<long long>(q));
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + i));
+        __m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(v, qv), qv);
+        auto bits = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(eq)));
+        while (bits) {
+            auto lane = static_cast<unsigned>(__builtin_ctz(bits));
+            out[count++] = static_cast<uint32_t>(i + lane);
+            bits &= bits - 1;
+        }
+    }
+    return count + prefilter_scalar(masks, i, n, q, out + count);
+}
+
+#endif
+
+#ifdef __SSE2__
+
+// SSE2 has no 64-bit compare, so compare 32-bit halves and require all
+// eight bytes of a lane to match.
+size_t prefilter_sse2(const uint64_t* masks, size_t n, uint64_t q,
+                      uint32_t* out) {
+    const __m128i qv = _mm_set1_epi64x(static_cast<long long>(q));
+    size_t count = 0;
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + i));
+        __m128i eq = _mm_cmpeq_epi32(_mm_and_si128(v, qv), qv);
+        auto bits = static_cast<unsigned>(_mm_movemask_epi8(eq));
+        if ((bits & 0x00FFu) == 0x00FFu) out[count++] = static_cast<uint32_t>(i);
+        if ((bits & 0xFF00u) == 0xFF00u) out[count++] = static_cast<uint32_t>(i + 1);
+    }
+    return count + prefilter_scalar(masks, i, n, q, out + count);
+}
+
+#endif
+
+} // namespace
+
+uint64_t char_mask(const std::string& s) {
+    uint64_t mask = 0;
+    for (char c : s) {
+        mask |= uint64_t{1} << bit_of(c);
+    }
+    return mask;
+}
+
+bool score(const std::string& pattern, const std::string& text, int& result) {
+    result = 0;
+    if (pattern.empty()) return true;
+
+    // Smart case: an uppercase letter in the pattern makes it exact.
+    bool exact = std::any_of(pattern.begin(), pattern.end(),
+                             [](char c) { return c >= 'A' && c <= 'Z'; });
+    auto same = [exact](char t, char p) {
+        return exact ? t == p : to_lower(t) == to_lower(p);
+    };
+
+    // Forward pass: earliest position where the whole pattern has matched.
+    size_t pidx = 0;
+    size_t end = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (same(text[i], pattern[pidx]) && ++pidx == pattern.size()) {
+            end = i + 1;
+            break;
+        }
+    }
+    if (pidx != pattern.size()) return false;
+
+    // Backward pass: shortest window ending there.
+    size_t start = 0;
+    pidx = pattern.size();
+    for (size_t i = end; i-- > 0;) {
+        if (same(text[i], pattern[pidx - 1]) && --pidx == 0) {
+            start = i;
+            break;
+        }
+    }
+
+    int total = 0;
+    int consecutive = 0;
+    int first_bonus = 0;
+    bool in_gap = false;
+    CharClass prev = start > 0 ? classify(text[start - 1]) : CharClass::White;
+    pidx = 0;
+
+    for (size_t i = start; i < end; ++i) {
+        CharClass cls = classify(text[i]);
+        if (pidx < pattern.size() && same(text[i], pattern[pidx])) {
+            int bonus = bonus_for(prev, cls);
+            if (consecutive == 0) {
+                first_bonus = bonus;
+            } else {
+                // A run keeps the bonus of the boundary it started on.
+                if (bonus >= BONUS_BOUNDARY && bonus > first_bonus) {
+                    first_bonus = bonus;
+                }
+                bonus = std::max({bonus, first_bonus, BONUS_CONSECUTIVE});
+            }
+            total += SCORE_MATCH +
+                     (pidx == 0 ? bonus * FIRST_CHAR_MULTIPLIER : bonus);
+            in_gap = false;
+            ++consecutive;
+            ++pidx;
+        } else {
+            total += in_gap ? GAP_EXTENSION : GAP_START;
+            in_gap = true;
+            consecutive = 0;
+            first_bonus = 0;
+        }
+        prev = cls;
+    }
+
+    result = total;
+    return true;
+}
+
+void CandidateSet::assign(std::vector<std::string> items) {
+    items_ = std::move(items);
+    masks_.resize(items_.size());
+    for (size_t i = 0; i < items_.size(); ++i) {
+        masks_[i] = char_mask(items_[i]);
+    }
+}
+
+void CandidateSet::prefilter(uint64_t pattern_mask,
+                             std::vector<uint32_t>& out) const {
+    const size_t n = masks_.size();
+    out.resize(n);
+    size_t count;
+
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2) {
+        count = prefilter_avx2(masks_.data(), n, pattern_mask, out.data());
+    } else
+#endif
+    {
+#ifdef __SSE2__
+        count = prefilter_sse2(masks_.data(), n, pattern_mask, out.data());
+#else
+        count = prefilter_scalar(masks_.data(), 0, n, pattern_mask, out.data());
+#endif
+    }
+
+    out.resize(count);
+}
+
+std::vector<Match> CandidateSet::match(const std::string& pattern) const {
+    std::vector<uint32_t> survivors;
+    prefilter(char_mask(pattern), survivors);
+
+    std::vector<Match> matches;
+    for (uint32_t idx : survivors) {
+        int s;
+        if (score(pattern, items_[idx], s)) {
+            matches.push_back({idx, s});
+        }
+    }
+    return matches;
+}
+
+} // namespace fuzzy
+} // namespace shell
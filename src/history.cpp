@@ -1,6 +1,11 @@
 #include "history.hpp"
+#include "startup.hpp"
+#include "suggest.hpp"
 #include <cstdlib>
+#include <fstream>
+#include <future>
 #include <string>
+#include <vector>
 #include <readline/history.h>
 
 namespace shell {
@@ -10,6 +15,27 @@ namespace {
     std::string history_file_path;
     const char* history_file = nullptr;
     int last_history_length = 0;
+
+    // Lines read by the background loader, merged on first access.
+    std::future<std::vector<std::string>> pending_load;
+
+    // Same result as readline's read_history() + stifle_history(), but
+    // safe to run off the main thread since it touches no readline state.
+    std::vector<std::string> read_history_lines(std::string path) {
+        startup::Phase phase("history read", true);
+        std::vector<std::string> lines;
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            if (!line.empty()) {
+                lines.push_back(std::move(line));
+            }
+        }
+        if (lines.size() > static_cast<size_t>(MAX_HISTORY_SIZE)) {
+            lines.erase(lines.begin(), lines.end() - MAX_HISTORY_SIZE);
+        }
+        return lines;
+    }
 }
 
 void init_history_file() {
@@ -31,17 +57,34 @@ void init_history_file() {
 
 void load_history() {
     if (history_file) {
-        read_history(history_file);
-        stifle_history(MAX_HISTORY_SIZE);
+        pending_load = std::async(std::launch::async, read_history_lines,
+                                  history_file_path);
+    }
+}
+
+void ensure_history_loaded() {
+    if (!pending_load.valid()) return;
+
+    std::vector<std::string> lines;
+    {
+        startup::Phase phase("history wait");
+        lines = pending_load.get();
+    }
+    for (const auto& line : lines) {
+        add_history(line.c_str());
     }
+    stifle_history(MAX_HISTORY_SIZE);
     last_history_length = history_length;
 }
 
 void save_history() {
+    // Never write before the old entries are in, or they would be lost.
+    ensure_history_loaded();
     if (history_file) {
         write_history(history_file);
         history_truncate_file(history_file, MAX_HISTORY_SIZE);
     }
+    suggest::save();
 }
 
 const char* get_history_file() {
@@ -0,0 +1,924 @@
+// The built-in editor, used unless the shell is built with readline.
+#ifndef SHELL_WITH_READLINE
+
+#include "lineedit.hpp"
+#include "history.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <readline/history.h>
+
+namespace shell {
+namespace lineedit {
+
+namespace {
+    // How long to wait for the rest of an escape sequence. Sequences are
+    // sent in one piece, so this only delays a lone Escape key.
+    constexpr int ESC_TIMEOUT_MS = 100;
+    // Above this many matches, ask before listing them (as readline does).
+    constexpr size_t QUERY_ITEMS = 100;
+    // Characters that end the word being completed, unless escaped.
+    const char* const WORD_BREAKS = " \t\n\"'`@$><=;|&{(";
+    // Characters escaped with a backslash in inserted file names.
+    const char* const SPECIAL = " \t\n\\'\"`$|&;<>(){}";
+
+    enum Key : int {
+        KEY_NONE = 0,
+        KEY_EOF = -1,
+        KEY_IDLE = -2,    // idle interval passed
+        KEY_RESIZE = -3,  // SIGWINCH arrived
+        KEY_UP = 256,
+        KEY_DOWN,
+        KEY_LEFT,
+        KEY_RIGHT,
+        KEY_HOME,
+        KEY_END,
+        KEY_DELETE,
+        KEY_WORD_LEFT,
+        KEY_WORD_RIGHT,
+        META = 512,  // META + c: Alt-c, or Escape then c
+    };
+
+    constexpr int ctrl(char c) { return c & 0x1f; }
+
+    Completer completer = nullptr;
+    Suggester suggester = nullptr;
+    IdleHook idle_hook = nullptr;
+    std::chrono::milliseconds idle_interval{100};
+
+    bool history_merged = false;
+    volatile sig_atomic_t resized = 0;
+    termios cooked;
+    bool raw = false;
+    std::string kill_buffer;
+
+    // One character position on screen.
+    struct Cell {
+        std::string glyph;
+        bool grey = false;
+
+        bool operator==(const Cell& other) const {
+            return grey == other.grey && glyph == other.glyph;
+        }
+        bool operator!=(const Cell& other) const { return !(*this == other); }
+    };
+
+    struct Editor {
+        std::string prompt;
+        std::string line;
+        size_t pos = 0;           // cursor, as a byte offset into line
+        std::string hint;         // suggestion after the line
+
+        // History browsing: index into the history list, or history_length
+        // for the line being typed, which is kept in `scratch` meanwhile.
+        int hist_index = -1;
+        std::string scratch;
+
+        // What the terminal shows after the prompt, and where its cursor
+        // is, in cells. Columns count from the start of the prompt's last
+        // line; prompt_width is where the line starts.
+        std::vector<Cell> shown;
+        size_t cursor = 0;
+        size_t prompt_width = 0;
+        size_t prompt_rows = 0;  // prompt rows above its last line
+        size_t cols = 80;
+
+        std::string out;  // pending terminal output, written once per key
+        int last_key = KEY_NONE;
+        bool done = false;
+    };
+
+    Editor* active = nullptr;
+
+    void on_winch(int) {
+        resized = 1;
+    }
+
+    size_t terminal_columns() {
+        winsize ws{};
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+            return ws.ws_col;
+        }
+        return 80;
+    }
+
+    void write_all(const std::string& text) {
+        size_t done = 0;
+        while (done < text.size()) {
+            ssize_t n = write(STDOUT_FILENO, text.data() + done, text.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            done += static_cast<size_t>(n);
+        }
+    }
+
+    void flush(Editor& ed) {
+        write_all(ed.out);
+        ed.out.clear();
+    }
+
+    bool enter_raw() {
+        if (tcgetattr(STDIN_FILENO, &cooked) < 0) return false;
+        termios t = cooked;
+        t.c_iflag &= ~static_cast<tcflag_t>(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+        t.c_oflag &= ~static_cast<tcflag_t>(OPOST);
+        t.c_cflag |= CS8;
+        t.c_lflag &= ~static_cast<tcflag_t>(ECHO | ICANON | IEXTEN | ISIG);
+        t.c_cc[VMIN] = 1;
+        t.c_cc[VTIME] = 0;
+        // TCSADRAIN, not TCSAFLUSH: keys typed while the last command ran
+        // belong to this line.
+        if (tcsetattr(STDIN_FILENO, TCSADRAIN, &t) < 0) return false;
+        raw = true;
+        return true;
+    }
+
+    void leave_raw() {
+        if (raw) {
+            tcsetattr(STDIN_FILENO, TCSADRAIN, &cooked);
+            raw = false;
+        }
+    }
+
+    // --- Input ---
+
+    // 1 with a byte, 0 on timeout, -1 at end of input, -2 if interrupted.
+    int read_byte(int timeout_ms, unsigned char& c) {
+        pollfd pfd{STDIN_FILENO, POLLIN, 0};
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0) return errno == EINTR ? -2 : -1;
+        if (ready == 0) return 0;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        if (n < 0 && errno == EINTR) return -2;
+        return n == 1 ? 1 : -1;
+    }
+
+    bool input_pending() {
+        pollfd pfd{STDIN_FILENO, POLLIN, 0};
+        return poll(&pfd, 1, 0) > 0;
+    }
+
+    // Decodes a CSI or SS3 sequence; the introducer is already read.
+    int read_sequence(unsigned char intro) {
+        std::string params;
+        unsigned char c;
+        for (;;) {
+            if (read_byte(ESC_TIMEOUT_MS, c) != 1) return KEY_NONE;
+            if (c >= 0x40 && c <= 0x7e) break;
+            params += static_cast<char>(c);
+        }
+        bool modified = intro == '[' && (params == "1;5" || params == "1;3" ||
+                                         params == "5" || params == "3");
+        switch (c) {
+            case 'A': return KEY_UP;
+            case 'B': return KEY_DOWN;
+            case 'C': return modified ? KEY_WORD_RIGHT : KEY_RIGHT;
+            case 'D': return modified ? KEY_WORD_LEFT : KEY_LEFT;
+            case 'H': return KEY_HOME;
+            case 'F': return KEY_END;
+            case '~':
+                if (params == "1" || params == "7") return KEY_HOME;
+                if (params == "4" || params == "8") return KEY_END;
+                if (params == "3") return KEY_DELETE;
+                return KEY_NONE;
+            default:
+                return KEY_NONE;
+        }
+    }
+
+    int read_key(int timeout_ms, std::string& text) {
+        unsigned char c;
+        int r = read_byte(timeout_ms, c);
+        if (r == 0) return KEY_IDLE;
+        if (r == -2) return resized ? KEY_RESIZE : KEY_NONE;
+        if (r < 0) return KEY_EOF;
+
+        if (!history_merged) {
+            // As with readline: typing overlaps with the background load,
+            // and Up-arrow still sees the old entries.
+            history::ensure_history_loaded();
+            history_merged = true;
+        }
+
+        if (c == 27) {
+            if (read_byte(ESC_TIMEOUT_MS, c) != 1) return KEY_NONE;
+            if (c == '[' || c == 'O') return read_sequence(c);
+            return META + c;
+        }
+        if (c >= 0x80) {
+            // The rest of a UTF-8 sequence arrives with its first byte.
+            size_t len = c >= 0xf0 ? 4 : c >= 0xe0 ? 3 : c >= 0xc0 ? 2 : 1;
+            text.assign(1, static_cast<char>(c));
+            while (text.size() < len && read_byte(ESC_TIMEOUT_MS, c) == 1) {
+                text += static_cast<char>(c);
+            }
+            return ' ';  // any printable key: insert `text`
+        }
+        text.assign(1, static_cast<char>(c));
+        return c;
+    }
+
+    // --- Text ---
+
+    bool is_continuation(char c) {
+        return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+    }
+
+    size_t prev_char(const std::string& s, size_t pos) {
+        if (pos == 0) return 0;
+        do {
+            --pos;
+        } while (pos > 0 && is_continuation(s[pos]));
+        return pos;
+    }
+
+    size_t next_char(const std::string& s, size_t pos) {
+        if (pos >= s.size()) return s.size();
+        do {
+            ++pos;
+        } while (pos < s.size() && is_continuation(s[pos]));
+        return pos;
+    }
+
+    bool is_word_char(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || static_cast<unsigned char>(c) >= 0x80;
+    }
+
+    size_t word_left(const std::string& s, size_t pos) {
+        while (pos > 0 && !is_word_char(s[pos - 1])) --pos;
+        while (pos > 0 && is_word_char(s[pos - 1])) --pos;
+        return pos;
+    }
+
+    size_t word_right(const std::string& s, size_t pos) {
+        while (pos < s.size() && !is_word_char(s[pos])) ++pos;
+        while (pos < s.size() && is_word_char(s[pos])) ++pos;
+        return pos;
+    }
+
+    // Splits text into screen cells. Control characters show as ^X.
+    void append_cells(std::vector<Cell>& cells, const std::string& text, bool grey) {
+        for (size_t i = 0; i < text.size();) {
+            unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c < 0x20 || c == 0x7f) {
+                cells.push_back({"^", grey});
+                cells.push_back({std::string(1, c == 0x7f ? '?' : static_cast<char>(c + 64)), grey});
+                ++i;
+                continue;
+            }
+            size_t next = next_char(text, i);
+            cells.push_back({text.substr(i, next - i), grey});
+            i = next;
+        }
+    }
+
+    size_t cell_count(const std::string& text) {
+        std::vector<Cell> cells;
+        append_cells(cells, text, false);
+        return cells.size();
+    }
+
+    // The prompt as written, without the invisible-text markers, and the
+    // width of each of its lines.
+    std::string printable_prompt(const std::string& prompt, std::vector<size_t>& widths) {
+        std::string text;
+        widths.assign(1, 0);
+        bool invisible = false;
+        for (char c : prompt) {
+            if (c == PROMPT_START_IGNORE) {
+                invisible = true;
+            } else if (c == PROMPT_END_IGNORE) {
+                invisible = false;
+            } else if (c == '\n') {
+                text += "\r\n";
+                widths.push_back(0);
+            } else {
+                text += c;
+                if (!invisible && !is_continuation(c)) ++widths.back();
+            }
+        }
+        return text;
+    }
+
+    // --- Drawing ---
+
+    // Moves the terminal cursor between two cells of the line.
+    void move_to(Editor& ed, size_t from, size_t to) {
+        size_t from_col = ed.prompt_width + from;
+        size_t to_col = ed.prompt_width + to;
+        size_t from_row = from_col / ed.cols;
+        size_t to_row = to_col / ed.cols;
+        from_col %= ed.cols;
+        to_col %= ed.cols;
+
+        if (to_row < from_row) {
+            ed.out += "\033[" + std::to_string(from_row - to_row) + "A";
+        } else if (to_row > from_row) {
+            ed.out += "\033[" + std::to_string(to_row - from_row) + "B";
+        }
+        if (to_col == from_col) return;
+        if (to_col == 0) {
+            ed.out += '\r';
+        } else if (to_col < from_col) {
+            size_t n = from_col - to_col;
+            ed.out += n <= 3 ? std::string(n, '\b') : "\033[" + std::to_string(n) + "D";
+        } else {
+            ed.out += "\033[" + std::to_string(to_col - from_col) + "C";
+        }
+    }
+
+    // Writes cells [from, to) of `cells`; the cursor must be at `from`.
+    void write_cells(Editor& ed, const std::vector<Cell>& cells, size_t from, size_t to) {
+        bool grey = false;
+        for (size_t i = from; i < to; ++i) {
+            if (cells[i].grey != grey) {
+                grey = cells[i].grey;
+                ed.out += grey ? "\033[90m" : "\033[0m";
+            }
+            ed.out += cells[i].glyph;
+        }
+        if (grey) ed.out += "\033[0m";
+        // A full last row leaves the terminal waiting to wrap; make it
+        // wrap, so the cursor is where the arithmetic says.
+        size_t col = ed.prompt_width + to;
+        if (to > from && col % ed.cols == 0) ed.out += "\r\n";
+        ed.cursor = to;
+    }
+
+    // Brings the screen up to date, rewriting only the cells that changed.
+    void refresh(Editor& ed) {
+        ed.hint.clear();
+        if (suggester && !ed.done && ed.pos == ed.line.size()) {
+            ed.hint = suggester(ed.line);
+            // Suggestions never wrap onto another row.
+            size_t used = (ed.prompt_width + cell_count(ed.line)) % ed.cols;
+            size_t room = ed.cols - used - 1;
+            size_t cut = 0;
+            for (size_t n = 0; cut < ed.hint.size() && n < room; ++n) {
+                cut = next_char(ed.hint, cut);
+            }
+            ed.hint.resize(cut);
+        }
+
+        std::vector<Cell> cells;
+        append_cells(cells, ed.line, false);
+        append_cells(cells, ed.hint, true);
+        size_t target = cell_count(ed.line.substr(0, ed.pos));
+
+        size_t first = 0;
+        while (first < cells.size() && first < ed.shown.size() && cells[first] == ed.shown[first]) {
+            ++first;
+        }
+        size_t last = cells.size();
+        if (cells.size() == ed.shown.size()) {
+            while (last > first && cells[last - 1] == ed.shown[last - 1]) --last;
+        }
+        if (first < last) {
+            move_to(ed, ed.cursor, first);
+            write_cells(ed, cells, first, last);
+        }
+        if (cells.size() < ed.shown.size()) {
+            move_to(ed, ed.cursor, cells.size());
+            ed.cursor = cells.size();
+            ed.out += "\033[J";
+        }
+        move_to(ed, ed.cursor, target);
+        ed.cursor = target;
+        ed.shown = std::move(cells);
+    }
+
+    // Draws the prompt and line from scratch; the cursor must be at the
+    // start of an empty row.
+    void draw_fresh(Editor& ed) {
+        std::vector<size_t> widths;
+        ed.out += printable_prompt(ed.prompt, widths);
+        ed.prompt_rows = 0;
+        for (size_t i = 0; i + 1 < widths.size(); ++i) {
+            ed.prompt_rows += std::max<size_t>(1, (widths[i] + ed.cols - 1) / ed.cols);
+        }
+        ed.prompt_width = widths.back();
+        if (ed.prompt_width > 0 && ed.prompt_width % ed.cols == 0) ed.out += "\r\n";
+        ed.shown.clear();
+        ed.cursor = 0;
+        refresh(ed);
+    }
+
+    // Redraws prompt and line in place, as after a resize or a new prompt.
+    void redraw(Editor& ed) {
+        size_t up = ed.prompt_rows + (ed.prompt_width + ed.cursor) / ed.cols;
+        ed.out += '\r';
+        if (up > 0) ed.out += "\033[" + std::to_string(up) + "A";
+        ed.out += "\033[J";
+        ed.cols = terminal_columns();
+        draw_fresh(ed);
+    }
+
+    // Moves below the line so that output can follow it.
+    void move_below(Editor& ed) {
+        move_to(ed, ed.cursor, ed.shown.size());
+        ed.cursor = ed.shown.size();
+        size_t col = ed.prompt_width + ed.cursor;
+        if (col % ed.cols != 0 || col == 0) ed.out += "\r\n";
+    }
+
+    // --- Editing ---
+
+    void replace(Editor& ed, size_t from, size_t to, const std::string& text) {
+        ed.line.replace(from, to - from, text);
+        ed.pos = from + text.size();
+    }
+
+    void kill(Editor& ed, size_t from, size_t to) {
+        if (from >= to) return;
+        kill_buffer = ed.line.substr(from, to - from);
+        ed.line.erase(from, to - from);
+        ed.pos = from;
+    }
+
+    void history_move(Editor& ed, int step) {
+        HIST_ENTRY** list = history_list();
+        int length = list ? history_length : 0;
+        if (ed.hist_index < 0 || ed.hist_index > length) ed.hist_index = length;
+        int next = ed.hist_index + step;
+        if (next < 0 || next > length) return;
+
+        if (ed.hist_index == length) ed.scratch = ed.line;
+        ed.hist_index = next;
+        ed.line = next == length ? ed.scratch : list[next]->line;
+        ed.pos = ed.line.size();
+    }
+
+    // Accepts the suggestion, or its next word.
+    bool accept_hint(Editor& ed, bool word) {
+        if (ed.pos != ed.line.size() || ed.hint.empty()) return false;
+        std::string text = ed.hint;
+        if (word) {
+            size_t start = text.find_first_not_of(" \t");
+            text = text.substr(0, start == std::string::npos ? text.size()
+                                                             : text.find_first_of(" \t", start));
+        }
+        replace(ed, ed.pos, ed.pos, text);
+        return true;
+    }
+
+    // --- Completion ---
+
+    size_t word_start(const std::string& line, size_t pos) {
+        size_t i = pos;
+        while (i > 0 && (!std::strchr(WORD_BREAKS, line[i - 1]) ||
+                         (i > 1 && line[i - 2] == '\\'))) {
+            --i;
+        }
+        return i;
+    }
+
+    std::string unescape(const std::string& word) {
+        std::string out;
+        for (size_t i = 0; i < word.size(); ++i) {
+            if (word[i] == '\\' && i + 1 < word.size()) ++i;
+            out += word[i];
+        }
+        return out;
+    }
+
+    std::string escape(const std::string& name) {
+        std::string out;
+        for (char c : name) {
+            if (std::strchr(SPECIAL, c)) out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    bool is_directory(const std::string& path) {
+        struct stat st;
+        return stat(expand_tilde(path).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    std::string common_prefix(const std::vector<std::string>& words) {
+        std::string prefix = words[0];
+        for (const auto& w : words) {
+            size_t n = 0;
+            while (n < prefix.size() && n < w.size() && prefix[n] == w[n]) ++n;
+            prefix.resize(n);
+        }
+        // Never end in the middle of a UTF-8 character.
+        while (!prefix.empty() && prefix.size() < words[0].size() &&
+               is_continuation(words[0][prefix.size()])) {
+            prefix.pop_back();
+        }
+        return prefix;
+    }
+
+    // Lists matches in columns under the line, sorted down the columns.
+    void list_matches(Editor& ed, const Completions& result) {
+        std::vector<std::string> names;
+        size_t width = 0;
+        for (const auto& match : result.matches) {
+            std::string name = match;
+            if (result.filenames) {
+                bool dir = !name.empty() && name.back() == '/';
+                if (dir) name.pop_back();
+                size_t slash = name.rfind('/');
+                if (slash != std::string::npos) name.erase(0, slash + 1);
+                if (dir || is_directory(match)) name += '/';
+            }
+            width = std::max(width, cell_count(name));
+            names.push_back(std::move(name));
+        }
+
+        move_below(ed);
+        if (names.size() > QUERY_ITEMS) {
+            ed.out += "Display all " + std::to_string(names.size()) + " possibilities? (y or n)";
+            flush(ed);
+            std::string text;
+            int key;
+            do {
+                key = read_key(-1, text);
+            } while (key == KEY_NONE || key == KEY_RESIZE);
+            ed.out += "\r\n";
+            if (key != 'y' && key != 'Y' && key != ' ') {
+                draw_fresh(ed);
+                return;
+            }
+        }
+
+        width += 2;
+        size_t per_row = std::max<size_t>(1, ed.cols / width);
+        size_t rows = (names.size() + per_row - 1) / per_row;
+        for (size_t r = 0; r < rows; ++r) {
+            for (size_t i = r; i < names.size(); i += rows) {
+                ed.out += names[i];
+                ed.out += std::string(width - cell_count(names[i]), ' ');
+            }
+            ed.out += "\r\n";
+        }
+        draw_fresh(ed);
+    }
+
+    void complete(Editor& ed, bool again) {
+        size_t start = word_start(ed.line, ed.pos);
+        std::string word = unescape(ed.line.substr(start, ed.pos - start));
+        std::string logical = ed.line.substr(0, start) + word;
+        Completions result = completer(logical, start, logical.size());
+        if (!result.ranked) {
+            std::sort(result.matches.begin(), result.matches.end());
+            result.matches.erase(std::unique(result.matches.begin(), result.matches.end()),
+                                 result.matches.end());
+        }
+        auto& matches = result.matches;
+        auto quote = [&](const std::string& text) {
+            return result.filenames ? escape(text) : text;
+        };
+
+        if (matches.empty()) {
+            ed.out += '\a';
+            return;
+        }
+        if (matches.size() == 1) {
+            const std::string& match = matches[0];
+            std::string suffix = " ";
+            if (!match.empty() && match.back() == '/') {
+                suffix.clear();
+            } else if (result.filenames && is_directory(match)) {
+                suffix = "/";
+            }
+            replace(ed, start, ed.pos, quote(match) + suffix);
+            return;
+        }
+
+        std::string prefix = common_prefix(matches);
+        if (prefix.size() > word.size() && prefix.compare(0, word.size(), word) == 0) {
+            replace(ed, start, ed.pos, quote(prefix));
+        } else if (again) {
+            list_matches(ed, result);
+        } else {
+            ed.out += '\a';
+        }
+    }
+
+    // --- Incremental search (Ctrl-R) ---
+
+    // Searches history entries at or before `from` for `query`.
+    int search_back(const std::string& query, int from) {
+        HIST_ENTRY** list = history_list();
+        if (!list) return -1;
+        for (int i = std::min(from, history_length - 1); i >= 0; --i) {
+            if (std::strstr(list[i]->line, query.c_str())) return i;
+        }
+        return -1;
+    }
+
+    // Returns the key that ended the search, with the found line in the
+    // editor; Ctrl-G and Ctrl-C restore the line as it was.
+    int search(Editor& ed) {
+        std::string saved_prompt = ed.prompt;
+        std::string saved_line = ed.line;
+        size_t saved_pos = ed.pos;
+        std::string query;
+        int match = history_length;
+        bool failed = false;
+        Suggester saved_suggester = suggester;
+        suggester = nullptr;
+
+        int key;
+        std::string text;
+        for (;;) {
+            ed.prompt = std::string(failed ? "(failed " : "(") + "reverse-i-search)`" + query + "': ";
+            redraw(ed);
+            flush(ed);
+
+            key = read_key(-1, text);
+            if (key == KEY_NONE || key == KEY_RESIZE) continue;
+            if (key == ctrl('R')) {
+                int found = query.empty() ? -1 : search_back(query, match - 1);
+                failed = found < 0;
+                if (!failed) match = found;
+            } else if (key == 127 || key == ctrl('H')) {
+                query.erase(prev_char(query, query.size()));
+                match = history_length;
+                failed = false;
+            } else if (key >= ' ' && key < 127) {
+                query += text;
+                int found = search_back(query, match);
+                failed = found < 0;
+                if (!failed) match = found;
+            } else {
+                break;
+            }
+            if (query.empty()) {
+                ed.line = saved_line;
+                ed.pos = saved_pos;
+            } else if (!failed && match < history_length) {
+                ed.line = history_list()[match]->line;
+                ed.pos = ed.line.find(query);
+            }
+        }
+
+        suggester = saved_suggester;
+        ed.prompt = saved_prompt;
+        if (key == ctrl('G') || key == ctrl('C')) {
+            ed.line = saved_line;
+            ed.pos = saved_pos;
+        } else if (match < history_length) {
+            ed.hist_index = match;
+        }
+        redraw(ed);
+        return key == ctrl('G') || key == ctrl('C') ? KEY_NONE : key;
+    }
+
+    // --- Main loop ---
+
+    // Returns 1 to accept the line, 0 at end of input, -1 to keep going.
+    int handle(Editor& ed, int key, const std::string& text) {
+        switch (key) {
+            case KEY_NONE:
+                break;
+            case '\r':
+            case '\n':
+                return 1;
+            case ctrl('D'):
+                if (ed.line.empty()) return 0;
+                [[fallthrough]];
+            case KEY_DELETE:
+                if (ed.pos == ed.line.size()) {
+                    ed.out += '\a';
+                } else {
+                    ed.line.erase(ed.pos, next_char(ed.line, ed.pos) - ed.pos);
+                }
+                break;
+            case 127:
+            case ctrl('H'):
+                if (ed.pos == 0) {
+                    ed.out += '\a';
+                } else {
+                    size_t prev = prev_char(ed.line, ed.pos);
+                    ed.line.erase(prev, ed.pos - prev);
+                    ed.pos = prev;
+                }
+                break;
+            case ctrl('A'):
+            case KEY_HOME:
+                ed.pos = 0;
+                break;
+            case ctrl('E'):
+            case KEY_END:
+                if (!accept_hint(ed, false)) ed.pos = ed.line.size();
+                break;
+            case ctrl('B'):
+            case KEY_LEFT:
+                ed.pos = prev_char(ed.line, ed.pos);
+                break;
+            case ctrl('F'):
+            case KEY_RIGHT:
+                if (!accept_hint(ed, false)) ed.pos = next_char(ed.line, ed.pos);
+                break;
+            case META + 'b':
+            case KEY_WORD_LEFT:
+                ed.pos = word_left(ed.line, ed.pos);
+                break;
+            case META + 'f':
+            case KEY_WORD_RIGHT:
+                if (!accept_hint(ed, true)) ed.pos = word_right(ed.line, ed.pos);
+                break;
+            case ctrl('K'):
+                kill(ed, ed.pos, ed.line.size());
+                break;
+            case ctrl('U'):
+                kill(ed, 0, ed.pos);
+                break;
+            case ctrl('W'): {
+                size_t start = ed.pos;
+                while (start > 0 && std::isspace(static_cast<unsigned char>(ed.line[start - 1]))) --start;
+                while (start > 0 && !std::isspace(static_cast<unsigned char>(ed.line[start - 1]))) --start;
+                kill(ed, start, ed.pos);
+                break;
+            }
+            case META + 127:
+            case META + ctrl('H'):
+                kill(ed, word_left(ed.line, ed.pos), ed.pos);
+                break;
+            case META + 'd':
+                kill(ed, ed.pos, word_right(ed.line, ed.pos));
+                break;
+            case ctrl('Y'):
+                replace(ed, ed.pos, ed.pos, kill_buffer);
+                break;
+            case ctrl('T'):
+                if (ed.pos > 0 && ed.line.size() > 1) {
+                    if (ed.pos == ed.line.size()) ed.pos = prev_char(ed.line, ed.pos);
+                    size_t a = prev_char(ed.line, ed.pos);
+                    size_t b = next_char(ed.line, ed.pos);
+                    std::string first = ed.line.substr(a, ed.pos - a);
+                    std::string second = ed.line.substr(ed.pos, b - ed.pos);
+                    ed.line.replace(a, b - a, second + first);
+                    ed.pos = b;
+                }
+                break;
+            case ctrl('P'):
+            case KEY_UP:
+                history_move(ed, -1);
+                break;
+            case ctrl('N'):
+            case KEY_DOWN:
+                history_move(ed, 1);
+                break;
+            case ctrl('L'):
+                ed.out += "\033[H\033[2J";
+                draw_fresh(ed);
+                break;
+            case ctrl('C'):
+                move_to(ed, ed.cursor, ed.shown.size());
+                ed.cursor = ed.shown.size();
+                ed.out += "^C\r\n";
+                ed.line.clear();
+                ed.pos = 0;
+                ed.hist_index = -1;
+                draw_fresh(ed);
+                break;
+            case ctrl('R'):
+                if (!history_length) break;
+                return handle(ed, search(ed), text);
+            case '\t':
+                if (completer) {
+                    complete(ed, ed.last_key == '\t');
+                } else {
+                    replace(ed, ed.pos, ed.pos, "\t");
+                }
+                break;
+            default:
+                if (key >= ' ' && key < 127) {
+                    replace(ed, ed.pos, ed.pos, text);
+                }
+                break;
+        }
+        return -1;
+    }
+
+    // Without a usable terminal: print the prompt and read up to a
+    // newline, echoing the line when the terminal did not (as readline
+    // does with redirected input).
+    bool read_plain(const std::string& prompt, std::string& line, bool echo) {
+        std::vector<size_t> widths;
+        std::string text = printable_prompt(prompt, widths);
+        for (size_t at; (at = text.find("\r\n")) != std::string::npos;) text.erase(at, 1);
+        write_all(text);
+
+        line.clear();
+        char c;
+        ssize_t n;
+        while ((n = read(STDIN_FILENO, &c, 1)) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            if (c == '\n') break;
+            line += c;
+        }
+        if (n <= 0 && line.empty()) return false;
+        if (echo) write_all(line + "\n");
+        return true;
+    }
+}
+
+void init() {
+    struct sigaction sa {};
+    sa.sa_handler = on_winch;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGWINCH, &sa, nullptr);  // no SA_RESTART: wake up poll()
+    std::atexit(leave_raw);
+}
+
+bool read_line(const std::string& prompt, std::string& line) {
+    const char* term = getenv("TERM");
+    bool tty = isatty(STDIN_FILENO);
+    if (!tty || (term && std::strcmp(term, "dumb") == 0) || !enter_raw()) {
+        return read_plain(prompt, line, !tty);
+    }
+
+    Editor ed;
+    ed.prompt = prompt;
+    ed.cols = terminal_columns();
+    active = &ed;
+    draw_fresh(ed);
+    flush(ed);
+
+    int result = -1;
+    while (result < 0) {
+        std::string text;
+        int timeout = idle_hook ? static_cast<int>(idle_interval.count()) : -1;
+        int key = read_key(timeout, text);
+        if (key == KEY_EOF) {
+            result = 0;
+            break;
+        }
+        if (key == KEY_IDLE) {
+            std::string fresh;
+            IdleHook hook = idle_hook;
+            if (hook && hook(fresh)) {
+                ed.prompt = fresh;
+                redraw(ed);
+            }
+        } else if (key == KEY_RESIZE) {
+            resized = 0;
+            redraw(ed);
+        } else {
+            result = handle(ed, key, text);
+            ed.last_key = key;
+            if (result < 0) {
+                // A paste is drawn once, after its last key.
+                if (!input_pending()) refresh(ed);
+            } else if (result > 0) {
+                // Leave the line on screen as entered, without a suggestion.
+                ed.done = true;
+                ed.pos = ed.line.size();
+                refresh(ed);
+                move_below(ed);
+            }
+        }
+        if (!ed.out.empty() && !input_pending()) flush(ed);
+    }
+
+    flush(ed);
+    active = nullptr;
+    leave_raw();
+    if (result == 0) return false;
+    line = ed.line;
+    return true;
+}
+
+void set_completer(Completer fn) {
+    completer = fn;
+}
+
+void set_suggester(Suggester fn) {
+    suggester = fn;
+}
+
+void set_idle_hook(IdleHook hook, std::chrono::milliseconds interval) {
+    idle_hook = hook;
+    idle_interval = interval;
+}
+
+void show_message(const std::string& text) {
+    if (!active) {
+        write_all(text + "\n");
+        return;
+    }
+    move_below(*active);
+    active->out += text + "\r\n";
+    draw_fresh(*active);
+}
+
+} // namespace lineedit
+} // namespace shell
+
+#endif // SHELL_WITH_READLINE
@@ -0,0 +1,241 @@
+// The line editor on top of GNU readline (built with SHELL_WITH_READLINE).
+#ifdef SHELL_WITH_READLINE
+
+#include "lineedit.hpp"
+#include "history.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <readline/readline.h>
+#include <readline/history.h>
+
+namespace shell {
+namespace lineedit {
+
+namespace {
+    constexpr int DEFAULT_IDLE_USEC = 100000;  // readline's own default
+
+    Completer completer = nullptr;
+    Suggester suggester = nullptr;
+    IdleHook idle_hook = nullptr;
+
+    // Matches handed out one at a time by vector_generator().
+    std::vector<std::string> pending;
+
+    // What is on screen.
+    bool shown = false;
+
+    // Readline calls this for every key. History is merged just before the
+    // first key is handled, so typing overlaps with the background load and
+    // Up-arrow still sees the old entries.
+    int first_key_getc(FILE* stream) {
+        int c = rl_getc(stream);
+        history::ensure_history_loaded();
+        using_history();  // point readline's history cursor past the merged entries
+        rl_getc_function = rl_getc;
+        return c;
+    }
+
+    char* vector_generator(const char* /*text*/, int state) {
+        static size_t index;
+        if (state == 0) index = 0;
+        return index < pending.size() ? strdup(pending[index++].c_str()) : nullptr;
+    }
+
+    char** attempted_completion(const char* text, int start, int end) {
+        rl_attempted_completion_over = 1;
+        Completions result = completer(std::string(rl_line_buffer, static_cast<size_t>(rl_end)),
+                                       static_cast<size_t>(start), static_cast<size_t>(end));
+        if (result.matches.empty()) return nullptr;
+
+        rl_sort_completion_matches = result.ranked ? 0 : 1;
+        // Lets readline mark directories with a '/'
+        rl_filename_completion_desired = result.filenames ? 1 : 0;
+
+        if (!result.ranked || result.matches.size() == 1) {
+            pending = std::move(result.matches);
+            char** matches = rl_completion_matches(text, vector_generator);
+            pending.clear();
+            return matches;
+        }
+
+        // matches[0] replaces the typed word. Ranked matches need not share
+        // a prefix, so keep the word as typed.
+        size_t count = result.matches.size();
+        auto out = static_cast<char**>(malloc((count + 2) * sizeof(char*)));
+        out[0] = strdup(text);
+        for (size_t i = 0; i < count; ++i) {
+            out[i + 1] = strdup(result.matches[i].c_str());
+        }
+        out[count + 1] = nullptr;
+        return out;
+    }
+
+    int on_event() {
+        IdleHook hook = idle_hook;
+        std::string prompt;
+        if (hook && hook(prompt)) {
+            rl_set_prompt(prompt.c_str());
+            rl_forced_update_display();
+        }
+        return 0;
+    }
+
+    // --- Inline suggestions ---
+
+    // Terminal columns taken by UTF-8 text, counting one per code point.
+    int columns(const char* text, size_t len) {
+        int n = 0;
+        for (size_t i = 0; i < len; ++i) {
+            if ((static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) ++n;
+        }
+        return n;
+    }
+
+    // Width of the prompt's last line, skipping \[ \] sections.
+    int prompt_columns() {
+        const char* prompt = rl_display_prompt ? rl_display_prompt : "";
+        int n = 0;
+        bool invisible = false;
+        for (const char* p = prompt; *p; ++p) {
+            if (*p == RL_PROMPT_START_IGNORE) {
+                invisible = true;
+            } else if (*p == RL_PROMPT_END_IGNORE) {
+                invisible = false;
+            } else if (*p == '\n') {
+                n = 0;
+            } else if (!invisible && (static_cast<unsigned char>(*p) & 0xC0) != 0x80) {
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    std::string suggestion_for_line() {
+        return suggester(std::string(rl_line_buffer, static_cast<size_t>(rl_end)));
+    }
+
+    // Readline's redisplay plus the greyed-out suggestion after the cursor.
+    // The suggestion is drawn with the cursor saved and restored, so
+    // readline's idea of the screen stays correct.
+    void redisplay() {
+        rl_redisplay();
+
+        std::string out;
+        if (rl_point < rl_end) {
+            if (shown) {
+                // Wipe the old suggestion past the end of the line.
+                int tail = columns(rl_line_buffer + rl_point, static_cast<size_t>(rl_end - rl_point));
+                out = "\0337\033[" + std::to_string(tail) + "C\033[K\0338";
+                shown = false;
+            }
+        } else {
+            std::string text;
+            if (!rl_done) {
+                text = suggestion_for_line();
+            }
+            int rows, cols;
+            rl_get_screen_size(&rows, &cols);
+            int used = cols > 0 ? (prompt_columns() + columns(rl_line_buffer, static_cast<size_t>(rl_end))) % cols : 0;
+            int room = cols - used - 1;
+            size_t cut = 0;
+            for (int n = 0; cut < text.size(); ++cut) {
+                if ((static_cast<unsigned char>(text[cut]) & 0xC0) != 0x80 && ++n > room) break;
+            }
+            text.resize(cut);
+
+            if (shown || !text.empty()) {
+                out = "\0337\033[K";
+                if (!text.empty()) out += "\033[90m" + text + "\033[0m";
+                out += "\0338";
+                shown = !text.empty();
+            }
+        }
+        if (!out.empty()) {
+            fwrite(out.data(), 1, out.size(), rl_outstream);
+            fflush(rl_outstream);
+        }
+    }
+
+    // Accepts the suggestion when the cursor is at the end of the line,
+    // or runs `fallback` as the key normally would.
+    int accept_or(rl_command_func_t* fallback, int count, int key) {
+        if (rl_point != rl_end || !shown) return fallback(count, key);
+        std::string text = suggestion_for_line();
+        rl_insert_text(text.c_str());
+        return 0;
+    }
+
+    int accept_forward(int count, int key) { return accept_or(rl_forward_char, count, key); }
+    int accept_end(int count, int key) { return accept_or(rl_end_of_line, count, key); }
+
+    int accept_word(int count, int key) {
+        if (rl_point != rl_end || !shown) return rl_forward_word(count, key);
+        std::string text = suggestion_for_line();
+        size_t start = text.find_first_not_of(" \t");
+        size_t end = start == std::string::npos ? text.size() : text.find_first_of(" \t", start);
+        rl_insert_text(text.substr(0, end).c_str());
+        return 0;
+    }
+
+    // Clears the suggestion before readline moves to a new line.
+    int accept_line(int count, int key) {
+        rl_done = 1;
+        redisplay();
+        return rl_newline(count, key);
+    }
+}
+
+void init() {
+    rl_getc_function = first_key_getc;
+    rl_initialize();
+}
+
+bool read_line(const std::string& prompt, std::string& line) {
+    char* input = readline(prompt.c_str());
+    if (!input) return false;
+    line = input;
+    free(input);
+    return true;
+}
+
+void set_completer(Completer fn) {
+    completer = fn;
+    rl_attempted_completion_function = fn ? attempted_completion : nullptr;
+}
+
+void set_suggester(Suggester fn) {
+    suggester = fn;
+    if (!fn) {
+        rl_redisplay_function = rl_redisplay;
+        return;
+    }
+    rl_redisplay_function = redisplay;
+    rl_bind_keyseq("\033[C", accept_forward);
+    rl_bind_keyseq("\033OC", accept_forward);
+    rl_bind_keyseq("\\C-f", accept_forward);
+    rl_bind_keyseq("\033[F", accept_end);
+    rl_bind_keyseq("\033OF", accept_end);
+    rl_bind_keyseq("\\C-e", accept_end);
+    rl_bind_keyseq("\\ef", accept_word);
+    rl_bind_key('\r', accept_line);
+    rl_bind_key('\n', accept_line);
+}
+
+void set_idle_hook(IdleHook hook, std::chrono::milliseconds interval) {
+    idle_hook = hook;
+    rl_event_hook = hook ? on_event : nullptr;
+    rl_set_keyboard_input_timeout(
+        hook ? static_cast<int>(interval.count() * 1000) : DEFAULT_IDLE_USEC);
+}
+
+void show_message(const std::string& text) {
+    fprintf(rl_outstream, "\n%s\n", text.c_str());
+    rl_on_new_line();
+    rl_redisplay();
+}
+
+} // namespace lineedit
+} // namespace shell
+
+#endif // SHELL_WITH_READLINE
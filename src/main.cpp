@@ -1,44 +1,120 @@
 #include "history.hpp"
 #include "completion.hpp"
 #include "executor.hpp"
+#include "lineedit.hpp"
+#include "prompt.hpp"
+#include "script.hpp"
+#include "server.hpp"
+#include "suggest.hpp"
+#include "variables.hpp"
+#include "startup.hpp"
+#include <chrono>
 #include <iostream>
 #include <cstdlib>
-#include <readline/readline.h>
+#include <cstring>
+#include <system_error>
+#include <thread>
+#include <vector>
 #include <readline/history.h>
 
-int main() {
+int main(int argc, char* argv[]) {
+    const char* serve_path = nullptr;
+    const char* command = nullptr;
+    const char* script_path = nullptr;
+    std::vector<std::string> positional{argv[0]};
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--startup-profile") == 0) {
+            shell::startup::enable_profile();
+        } else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serve_path = argv[++i];
+        } else if (std::strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            // As with sh -c, the next argument is $0 and the rest $1...
+            command = argv[++i];
+            if (i + 1 < argc) positional.assign(argv + i + 1, argv + argc);
+            break;
+        } else if (argv[i][0] != '-') {
+            script_path = argv[i];
+            positional.assign(argv + i, argv + argc);
+            break;
+        } else {
+            std::cerr << "shell: " << argv[i] << ": invalid option\n";
+            return 2;
+        }
+    }
+
     // Disable output buffering
     std::cout << std::unitbuf;
     std::cerr << std::unitbuf;
 
-    // Initialize history
-    shell::history::init_history_file();
-    using_history();
-    shell::history::load_history();
+    // Server mode skips the line editor and history entirely
+    if (serve_path) {
+        return shell::server::serve(serve_path);
+    }
+
+    // So do -c and scripts, whose last command may replace the shell
+    if (command || script_path) {
+        shell::variables::set_positional(std::move(positional));
+        return command ? shell::script::run_command(command)
+                       : shell::script::run_file(script_path);
+    }
+
+    // Initialize history; the file itself is read in the background
+    {
+        shell::startup::Phase phase("history init");
+        shell::history::init_history_file();
+        using_history();
+        shell::history::load_history();
+    }
+
+    // Initialize completion and warm its directory cache off-thread
+    {
+        shell::startup::Phase phase("completion init");
+        shell::completion::init_completion();
+        try {
+            std::thread(shell::completion::warm_up).detach();
+        } catch (const std::system_error&) {
+            // Completion scans on demand instead.
+        }
+    }
+
+    // Inline suggestions; their index also loads in the background
+    {
+        shell::startup::Phase phase("suggest init");
+        shell::suggest::init();
+    }
+
+    {
+        shell::startup::Phase phase("line editor init");
+        shell::lineedit::init();
+    }
 
-    // Initialize completion
-    shell::completion::init_completion();
+    shell::script::load_rc();
 
     // Main loop
+    shell::startup::mark_first_prompt();
     while (true) {
-        char* line = readline("$ ");
-        
-        if (!line) {
+        std::string prompt = shell::prompt::begin();
+        std::string input;
+        bool got_line = shell::lineedit::read_line(prompt, input);
+        shell::history::ensure_history_loaded();
+        shell::startup::report();
+
+        if (!got_line) {
             // EOF (Ctrl+D)
             break;
         }
-        
-        if (*line) {
-            add_history(line);
-        }
 
-        std::string input(line);
-        free(line);
+        if (!input.empty()) {
+            add_history(input.c_str());
+            shell::suggest::record(input);
+        }
 
+        auto started = std::chrono::steady_clock::now();
         shell::executor::execute(input);
+        shell::prompt::command_finished(std::chrono::steady_clock::now() - started);
     }
 
     shell::history::save_history();
     std::cout << std::endl;
     return 0;
-}
\ No newline at end of file
+}
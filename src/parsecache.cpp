@@ -0,0 +1,209 @@
+#include "parsecache.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace shell {
+namespace parsecache {
+
+namespace {
+
+// Bump whenever the on-disk layout or the tokenizer's output changes.
+constexpr uint32_t FORMAT_VERSION = 4;
+constexpr char MAGIC[4] = {'M', 'S', 'P', 'C'};
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ULL;
+constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+
+// Layout (host byte order; the magic and version reject foreign files):
+//   magic[4] version:u32 path:str mtime_sec:i64 mtime_nsec:i64 size:u64
+//   hash:u64 lines:u32 { dynamic:u8 (text:str | tokens:u32 { token:str flags:u8 }...) }...
+// where str is a u32 length followed by the bytes.
+
+template <typename T>
+void put(std::string& buf, T value) {
+    buf.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void put_str(std::string& buf, const std::string& s) {
+    put(buf, static_cast<uint32_t>(s.size()));
+    buf.append(s);
+}
+
+// Bounds-checked reader over the cache file contents.
+class Reader {
+public:
+    explicit Reader(const std::string& buf) : buf_(buf) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (buf_.size() - pos_ < sizeof(value)) return false;
+        std::memcpy(&value, buf_.data() + pos_, sizeof(value));
+        pos_ += sizeof(value);
+        return true;
+    }
+
+    bool get_str(std::string& s) {
+        uint32_t len;
+        if (!get(len) || buf_.size() - pos_ < len) return false;
+        s.assign(buf_, pos_, len);
+        pos_ += len;
+        return true;
+    }
+
+    bool at_end() const { return pos_ == buf_.size(); }
+
+private:
+    const std::string& buf_;
+    size_t pos_ = 0;
+};
+
+std::string entry_path(const std::string& path) {
+    std::string dir = cache_dir();
+    if (dir.empty()) return "";
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.pc",
+             static_cast<unsigned long long>(hash_content(path)));
+    return dir + "/" + name;
+}
+
+bool make_dirs(const std::string& dir) {
+    for (size_t pos = 1; pos != std::string::npos; ++pos) {
+        pos = dir.find('/', pos);
+        std::string part = dir.substr(0, pos);
+        if (mkdir(part.c_str(), 0700) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (pos == std::string::npos) break;
+    }
+    return true;
+}
+
+} // namespace
+
+uint64_t hash_content(const std::string& data) {
+    uint64_t h = FNV_OFFSET;
+    for (char c : data) {
+        h ^= static_cast<unsigned char>(c);
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+std::string cache_dir() {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && xdg[0] == '/') {
+        return std::string(xdg) + "/myshell";
+    }
+    const char* home = getenv("HOME");
+    if (home && home[0] != '\0') {
+        return std::string(home) + "/.cache/myshell";
+    }
+    return "";
+}
+
+bool load(const std::string& path, const FileKey& key, ParsedScript& out) {
+    std::string file = entry_path(path);
+    if (file.empty()) return false;
+
+    std::ifstream in(file, std::ios::binary);
+    if (!in) return false;
+    std::string buf((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+
+    Reader r(buf);
+    char magic[4];
+    uint32_t version;
+    std::string cached_path;
+    FileKey cached;
+    uint32_t lines;
+
+    if (!r.get(magic) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !r.get(version) || version != FORMAT_VERSION ||
+        !r.get_str(cached_path) || cached_path != path ||
+        !r.get(cached.mtime_sec) || !r.get(cached.mtime_nsec) ||
+        !r.get(cached.size) || !r.get(cached.content_hash) ||
+        !r.get(lines)) {
+        return false;
+    }
+    if (cached.mtime_sec != key.mtime_sec ||
+        cached.mtime_nsec != key.mtime_nsec || cached.size != key.size ||
+        cached.content_hash != key.content_hash) {
+        return false;
+    }
+
+    ParsedScript script(lines);
+    for (auto& line : script) {
+        uint8_t dynamic;
+        if (!r.get(dynamic)) return false;
+        line.dynamic = dynamic != 0;
+        if (line.dynamic) {
+            if (!r.get_str(line.text)) return false;
+            continue;
+        }
+        uint32_t count;
+        if (!r.get(count)) return false;
+        line.tokens.words.resize(count);
+        for (auto& token : line.tokens.words) {
+            uint8_t flags;
+            if (!r.get_str(token) || !r.get(flags)) return false;
+            line.tokens.flags.push_back(flags);
+        }
+    }
+    if (!r.at_end()) return false;
+
+    out = std::move(script);
+    return true;
+}
+
+void store(const std::string& path, const FileKey& key,
+           const ParsedScript& script) {
+    std::string file = entry_path(path);
+    if (file.empty() || !make_dirs(cache_dir())) return;
+
+    std::string buf(MAGIC, sizeof(MAGIC));
+    put(buf, FORMAT_VERSION);
+    put_str(buf, path);
+    put(buf, key.mtime_sec);
+    put(buf, key.mtime_nsec);
+    put(buf, key.size);
+    put(buf, key.content_hash);
+    put(buf, static_cast<uint32_t>(script.size()));
+    for (const auto& line : script) {
+        put(buf, static_cast<uint8_t>(line.dynamic));
+        if (line.dynamic) {
+            put_str(buf, line.text);
+            continue;
+        }
+        put(buf, static_cast<uint32_t>(line.tokens.words.size()));
+        // A token's flags say whether it was typed as an operator; its
+        // text alone cannot tell '|' from a quoted "|".
+        for (size_t i = 0; i < line.tokens.words.size(); ++i) {
+            put_str(buf, line.tokens.words[i]);
+            put(buf, static_cast<uint8_t>(line.tokens.flags[i]));
+        }
+    }
+
+    // Write-then-rename so a concurrent shell never reads a torn entry.
+    std::string tmp = file + "." + std::to_string(getpid());
+    {
+        std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+        os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+        if (!os) {
+            unlink(tmp.c_str());
+            return;
+        }
+    }
+    if (rename(tmp.c_str(), file.c_str()) != 0) {
+        unlink(tmp.c_str());
+    }
+}
+
+} // namespace parsecache
+} // namespace shell
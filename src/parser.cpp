@@ -1,40 +1,643 @@
 #include "parser.hpp"
+#include "arith.hpp"
+#include "stats.hpp"
+#include "variables.hpp"
+#include <algorithm>
+#include <charconv>
 #include <iostream>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
 
 namespace shell {
 namespace parser {
 
-std::vector<std::string> tokenize(const std::string& input) {
+namespace {
+
+// Returns the index of the ')' matching the '(' at `open`, skipping quoted
+// text, or npos when the parentheses are unbalanced.
+size_t find_closing_paren(const std::string& input, size_t open) {
+    int depth = 0;
+    char quote = '\0';
+
+    for (size_t i = open; i < input.size(); ++i) {
+        char c = input[i];
+        if (quote) {
+            if (c == quote) {
+                quote = '\0';
+            } else if (c == '\\' && quote == '"' && i + 1 < input.size()) {
+                ++i;
+            }
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+        } else if (c == '\\' && i + 1 < input.size()) {
+            ++i;
+        } else if (c == '(') {
+            ++depth;
+        } else if (c == ')' && --depth == 0) {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+bool is_name_start(char c) {
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool is_name_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+size_t expand_parameter(const std::string& input, size_t i, std::string& current,
+                        std::vector<std::string>& tokens);
+
+// Appends the words of ${name[@]} or $@: each one a separate token,
+// or joined with spaces for the * forms.
+void append_words(const std::vector<std::string>& values, bool joined,
+                  std::string& current, std::vector<std::string>& tokens) {
+    for (size_t k = 0; k < values.size(); ++k) {
+        if (k > 0 && joined) {
+            current += ' ';
+        } else if (k > 0) {
+            tokens.push_back(current);
+            current.clear();
+        }
+        current += values[k];
+    }
+}
+
+// Appends a quoted character. Inside [[ ]] punctuation keeps a backslash
+// so that == and =~ can tell quoted characters from pattern syntax.
+void append_quoted(std::string& current, char c, bool conditional) {
+    if (conditional && !std::isalnum(static_cast<unsigned char>(c))) current += '\\';
+    current += c;
+}
+
+// Finds the "))" closing the "((" at `open`, or npos. The two ')' must
+// close the two '(' so that "((a) + (b))" is not taken for arithmetic.
+size_t find_double_paren(const std::string& input, size_t open) {
+    size_t close = find_closing_paren(input, open);
+    if (close == std::string::npos || close < open + 3 ||
+        find_closing_paren(input, open + 1) != close - 1) {
+        return std::string::npos;
+    }
+    return close;
+}
+
+// Expands the parameter references inside an arithmetic expression.
+bool expand_arithmetic_text(const std::string& text, std::string& out) {
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '$') {
+            out += text[i];
+            continue;
+        }
+        std::string value;
+        std::vector<std::string> words;  // ${name[@]}: all but the last element
+        i = expand_parameter(text, i, value, words);
+        if (i == std::string::npos) return false;
+        for (const auto& word : words) {
+            out += word + " ";
+        }
+        out += value;
+    }
+    return true;
+}
+
+// Appends the value of the $(( expr )) at input[i] to `current` and
+// returns the index of its last character, or npos after an error.
+size_t expand_arithmetic(const std::string& input, size_t i, std::string& current) {
+    size_t close = find_double_paren(input, i + 1);
+    if (close == std::string::npos) {
+        std::cerr << "shell: " << input.substr(i) << ": bad substitution\n";
+        return std::string::npos;
+    }
+
+    std::string expr;
+    int64_t value;
+    if (!expand_arithmetic_text(input.substr(i + 3, close - i - 4), expr) ||
+        !arith::evaluate(expr, value)) {
+        return std::string::npos;
+    }
+    current += std::to_string(value);
+    return close;
+}
+
+// Appends the expansion of the parameter reference at input[i] ('$') to
+// `current` and returns the index of its last character, or npos after
+// reporting a bad substitution. "${name[@]}" yields one word per element,
+// so all but the last are pushed to `tokens`. A '$' that doesn't start a
+// reference stays literal. Expanded text is never re-tokenized.
+size_t expand_parameter(const std::string& input, size_t i, std::string& current,
+                        std::vector<std::string>& tokens) {
+    char c = i + 1 < input.size() ? input[i + 1] : '\0';
+
+    if (c == '(' && i + 2 < input.size() && input[i + 2] == '(') {
+        return expand_arithmetic(input, i, current);
+    }
+    if (c == '?' || c == '$' || c == '#' || std::isdigit(static_cast<unsigned char>(c))) {
+        current += variables::get(std::string(1, c));
+        return i + 1;
+    }
+    if (c == '@' || c == '*') {
+        append_words(variables::get_all("@"), c == '*', current, tokens);
+        return i + 1;
+    }
+    if (is_name_start(c)) {
+        size_t end = i + 1;
+        while (end < input.size() && is_name_char(input[end])) ++end;
+        current += variables::get(input.substr(i + 1, end - i - 1));
+        return end - 1;
+    }
+    if (c != '{') {
+        current += '$';
+        return i;
+    }
+
+    size_t close = input.find('}', i + 2);
+    std::string body = close == std::string::npos
+                           ? input.substr(i + 2)
+                           : input.substr(i + 2, close - i - 2);
+
+    // ${#name} and ${#name[@]} give a length instead of the value.
+    bool length = body.size() > 1 && body[0] == '#';
+    std::string name = length ? body.substr(1) : body;
+    std::string sub;
+    bool has_sub = false;
+    size_t bracket = name.find('[');
+    if (bracket != std::string::npos && name.back() == ']') {
+        sub = name.substr(bracket + 1, name.size() - bracket - 2);
+        name.resize(bracket);
+        has_sub = true;
+    }
+
+    bool special = name == "?" || name == "$" || name == "#" || name == "@" || name == "*" ||
+                   (!name.empty() && name.find_first_not_of("0123456789") == std::string::npos);
+    if (close == std::string::npos || !(variables::is_valid_name(name) || special)) {
+        std::cerr << "shell: ${" << body << (close == std::string::npos ? "" : "}")
+                  << ": bad substitution\n";
+        return std::string::npos;
+    }
+
+    if (!has_sub && (name == "@" || name == "*")) {
+        sub = name;
+        has_sub = true;
+    }
+    if (has_sub && (sub == "@" || sub == "*")) {
+        auto values = variables::get_all(name);
+        if (length) {
+            current += std::to_string(values.size());
+        } else {
+            append_words(values, sub == "*", current, tokens);
+        }
+        return close;
+    }
+
+    std::string value;
+    if (has_sub) {
+        size_t index;
+        if (!variables::resolve_index(sub, index)) {
+            std::cerr << "shell: " << sub << ": bad array subscript\n";
+            return std::string::npos;
+        }
+        value = variables::get_element(name, index);
+    } else {
+        value = variables::get(name);
+    }
+    current += length ? std::to_string(value.size()) : value;
+    return close;
+}
+
+// Matches `op` followed by a descriptor number, as in >&2, storing the
+// number in fd.
+bool match_dup(const std::string& token, const char* op, int& fd) {
+    size_t len = std::strlen(op);
+    if (token.size() <= len || token.size() > len + 9 || token.compare(0, len, op) != 0) {
+        return false;
+    }
+    int n = 0;
+    for (size_t i = len; i < token.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(token[i]))) return false;
+        n = n * 10 + (token[i] - '0');
+    }
+    fd = n;
+    return true;
+}
+
+// Length of the redirection operator a word starts with: the whole word
+// for > >> 1> 1>> 2> 2>> < 0<, the >& part of >&N and the like, or 0.
+size_t redirection_length(const std::string& word) {
+    static const char* const file_ops[] = {">", ">>", "1>", "1>>", "2>", "2>>", "<", "0<"};
+    static const char* const dup_ops[] = {">&", "1>&", "2>&", "<&", "0<&"};
+    for (const char* op : file_ops) {
+        if (word == op) return word.size();
+    }
+    int fd;
+    for (const char* op : dup_ops) {
+        if (match_dup(word, op, fd)) return std::strlen(op);
+    }
+    return 0;
+}
+
+// --- Brace expansion ---
+
+// Words one brace expansion may produce. Past this the line is refused
+// instead of exhausting memory over a typo like {1..1000000000}.
+constexpr size_t MAX_BRACE_WORDS = size_t(1) << 24;
+
+// One {...} of a word. A sequence is produced a word at a time as the
+// combinations are written out; a list holds its (expanded) alternatives.
+struct BraceGroup {
+    std::vector<std::string> words;  // a list's alternatives
+    bool sequence = false;
+    bool letters = false;            // {a..e} rather than {1..5}
+    int64_t first = 0;
+    int64_t step = 1;                // negative when counting down
+    size_t count = 0;                // words produced
+    size_t width = 0;                // zero-padded width, 0 for none
+};
+
+// A word split around its brace groups: texts[i] precedes groups[i],
+// and texts.back() follows the last group.
+struct BracePattern {
+    std::vector<std::string> texts;
+    std::vector<BraceGroup> groups;
+};
+
+bool expand_braces(const std::string& word, const std::vector<size_t>& marks,
+                   bool keep_empty, std::vector<std::string>& out);
+
+// Parses an integer end point or step of {x..y..step}. At most 18 digits,
+// so no difference between two of them can overflow. `padded` is set
+// for a leading zero, as in {01..10}.
+bool parse_sequence_number(const std::string& text, int64_t& value, bool& padded) {
+    size_t digits = !text.empty() && text[0] == '-' ? 1 : 0;
+    if (text.size() == digits || text.size() - digits > 18) return false;
+    for (size_t i = digits; i < text.size(); ++i) {
+        if (!std::isdigit(static_cast<unsigned char>(text[i]))) return false;
+    }
+    value = std::stoll(text);
+    padded = text.size() - digits > 1 && text[digits] == '0';
+    return true;
+}
+
+// Recognises x..y[..step] between integers or between single letters.
+bool parse_sequence(const std::string& text, BraceGroup& group) {
+    size_t dots = text.find("..");
+    if (dots == std::string::npos || dots == 0) return false;
+    size_t dots2 = text.find("..", dots + 2);
+    std::string from = text.substr(0, dots);
+    std::string to = dots2 == std::string::npos ? text.substr(dots + 2)
+                                                : text.substr(dots + 2, dots2 - dots - 2);
+
+    int64_t step = 1;
+    bool padded_from = false, padded_to = false;
+    if (dots2 != std::string::npos) {
+        if (!parse_sequence_number(text.substr(dots2 + 2), step, padded_from)) return false;
+        if (step < 0) step = -step;
+        if (step == 0) step = 1;
+        padded_from = false;
+    }
+
+    int64_t last;
+    if (from.size() == 1 && to.size() == 1 &&
+        std::isalpha(static_cast<unsigned char>(from[0])) &&
+        std::isalpha(static_cast<unsigned char>(to[0]))) {
+        group.letters = true;
+        group.first = from[0];
+        last = to[0];
+    } else if (!parse_sequence_number(from, group.first, padded_from) ||
+               !parse_sequence_number(to, last, padded_to)) {
+        return false;
+    }
+
+    uint64_t span = last >= group.first ? static_cast<uint64_t>(last - group.first)
+                                        : static_cast<uint64_t>(group.first - last);
+    group.sequence = true;
+    group.step = last >= group.first ? step : -step;
+    group.count = static_cast<size_t>(span / static_cast<uint64_t>(step)) + 1;
+    if (padded_from || padded_to) group.width = std::max(from.size(), to.size());
+    return true;
+}
+
+// Appends the k-th word of a sequence.
+void append_sequence_word(const BraceGroup& group, size_t k, std::string& buf) {
+    int64_t value = group.first + static_cast<int64_t>(k) * group.step;
+    if (group.letters) {
+        buf += static_cast<char>(value);
+        return;
+    }
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value)
+                                   : static_cast<uint64_t>(value);
+    char digits[24];
+    size_t len = static_cast<size_t>(
+        std::to_chars(digits, digits + sizeof(digits), magnitude).ptr - digits);
+    size_t sign = value < 0 ? 1 : 0;
+    if (sign) buf += '-';
+    if (group.width > len + sign) buf.append(group.width - len - sign, '0');
+    buf.append(digits, len);
+}
+
+// Splits a word into literal text and brace groups. `marks` are the
+// offsets of the word's unquoted '{', ',' and '}', the only ones that
+// count. A '{' without a matching '}', or whose braces hold neither a
+// ',' nor a sequence, stays literal.
+bool parse_braces(const std::string& word, const std::vector<size_t>& marks,
+                  BracePattern& pattern) {
+    size_t literal = 0;
+    for (size_t m = 0; m < marks.size(); ++m) {
+        size_t open = marks[m];
+        if (word[open] != '{') continue;
+
+        std::vector<size_t> commas;
+        size_t close_mark = 0;
+        int depth = 0;
+        for (size_t k = m + 1; k < marks.size() && close_mark == 0; ++k) {
+            char c = word[marks[k]];
+            if (c == '{') {
+                ++depth;
+            } else if (c == '}' && depth-- == 0) {
+                close_mark = k;
+            } else if (c == ',' && depth == 0) {
+                commas.push_back(marks[k]);
+            }
+        }
+        if (close_mark == 0) continue;
+        size_t close = marks[close_mark];
+
+        BraceGroup group;
+        if (commas.empty()) {
+            if (close_mark != m + 1 ||
+                !parse_sequence(word.substr(open + 1, close - open - 1), group)) {
+                continue;
+            }
+        } else {
+            // Each alternative is expanded in turn, with the marks inside it.
+            commas.push_back(close);
+            size_t start = open + 1;
+            size_t k = m + 1;
+            for (size_t end : commas) {
+                std::vector<size_t> inner;
+                for (; marks[k] < end; ++k) inner.push_back(marks[k] - start);
+                ++k;
+                if (!expand_braces(word.substr(start, end - start), inner, true, group.words)) {
+                    return false;
+                }
+                start = end + 1;
+            }
+            group.count = group.words.size();
+        }
+
+        pattern.texts.push_back(word.substr(literal, open - literal));
+        pattern.groups.push_back(std::move(group));
+        literal = close + 1;
+        m = close_mark;
+    }
+    pattern.texts.push_back(word.substr(literal));
+    return true;
+}
+
+// Appends every combination of the groups from `g` on. Each word is
+// built once in `buf`, which keeps the prefix it shares with the last.
+void emit_braces(const BracePattern& pattern, size_t g, std::string& buf, bool keep_empty,
+                 std::vector<std::string>& out) {
+    if (g == pattern.groups.size()) {
+        if (keep_empty || !buf.empty()) out.push_back(buf);
+        return;
+    }
+    const BraceGroup& group = pattern.groups[g];
+    size_t mark = buf.size();
+    for (size_t k = 0; k < group.count; ++k) {
+        buf.resize(mark);
+        if (group.sequence) {
+            append_sequence_word(group, k, buf);
+        } else {
+            buf += group.words[k];
+        }
+        buf += pattern.texts[g + 1];
+        emit_braces(pattern, g + 1, buf, keep_empty, out);
+    }
+    buf.resize(mark);
+}
+
+// Brace-expands one word into `out`. Unquoted empty results are dropped
+// unless keep_empty is set, as for the alternatives of {a,}. Returns
+// false if the expansion is too large.
+bool expand_braces(const std::string& word, const std::vector<size_t>& marks,
+                   bool keep_empty, std::vector<std::string>& out) {
+    BracePattern pattern;
+    if (!parse_braces(word, marks, pattern)) return false;
+
+    size_t total = 1;
+    for (const auto& group : pattern.groups) {
+        if (group.count > MAX_BRACE_WORDS || total * group.count > MAX_BRACE_WORDS) {
+            std::cerr << "shell: " << word << ": brace expansion too large\n";
+            return false;
+        }
+        total *= group.count;
+    }
+
+    out.reserve(out.size() + total);
+    std::string buf = pattern.texts[0];
+    emit_braces(pattern, 0, buf, keep_empty, out);
+    return true;
+}
+
+// What tokenize() returns once it has reported an error.
+Tokens failed() {
+    Tokens tokens;
+    tokens.error = true;
+    return tokens;
+}
+
+} // namespace
+
+bool has_expansions(const std::string& input) {
+    bool double_quoted = false;
+    for (size_t i = 0; i < input.size(); ++i) {
+        char c = input[i];
+        if (c == '\\') {
+            ++i;
+        } else if (c == '"') {
+            double_quoted = !double_quoted;
+        } else if (c == '\'' && !double_quoted) {
+            size_t close = input.find('\'', i + 1);
+            if (close == std::string::npos) return false;
+            i = close;
+        } else if (c == '$') {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> split_commands(const std::string& input) {
+    std::vector<std::string> commands;
+    size_t start = 0;
+    int depth = 0;  // inside $(( )), <( ) or ${ }
+    char quote = '\0';
+
+    auto add = [&](size_t end) {
+        std::string command = input.substr(start, end - start);
+        if (command.find_first_not_of(" \t") != std::string::npos) {
+            commands.push_back(std::move(command));
+        }
+        start = end + 1;
+    };
+
+    for (size_t i = 0; i < input.size(); ++i) {
+        char c = input[i];
+        if (quote) {
+            if (c == quote) {
+                quote = '\0';
+            } else if (c == '\\' && quote == '"' && i + 1 < input.size()) {
+                ++i;
+            }
+        } else if (c == '\'' || c == '"') {
+            quote = c;
+        } else if (c == '\\' && i + 1 < input.size()) {
+            ++i;
+        } else if (c == '(' || (c == '{' && i > 0 && input[i - 1] == '$')) {
+            ++depth;
+        } else if ((c == ')' || c == '}') && depth > 0) {
+            --depth;
+        } else if (c == ';' && depth == 0) {
+            add(i);
+        }
+    }
+    add(input.size());
+    return commands;
+}
+
+Tokens tokenize(const std::string& input) {
+    stats::Timer timer(stats::Latency::PARSE);
     std::vector<std::string> tokens;
+    std::vector<unsigned> flags;  // filled up to the last flagged token
     std::string current;
 
     enum class State { NORMAL, SINGLE_QUOTE, DOUBLE_QUOTE };
     State state = State::NORMAL;
+    bool word = false;         // a word has begun, even if still empty ("")
+    bool conditional = false;  // between [[ and ]]
+    std::vector<size_t> braces;  // offsets of the current word's unquoted { , }
+    size_t literal = 0;          // leading characters of the word typed unquoted
+    bool assigning = true;       // only NAME=value words so far in this command
+
+    // Flags the token just pushed.
+    auto flag_last = [&](unsigned flag) {
+        flags.resize(tokens.size(), PLAIN);
+        flags.back() = flag;
+    };
+
+    // Ends the current word; false if its brace expansion failed.
+    auto flush = [&]() {
+        bool ok = true;
+        if (!current.empty() || word) {
+            bool operands = conditional;  // [[ < ]] compares
+            if (conditional && current == "]]") conditional = false;
+            // NAME=value in front of a command is not brace-expanded, and
+            // a redirection must still name a single file.
+            size_t eq = current.find('=');
+            bool assignment = assigning && eq < literal && variables::is_assignment(current);
+            assigning = assignment;
+            bool target = flags.size() == tokens.size() && !flags.empty() &&
+                          (flags.back() & OPERATOR) && tokens.back() != "|" &&
+                          redirection_length(tokens.back()) == tokens.back().size();
+            if (braces.empty() || assignment) {
+                tokens.push_back(current);
+                size_t op = operands ? 0 : redirection_length(current);
+                if (op > 0 && op <= literal) flag_last(OPERATOR);
+            } else if (target) {
+                std::vector<std::string> files;
+                ok = expand_braces(current, braces, false, files);
+                if (ok && files.size() != 1) {
+                    std::cerr << "shell: " << current << ": ambiguous redirect\n";
+                    ok = false;
+                }
+                if (ok) tokens.push_back(files[0]);
+            } else {
+                ok = expand_braces(current, braces, false, tokens);
+            }
+            current.clear();
+            braces.clear();
+        }
+        word = false;
+        literal = 0;
+        return ok;
+    };
 
     for (size_t i = 0; i < input.size(); ++i) {
         char c = input[i];
+        bool command_start = current.empty() && !word &&
+                             (tokens.empty() || tokens.back() == "|");
 
         switch (state) {
         case State::NORMAL:
             if (std::isspace(c)) {
-                if (!current.empty()) {
-                    tokens.push_back(current);
-                    current.clear();
+                if (!flush()) return failed();
+            } else if (c == '[' && command_start && input.compare(i, 2, "[[") == 0 &&
+                       (i + 2 == input.size() || std::isspace(input[i + 2]))) {
+                // [[ expr ]]: up to the closing ]], < > and | are operands
+                // of the condition rather than redirections and pipes.
+                tokens.push_back("[[");
+                conditional = true;
+                ++i;
+            } else if (c == '(' && command_start && input.compare(i, 2, "((") == 0) {
+                // (( expr )) command: the expression is one word, so its
+                // operators are never taken for pipes or redirections.
+                size_t close = find_double_paren(input, i);
+                std::string expr;
+                if (close == std::string::npos) {
+                    std::cerr << "shell: unmatched parenthesis\n";
+                    return failed();
                 }
-            } else if (c == '|') {
-                if (!current.empty()) {
-                    tokens.push_back(current);
-                    current.clear();
+                if (!expand_arithmetic_text(input.substr(i + 2, close - i - 3), expr)) {
+                    return failed();
                 }
+                tokens.insert(tokens.end(), {"((", expr, "))"});
+                i = close;
+            } else if (c == '|' && conditional && current != "]]") {
+                current += c;
+            } else if (c == '|') {
+                if (!flush()) return failed();
                 tokens.push_back("|");
+                flag_last(OPERATOR);
+                assigning = true;
+            } else if ((c == '<' || c == '>') && current.empty() && !conditional &&
+                       i + 1 < input.size() && input[i + 1] == '(') {
+                // Process substitution: keep the inner command verbatim so
+                // the executor can run it through the normal pipeline path.
+                size_t close = find_closing_paren(input, i + 1);
+                if (close == std::string::npos) {
+                    std::cerr << "shell: unmatched parenthesis\n";
+                    return failed();
+                }
+                tokens.push_back(input.substr(i, close - i + 1));
+                flag_last(SUBSTITUTION);
+                i = close;
             } else if (c == '\'') {
                 state = State::SINGLE_QUOTE;
+                word = true;
             } else if (c == '"') {
                 state = State::DOUBLE_QUOTE;
+                word = true;
             } else if (c == '\\' && i + 1 < input.size()) {
-                current += input[++i];
+                append_quoted(current, input[++i], conditional);
+            } else if (c == '$') {
+                size_t words = tokens.size();
+                i = expand_parameter(input, i, current, tokens);
+                if (i == std::string::npos) return failed();
+                // ${a[@]} ended the word the marks belong to
+                if (tokens.size() != words) braces.clear();
+                // [[ $empty == x ]] still has a left operand
+                word = word || conditional;
             } else {
+                // Only braces typed unquoted expand; those that come from
+                // quotes or expansions are plain text.
+                if (!conditional && (c == '{' || (!braces.empty() && (c == ',' || c == '}')))) {
+                    braces.push_back(current.size());
+                }
+                if (literal == current.size()) ++literal;
                 current += c;
             }
             break;
@@ -43,7 +646,7 @@ std::vector<std::string> tokenize(const std::string& input) {
             if (c == '\'') {
                 state = State::NORMAL;
             } else {
-                current += c;
+                append_quoted(current, c, conditional);
             }
             break;
 
@@ -53,13 +656,24 @@ std::vector<std::string> tokenize(const std::string& input) {
             } else if (c == '\\' && i + 1 < input.size()) {
                 char n = input[i + 1];
                 if (n == '"' || n == '\\' || n == '$' || n == '`' || n == '\n') {
-                    current += n;
+                    append_quoted(current, n, conditional);
                     ++i;
                 } else {
-                    current += c;
+                    append_quoted(current, c, conditional);
+                }
+            } else if (c == '$') {
+                size_t mark = current.size();
+                size_t words = tokens.size();
+                i = expand_parameter(input, i, current, tokens);
+                if (i == std::string::npos) return failed();
+                if (tokens.size() != words) braces.clear();
+                if (conditional && current.size() > mark) {
+                    std::string value = current.substr(mark);
+                    current.resize(mark);
+                    for (char v : value) append_quoted(current, v, true);
                 }
             } else {
-                current += c;
+                append_quoted(current, c, conditional);
             }
             break;
         }
@@ -67,30 +681,33 @@ std::vector<std::string> tokenize(const std::string& input) {
 
     if (state != State::NORMAL) {
         std::cerr << "shell: unmatched quote\n";
-        return {};
+        return failed();
     }
 
-    if (!current.empty()) {
-        tokens.push_back(current);
+    if (!flush()) return failed();
+    if (conditional) {
+        std::cerr << "shell: missing `]]'\n";
+        return failed();
     }
 
-    return tokens;
+    flags.resize(tokens.size(), PLAIN);
+    return {std::move(tokens), std::move(flags)};
 }
 
-std::vector<std::vector<std::string>> split_pipeline(
-        const std::vector<std::string>& tokens) {
-    std::vector<std::vector<std::string>> commands;
-    std::vector<std::string> current;
+std::vector<Tokens> split_pipeline(const Tokens& tokens) {
+    std::vector<Tokens> commands;
+    Tokens current;
 
-    for (const auto& token : tokens) {
-        if (token == "|") {
+    for (size_t i = 0; i < tokens.words.size(); ++i) {
+        if (tokens.words[i] == "|" && (tokens.flags[i] & OPERATOR)) {
             if (current.empty()) {
                 return {};
             }
-            commands.push_back(current);
-            current.clear();
+            commands.push_back(std::move(current));
+            current = {};
         } else {
-            current.push_back(token);
+            current.words.push_back(tokens.words[i]);
+            current.flags.push_back(tokens.flags[i]);
         }
     }
 
@@ -98,35 +715,79 @@ std::vector<std::vector<std::string>> split_pipeline(
         return {};
     }
     
-    commands.push_back(current);
+    commands.push_back(std::move(current));
     return commands;
 }
 
-Redirections extract_redirections(std::vector<std::string>& args) {
+Redirections extract_redirections(Tokens& command) {
     Redirections redir;
-    std::vector<std::string> clean;
+    Tokens clean;
+    const auto& args = command.words;
 
     for (size_t i = 0; i < args.size(); ++i) {
         const std::string& token = args[i];
+        bool op = command.flags[i] & OPERATOR;
+        int fd;
         
-        if ((token == ">" || token == "1>") && i + 1 < args.size()) {
+        if (op && (token == ">" || token == "1>") && i + 1 < args.size()) {
             redir.stdout_file = args[++i];
-        } else if ((token == ">>" || token == "1>>") && i + 1 < args.size()) {
+            redir.stdout_append = false;
+            redir.stdout_fd = -1;
+        } else if (op && (token == ">>" || token == "1>>") && i + 1 < args.size()) {
             redir.stdout_file = args[++i];
             redir.stdout_append = true;
-        } else if (token == "2>" && i + 1 < args.size()) {
+            redir.stdout_fd = -1;
+        } else if (op && token == "2>" && i + 1 < args.size()) {
             redir.stderr_file = args[++i];
-        } else if (token == "2>>" && i + 1 < args.size()) {
+            redir.stderr_append = false;
+            redir.stderr_fd = -1;
+        } else if (op && token == "2>>" && i + 1 < args.size()) {
             redir.stderr_file = args[++i];
             redir.stderr_append = true;
+            redir.stderr_fd = -1;
+        } else if (op && (token == "<" || token == "0<") && i + 1 < args.size()) {
+            redir.stdin_file = args[++i];
+            redir.stdin_fd = -1;
+        } else if (op && (match_dup(token, ">&", fd) || match_dup(token, "1>&", fd))) {
+            redir.stdout_file.clear();
+            redir.stdout_fd = fd;
+        } else if (op && match_dup(token, "2>&", fd)) {
+            redir.stderr_file.clear();
+            redir.stderr_fd = fd;
+        } else if (op && (match_dup(token, "<&", fd) || match_dup(token, "0<&", fd))) {
+            redir.stdin_file.clear();
+            redir.stdin_fd = fd;
         } else {
-            clean.push_back(token);
+            clean.words.push_back(token);
+            clean.flags.push_back(command.flags[i]);
         }
     }
 
-    args = std::move(clean);
+    command = std::move(clean);
     return redir;
 }
 
+void extract_input_redirection(Tokens& command, Redirections& redir) {
+    Tokens clean;
+    const auto& args = command.words;
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        bool op = command.flags[i] & OPERATOR;
+        int fd;
+        if (op && (args[i] == "<" || args[i] == "0<") && i + 1 < args.size()) {
+            redir.stdin_file = args[++i];
+            redir.stdin_fd = -1;
+        } else if (op && (match_dup(args[i], "<&", fd) || match_dup(args[i], "0<&", fd))) {
+            redir.stdin_file.clear();
+            redir.stdin_fd = fd;
+        } else {
+            clean.words.push_back(args[i]);
+            clean.flags.push_back(command.flags[i]);
+        }
+    }
+
+    command = std::move(clean);
+}
+
 } // namespace parser
 } // namespace shell
\ No newline at end of file
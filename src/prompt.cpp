@@ -0,0 +1,332 @@
+#include "prompt.hpp"
+#include "executor.hpp"
+#include "fdtable.hpp"
+#include "lineedit.hpp"
+#include "variables.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <spawn.h>
+#include <poll.h>
+#include <pwd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace shell {
+namespace prompt {
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr auto DEFAULT_TIMEOUT = std::chrono::milliseconds(2000);
+    // Segments finishing this soon after the prompt is requested make it
+    // into the first paint, which avoids a flicker for cheap commands.
+    constexpr auto FIRST_PAINT_WAIT = std::chrono::milliseconds(10);
+    // How often the editor polls for segment output while one is running.
+    constexpr auto IDLE_POLL = std::chrono::milliseconds(20);
+    constexpr size_t CACHE_LIMIT = 64;
+    const char* const PLACEHOLDER = "…";
+
+    struct Segment {
+        std::string command;                          // what `values` came from
+        std::map<std::string, std::string> values;   // cwd -> last output
+        pid_t pid = -1;                               // running refresh, if any
+        int fd = -1;                                  // its stdout
+        std::string cwd;                              // directory it runs in
+        std::string output;
+        Clock::time_point started;
+    };
+
+    std::map<std::string, Segment> segments;
+    std::vector<pid_t> exited;  // segment processes left to reap
+    Clock::duration last_duration{};
+
+    std::string current_dir() {
+        char buf[PATH_MAX];
+        return getcwd(buf, sizeof(buf)) ? buf : "";
+    }
+
+    const std::string& user_name() {
+        static const std::string name = [] {
+            if (const char* user = getenv("USER")) return std::string(user);
+            const passwd* pw = getpwuid(geteuid());
+            return std::string(pw ? pw->pw_name : "");
+        }();
+        return name;
+    }
+
+    const std::string& host_name() {
+        static const std::string name = [] {
+            char buf[256] = {};
+            gethostname(buf, sizeof(buf) - 1);
+            return std::string(buf);
+        }();
+        return name;
+    }
+
+    std::string format_duration(Clock::duration d) {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(d).count();
+        if (ms < 1000) return std::to_string(ms) + "ms";
+        if (ms < 60000) {
+            return std::to_string(ms / 1000) + "." + std::to_string(ms % 1000 / 100) + "s";
+        }
+        auto s = ms / 1000;
+        return std::to_string(s / 60) + "m" + std::to_string(s % 60) + "s";
+    }
+
+    std::chrono::milliseconds segment_timeout() {
+        std::string value = variables::get("PROMPT_SEGMENT_TIMEOUT");
+        if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+            return DEFAULT_TIMEOUT;
+        }
+        return std::chrono::milliseconds(std::strtoll(value.c_str(), nullptr, 10));
+    }
+
+    // First line of a segment's output, without surrounding whitespace.
+    std::string first_line(const std::string& output) {
+        size_t end = output.find('\n');
+        std::string line = output.substr(0, end);
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) return "";
+        return line.substr(first, line.find_last_not_of(" \t\r") - first + 1);
+    }
+
+    // Expands PS1. Segment names met along the way go to `wanted`.
+    std::string expand(const std::string& ps1, const std::string& cwd,
+                       std::vector<std::string>* wanted) {
+        std::string out;
+        for (size_t i = 0; i < ps1.size(); ++i) {
+            if (ps1[i] != '\\' || i + 1 == ps1.size()) {
+                out += ps1[i];
+                continue;
+            }
+
+            char c = ps1[++i];
+            switch (c) {
+                case 'w': {
+                    const char* home = getenv("HOME");
+                    size_t len = home ? std::strlen(home) : 0;
+                    if (len > 1 && cwd.compare(0, len, home) == 0 &&
+                        (cwd.size() == len || cwd[len] == '/')) {
+                        out += "~" + cwd.substr(len);
+                    } else {
+                        out += cwd;
+                    }
+                    break;
+                }
+                case 'W': {
+                    size_t slash = cwd.find_last_of('/');
+                    out += cwd.size() > 1 && slash != std::string::npos
+                               ? cwd.substr(slash + 1) : cwd;
+                    break;
+                }
+                case 'u': out += user_name(); break;
+                case 'h': out += host_name().substr(0, host_name().find('.')); break;
+                case 'H': out += host_name(); break;
+                case '$': out += geteuid() == 0 ? '#' : '$'; break;
+                case '?': out += std::to_string(executor::last_status()); break;
+                case 'C': out += format_duration(last_duration); break;
+                case 'j': out += std::to_string(executor::reap_coprocesses()); break;
+                case 'n': out += '\n'; break;
+                case 'e': out += '\033'; break;
+                case 'a': out += '\a'; break;
+                case '[': out += lineedit::PROMPT_START_IGNORE; break;
+                case ']': out += lineedit::PROMPT_END_IGNORE; break;
+                case '\\': out += '\\'; break;
+                case '{': {
+                    size_t close = ps1.find('}', i);
+                    if (close == std::string::npos) {
+                        out += "\\{";
+                        break;
+                    }
+                    std::string name = ps1.substr(i + 1, close - i - 1);
+                    i = close;
+                    auto it = segments.find(name);
+                    if (wanted) wanted->push_back(name);
+                    if (it == segments.end()) {
+                        out += PLACEHOLDER;
+                        break;
+                    }
+                    auto value = it->second.values.find(cwd);
+                    out += value != it->second.values.end() ? value->second : PLACEHOLDER;
+                    break;
+                }
+                default:
+                    out += '\\';
+                    out += c;
+            }
+        }
+        return out;
+    }
+
+    std::string render(std::vector<std::string>* wanted) {
+        std::string ps1 = variables::is_set("PS1") ? variables::get("PS1") : "$ ";
+        return expand(ps1, current_dir(), wanted);
+    }
+
+    // Starts `sh -c command` in its own process group, stdout on a pipe.
+    void spawn(Segment& seg, const std::string& cwd) {
+        int p[2];
+        if (!fdtable::make_pipe(p, "prompt segment")) return;
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions, p[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&attr, 0);
+
+        char sh[] = "sh";
+        char dash_c[] = "-c";
+        char* argv[] = {sh, dash_c, const_cast<char*>(seg.command.c_str()), nullptr};
+        pid_t pid;
+        int err = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ);
+
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+        fdtable::release(p[1]);
+        if (err != 0) {
+            fdtable::release(p[0]);
+            return;
+        }
+
+        fcntl(p[0], F_SETFL, fcntl(p[0], F_GETFL) | O_NONBLOCK);
+        seg.pid = pid;
+        seg.fd = p[0];
+        seg.cwd = cwd;
+        seg.output.clear();
+        seg.started = Clock::now();
+    }
+
+    // Stores a finished segment's output. Returns true if it changed.
+    bool finish(Segment& seg, bool timed_out) {
+        fdtable::release(seg.fd);
+        seg.fd = -1;
+        if (timed_out) kill(-seg.pid, SIGKILL);
+        exited.push_back(seg.pid);
+        seg.pid = -1;
+
+        if (seg.values.size() >= CACHE_LIMIT) seg.values.clear();
+        auto it = seg.values.find(seg.cwd);
+        if (timed_out) {
+            if (it != seg.values.end()) return false;
+            seg.values[seg.cwd] = "";  // drop the placeholder, keep trying next time
+            return true;
+        }
+        std::string value = first_line(seg.output);
+        if (it != seg.values.end() && it->second == value) return false;
+        seg.values[seg.cwd] = value;
+        return true;
+    }
+
+    // Collects output from running segments. Returns true if any value changed.
+    bool poll_segments() {
+        bool changed = false;
+        auto timeout = segment_timeout();
+        for (auto& [name, seg] : segments) {
+            if (seg.pid < 0) continue;
+
+            char buf[4096];
+            ssize_t n;
+            while ((n = read(seg.fd, buf, sizeof(buf))) > 0) {
+                seg.output.append(buf, static_cast<size_t>(n));
+            }
+            if (n == 0) {
+                changed |= finish(seg, false);
+            } else if (Clock::now() - seg.started > timeout) {
+                changed |= finish(seg, true);
+            }
+        }
+
+        for (size_t i = 0; i < exited.size();) {
+            if (waitpid(exited[i], nullptr, WNOHANG) != 0) {
+                exited[i] = exited.back();
+                exited.pop_back();
+            } else {
+                ++i;
+            }
+        }
+        return changed;
+    }
+
+    bool any_running() {
+        for (const auto& entry : segments) {
+            if (entry.second.pid >= 0) return true;
+        }
+        return false;
+    }
+
+    // The editor's idle hook while segments run: redraw when one finishes.
+    bool on_idle(std::string& prompt) {
+        bool changed = poll_segments();
+        if (changed) {
+            prompt = render(nullptr);
+        }
+        if (!any_running()) {
+            lineedit::set_idle_hook(nullptr);
+        }
+        return changed;
+    }
+
+    // Waits up to FIRST_PAINT_WAIT for running segments to finish.
+    void wait_briefly() {
+        auto deadline = Clock::now() + FIRST_PAINT_WAIT;
+        for (;;) {
+            std::vector<pollfd> fds;
+            for (const auto& entry : segments) {
+                if (entry.second.pid >= 0) fds.push_back({entry.second.fd, POLLIN, 0});
+            }
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                deadline - Clock::now()).count();
+            if (fds.empty() || left <= 0) return;
+            if (poll(fds.data(), fds.size(), static_cast<int>(left)) <= 0) return;
+            poll_segments();
+        }
+    }
+}
+
+std::string begin() {
+    poll_segments();
+
+    std::vector<std::string> wanted;
+    render(&wanted);
+    if (wanted.empty()) return render(nullptr);
+
+    std::string cwd = current_dir();
+    for (const auto& name : wanted) {
+        Segment& seg = segments[name];
+        std::string command = variables::get("PROMPT_SEGMENT_" + name);
+        if (command != seg.command) {
+            seg.command = command;
+            seg.values.clear();
+        }
+        if (command.empty()) {
+            seg.values[cwd] = "";
+        } else if (seg.pid < 0) {
+            spawn(seg, cwd);
+        }
+    }
+
+    wait_briefly();
+    if (any_running()) {
+        lineedit::set_idle_hook(on_idle, IDLE_POLL);
+    }
+    return render(nullptr);
+}
+
+void command_finished(std::chrono::steady_clock::duration elapsed) {
+    last_duration = elapsed;
+}
+
+} // namespace prompt
+} // namespace shell
@@ -0,0 +1,214 @@
+#include "protocol.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#ifndef MSG_CMSG_CLOEXEC
+#define MSG_CMSG_CLOEXEC 0
+#endif
+
+namespace shell {
+namespace protocol {
+
+namespace {
+
+// Every frame starts with this header; `length` counts the body bytes.
+struct Header {
+    uint32_t magic;
+    uint32_t type;
+    uint32_t length;
+};
+
+enum FrameType : uint32_t { REQUEST = 1, RESPONSE = 2 };
+
+template <typename T>
+void put(std::string& buf, T value) {
+    buf.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void put_str(std::string& buf, const std::string& s) {
+    put(buf, static_cast<uint32_t>(s.size()));
+    buf.append(s);
+}
+
+template <typename T>
+bool get(const std::string& buf, size_t& pos, T& value) {
+    if (buf.size() - pos < sizeof(value)) return false;
+    std::memcpy(&value, buf.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+bool get_str(const std::string& buf, size_t& pos, std::string& s) {
+    uint32_t len;
+    if (!get(buf, pos, len) || buf.size() - pos < len) return false;
+    s.assign(buf, pos, len);
+    pos += len;
+    return true;
+}
+
+bool write_all(int sock, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool read_all(int sock, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(sock, data, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Sends header + body in one sendmsg(), attaching `fds` (if any) to the
+// first byte, then finishes any short write.
+bool send_frame(int sock, FrameType type, const std::string& body,
+                const int* fds, size_t nfds) {
+    std::string frame;
+    Header h{MAGIC, type, static_cast<uint32_t>(body.size())};
+    put(frame, h);
+    frame += body;
+
+    iovec iov{const_cast<char*>(frame.data()), frame.size()};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))];
+    if (nfds > 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+        std::memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+    }
+
+    ssize_t n;
+    do {
+        n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) return false;
+
+    auto sent = static_cast<size_t>(n);
+    return write_all(sock, frame.data() + sent, frame.size() - sent);
+}
+
+// Receives a frame of the expected type. Descriptors attached to it are
+// stored in `fds` (close-on-exec); unexpected extras are closed.
+bool recv_frame(int sock, FrameType type, std::string& body,
+                int* fds, size_t nfds) {
+    Header h;
+    iovec iov{&h, sizeof(h)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))];
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do {
+        n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) return false;
+
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int received[3];
+        std::memcpy(received, CMSG_DATA(cmsg),
+                    std::min(count, size_t{3}) * sizeof(int));
+        for (size_t i = 0; i < std::min(count, size_t{3}); ++i) {
+            if (i < nfds) {
+                fds[i] = received[i];
+            } else {
+                close(received[i]);
+            }
+        }
+    }
+
+    auto got = static_cast<size_t>(n);
+    if (!read_all(sock, reinterpret_cast<char*>(&h) + got, sizeof(h) - got) ||
+        h.magic != MAGIC || h.type != type || h.length > MAX_BODY) {
+        return false;
+    }
+
+    body.resize(h.length);
+    return read_all(sock, &body[0], body.size());
+}
+
+} // namespace
+
+bool send_request(int sock, const Request& req) {
+    std::string body;
+    put_str(body, req.command);
+    put_str(body, req.cwd);
+    put(body, static_cast<uint32_t>(req.env.size()));
+    for (const auto& var : req.env) {
+        put_str(body, var);
+    }
+    return send_frame(sock, REQUEST, body, req.fds, 3);
+}
+
+bool recv_request(int sock, Request& req) {
+    std::string body;
+    if (!recv_frame(sock, REQUEST, body, req.fds, 3)) return false;
+
+    size_t pos = 0;
+    uint32_t count;
+    if (!get_str(body, pos, req.command) || !get_str(body, pos, req.cwd) ||
+        !get(body, pos, count)) {
+        return false;
+    }
+    req.env.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        std::string var;
+        if (!get_str(body, pos, var)) return false;
+        req.env.push_back(std::move(var));
+    }
+    return pos == body.size();
+}
+
+bool send_response(int sock, const Response& resp) {
+    std::string body;
+    put(body, resp.status);
+    put(body, resp.wall_ns);
+    put(body, resp.user_us);
+    put(body, resp.sys_us);
+    return send_frame(sock, RESPONSE, body, nullptr, 0);
+}
+
+bool recv_response(int sock, Response& resp) {
+    std::string body;
+    if (!recv_frame(sock, RESPONSE, body, nullptr, 0)) return false;
+
+    size_t pos = 0;
+    return get(body, pos, resp.status) && get(body, pos, resp.wall_ns) &&
+           get(body, pos, resp.user_us) && get(body, pos, resp.sys_us) &&
+           pos == body.size();
+}
+
+} // namespace protocol
+} // namespace shell
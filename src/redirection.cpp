@@ -1,4 +1,5 @@
 #include "redirection.hpp"
+#include "fdtable.hpp"
 #include <unistd.h>
 #include <fcntl.h>
 #include <cstdio>
@@ -6,18 +7,21 @@
 namespace shell {
 namespace redirection {
 
-int redirect_fd(int fd, const std::string& file, bool append) {
+int redirect_fd(int fd, const std::string& file, bool append, bool input) {
     if (file.empty()) {
         return -1;
     }
     
-    int saved = dup(fd);
-    int flags = O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+    // The saved copy is close-on-exec and out of the user's fd range so
+    // commands spawned while the redirection is active never inherit it.
+    int saved = fdtable::duplicate(fd, "saved fd " + std::to_string(fd));
+    int flags = input ? O_RDONLY | O_CLOEXEC
+                      : O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
     int newfd = open(file.c_str(), flags, 0644);
     
     if (newfd < 0) {
-        perror("open");
-        close(saved);
+        perror(file.c_str());
+        fdtable::release(saved);
         return -1;
     }
     
@@ -26,17 +30,59 @@ int redirect_fd(int fd, const std::string& file, bool append) {
     return saved;
 }
 
+int redirect_dup(int fd, int source) {
+    int saved = fdtable::duplicate(fd, "saved fd " + std::to_string(fd));
+    if (dup2(source, fd) < 0) {
+        perror(std::to_string(source).c_str());
+        fdtable::release(saved);
+        return -1;
+    }
+    return saved;
+}
+
+bool replace_fd(int fd, const std::string& file, bool append, bool input) {
+    if (file.empty()) {
+        return true;
+    }
+    int saved = redirect_fd(fd, file, append, input);
+    if (saved < 0) {
+        return false;
+    }
+    fdtable::release(saved);
+    return true;
+}
+
+bool replace_dup(int fd, int source) {
+    if (source < 0) {
+        return true;
+    }
+    int saved = redirect_dup(fd, source);
+    if (saved < 0) {
+        return false;
+    }
+    fdtable::release(saved);
+    return true;
+}
+
 void restore_fd(int fd, int saved) {
     if (saved >= 0) {
         dup2(saved, fd);
-        close(saved);
+        fdtable::release(saved);
+    }
+}
+
+RedirectGuard::RedirectGuard(int fd, const std::string& file, bool append,
+                             bool input)
+    : fd_(fd), saved_fd_(-1), requested_(!file.empty()) {
+    if (requested_) {
+        saved_fd_ = redirect_fd(fd, file, append, input);
     }
 }
 
-RedirectGuard::RedirectGuard(int fd, const std::string& file, bool append)
-    : fd_(fd), saved_fd_(-1), file_(file) {
-    if (!file.empty()) {
-        saved_fd_ = redirect_fd(fd, file, append);
+RedirectGuard::RedirectGuard(int fd, int source)
+    : fd_(fd), saved_fd_(-1), requested_(source >= 0) {
+    if (requested_) {
+        saved_fd_ = redirect_dup(fd, source);
     }
 }
 
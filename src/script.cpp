@@ -0,0 +1,127 @@
+#include "script.hpp"
+#include "executor.hpp"
+#include "parsecache.hpp"
+#include "parser.hpp"
+#include "startup.hpp"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace shell {
+namespace script {
+
+namespace {
+
+// Tokenizes every command line; returns false if any line fails to parse
+// so that a broken file is never cached. Lines with expansions are kept
+// as text, since their tokens depend on variables set while running.
+bool parse(const std::string& text, parsecache::ParsedScript& out) {
+    std::istringstream in(text);
+    std::string line;
+    bool ok = true;
+
+    while (std::getline(in, line)) {
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line[first] == '#') continue;
+
+        // Each command of a ';' list is stored as its own line.
+        for (auto& command : parser::split_commands(line)) {
+            parsecache::ParsedLine parsed;
+            if (parser::has_expansions(command)) {
+                parsed.dynamic = true;
+                parsed.text = std::move(command);
+            } else {
+                // A line that fails is kept, so that it fails again in
+                // its place when the script runs.
+                parsed.tokens = parser::tokenize(command);
+                if (parsed.tokens.error) ok = false;
+            }
+            out.push_back(std::move(parsed));
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+int source_file(const std::string& path, bool tail) {
+    std::ifstream in(path, std::ios::binary);
+    struct stat sb;
+    if (!in || stat(path.c_str(), &sb) != 0) {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    std::string text((std::istreambuf_iterator<char>(in)),
+                     std::istreambuf_iterator<char>());
+
+    parsecache::FileKey key;
+#ifdef __linux__
+    key.mtime_sec = sb.st_mtim.tv_sec;
+    key.mtime_nsec = sb.st_mtim.tv_nsec;
+#else
+    key.mtime_sec = sb.st_mtime;
+#endif
+    key.size = static_cast<uint64_t>(sb.st_size);
+    key.content_hash = parsecache::hash_content(text);
+
+    // Cache entries are keyed on the canonical path so the same file
+    // reached through different relative paths shares one entry.
+    char resolved[PATH_MAX];
+    std::string canonical = realpath(path.c_str(), resolved) ? resolved : path;
+
+    parsecache::ParsedScript lines;
+    if (!parsecache::load(canonical, key, lines)) {
+        lines.clear();
+        if (parse(text, lines)) {
+            parsecache::store(canonical, key, lines);
+        }
+    }
+
+    for (size_t i = 0; i < lines.size(); ++i) {
+        bool last = tail && i + 1 == lines.size();
+        if (lines[i].dynamic) {
+            executor::execute(lines[i].text, last);
+        } else {
+            executor::execute_tokens(lines[i].tokens, last);
+        }
+    }
+    return 0;
+}
+
+int run_file(const std::string& path) {
+    if (access(path.c_str(), R_OK) != 0) {
+        std::cerr << "shell: " << path << ": " << strerror(errno) << std::endl;
+        return 127;
+    }
+    executor::set_interactive(false);
+    source_file(path, true);
+    return executor::last_status();
+}
+
+int run_command(const std::string& text) {
+    executor::set_interactive(false);
+    executor::execute(text, true);
+    return executor::last_status();
+}
+
+void load_rc() {
+    const char* home = getenv("HOME");
+    if (!home) return;
+
+    std::string rc = std::string(home) + "/.myshellrc";
+    struct stat sb;
+    if (stat(rc.c_str(), &sb) == 0) {
+        startup::Phase phase("rc file");
+        source_file(rc);
+    }
+}
+
+} // namespace script
+} // namespace shell
@@ -0,0 +1,261 @@
+#include "server.hpp"
+#include "audit.hpp"
+#include "executor.hpp"
+#include "fdtable.hpp"
+#include "protocol.hpp"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#endif
+
+namespace shell {
+namespace server {
+
+#ifdef __linux__
+
+namespace {
+
+uint64_t to_us(const timeval& tv) {
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 +
+           static_cast<uint64_t>(tv.tv_usec);
+}
+
+uint64_t cpu_us(const rusage& ru, bool user) {
+    return to_us(user ? ru.ru_utime : ru.ru_stime);
+}
+
+// Replaces the environment wholesale with the client's.
+void apply_env(const std::vector<std::string>& env) {
+    clearenv();
+    for (const auto& var : env) {
+        size_t eq = var.find('=');
+        if (eq == std::string::npos || eq == 0) continue;
+        setenv(var.substr(0, eq).c_str(), var.c_str() + eq + 1, 1);
+    }
+}
+
+// Points stdio at /dev/null so the client's pipes see EOF as soon as its
+// command finishes, not when the connection closes.
+void release_stdio() {
+    int null = open("/dev/null", O_RDWR | O_CLOEXEC);
+    if (null < 0) return;
+    for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; ++fd) {
+        dup2(null, fd);
+    }
+    close(null);
+}
+
+// The request a worker is running, so that `exit` can still answer it.
+struct Current {
+    int conn = -1;
+    std::chrono::steady_clock::time_point start;
+    rusage self_before;
+    rusage kids_before;
+} current;
+
+// Builds the response to the current request and detaches its stdio.
+protocol::Response finish_request(int status) {
+    rusage self_after, kids_after;
+    getrusage(RUSAGE_SELF, &self_after);
+    getrusage(RUSAGE_CHILDREN, &kids_after);
+    release_stdio();
+
+    const rusage& self_before = current.self_before;
+    const rusage& kids_before = current.kids_before;
+    protocol::Response resp;
+    resp.status = status;
+    resp.wall_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - current.start).count());
+    resp.user_us = cpu_us(self_after, true) - cpu_us(self_before, true) +
+                   cpu_us(kids_after, true) - cpu_us(kids_before, true);
+    resp.sys_us = cpu_us(self_after, false) - cpu_us(self_before, false) +
+                  cpu_us(kids_after, false) - cpu_us(kids_before, false);
+    return resp;
+}
+
+// `exit` in a request: answer it with the status, then end the worker,
+// which closes the connection.
+void exit_worker(int status) {
+    protocol::send_response(current.conn, finish_request(status));
+    close(current.conn);
+    audit::shutdown();
+    _exit(status);
+}
+
+// Worker side: serves requests on one connection until the client hangs up.
+void handle_connection(int conn) {
+    protocol::Request req;
+    current.conn = conn;
+    executor::set_exit_handler(exit_worker);
+    executor::set_keep_process(true);
+    while (protocol::recv_request(conn, req)) {
+        current.start = std::chrono::steady_clock::now();
+        getrusage(RUSAGE_SELF, &current.self_before);
+        getrusage(RUSAGE_CHILDREN, &current.kids_before);
+
+        for (int fd = STDIN_FILENO; fd <= STDERR_FILENO; ++fd) {
+            if (req.fds[fd] >= 0) {
+                dup2(req.fds[fd], fd);
+                close(req.fds[fd]);
+                req.fds[fd] = -1;
+            }
+        }
+        apply_env(req.env);
+
+        int status;
+        if (chdir(req.cwd.c_str()) != 0) {
+            std::cerr << "cd: " << req.cwd << ": " << strerror(errno) << std::endl;
+            status = 1;
+        } else {
+            executor::execute(req.command);
+            status = executor::last_status();
+        }
+
+        if (!protocol::send_response(conn, finish_request(status))) break;
+    }
+
+    for (int fd : req.fds) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+} // namespace
+
+int serve(const std::string& socket_path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "shell: " << socket_path << ": socket path too long\n";
+        return 1;
+    }
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    // Requests carry the client's environment, so the audit log is
+    // configured from the server's before a worker replaces it.
+    audit::enabled();
+
+    // SIGCHLD (worker exits) and termination requests arrive through a
+    // signalfd so the epoll loop handles everything in one place.
+    sigset_t mask, old_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, &old_mask);
+
+    int sig_fd = fdtable::adopt(signalfd(-1, &mask, SFD_NONBLOCK),
+                                "server signals");
+    int listen_fd = fdtable::adopt(socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0),
+                                   "server socket");
+    int ep = fdtable::adopt(epoll_create1(0), "server epoll");
+    if (sig_fd < 0 || listen_fd < 0 || ep < 0) {
+        perror("shell: server setup");
+        return 1;
+    }
+
+    unlink(socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(listen_fd, SOMAXCONN) != 0) {
+        std::cerr << "shell: " << socket_path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = sig_fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, sig_fd, &ev);
+    ev.data.fd = listen_fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, listen_fd, &ev);
+
+    int workers = 0;
+    bool accepting = true;
+    bool running = true;
+
+    while (running) {
+        epoll_event events[8];
+        int n = epoll_wait(ep, events, 8, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == sig_fd) {
+                signalfd_siginfo info;
+                while (read(sig_fd, &info, sizeof(info)) == sizeof(info)) {
+                    if (info.ssi_signo != SIGCHLD) running = false;
+                }
+                while (waitpid(-1, nullptr, WNOHANG) > 0) {
+                    --workers;
+                }
+                continue;
+            }
+
+            while (workers < MAX_WORKERS) {
+                int conn = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+                if (conn < 0) break;
+
+                pid_t pid = fork();
+                if (pid == 0) {
+                    fdtable::release(ep);
+                    fdtable::release(sig_fd);
+                    fdtable::release(listen_fd);
+                    sigprocmask(SIG_SETMASK, &old_mask, nullptr);
+                    audit::take_over();
+
+                    handle_connection(conn);
+                    audit::shutdown();
+                    _exit(0);
+                }
+                close(conn);
+                if (pid > 0) {
+                    ++workers;
+                } else {
+                    perror("fork");
+                }
+            }
+        }
+
+        // Stop polling the listener while at capacity; clients queue in
+        // the kernel backlog until a worker exits.
+        bool want = workers < MAX_WORKERS;
+        if (want != accepting) {
+            ev.data.fd = listen_fd;
+            epoll_ctl(ep, want ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, listen_fd, &ev);
+            accepting = want;
+        }
+    }
+
+    unlink(socket_path.c_str());
+    fdtable::release(listen_fd);
+    fdtable::release(ep);
+    fdtable::release(sig_fd);
+    return 0;
+}
+
+#else
+
+int serve(const std::string& /*socket_path*/) {
+    std::cerr << "shell: --serve is only supported on Linux\n";
+    return 1;
+}
+
+#endif
+
+} // namespace server
+} // namespace shell
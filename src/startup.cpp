@@ -0,0 +1,73 @@
+#include "startup.hpp"
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace shell {
+namespace startup {
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct PhaseTime {
+        const char* name;
+        Clock::duration elapsed;
+        bool background;
+    };
+
+    // Captured during static initialization, as close to exec as we get.
+    const Clock::time_point process_start = Clock::now();
+
+    bool enabled = false;
+    bool reported = false;
+    Clock::duration first_prompt{};
+    std::mutex phases_mu;  // background phases record from their own thread
+    std::vector<PhaseTime> phases;
+
+    double to_ms(Clock::duration d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+}
+
+void enable_profile() {
+    enabled = true;
+}
+
+bool profiling() {
+    return enabled;
+}
+
+void record(const char* name, Clock::duration elapsed, bool background) {
+    if (!enabled) return;
+    std::lock_guard<std::mutex> lock(phases_mu);
+    phases.push_back({name, elapsed, background});
+}
+
+void mark_first_prompt() {
+    if (first_prompt == Clock::duration::zero()) {
+        first_prompt = Clock::now() - process_start;
+    }
+}
+
+void report() {
+    if (!enabled || reported) return;
+    reported = true;
+
+    std::lock_guard<std::mutex> lock(phases_mu);
+    fprintf(stderr, "startup profile (ms):\n");
+    for (const auto& phase : phases) {
+        fprintf(stderr, "  %-28s %8.3f%s\n", phase.name, to_ms(phase.elapsed),
+                phase.background ? "  (background)" : "");
+    }
+    fprintf(stderr, "  %-28s %8.3f\n", "first prompt", to_ms(first_prompt));
+}
+
+Phase::Phase(const char* name, bool background)
+    : name_(name), background_(background), start_(Clock::now()) {}
+
+Phase::~Phase() {
+    record(name_, Clock::now() - start_, background_);
+}
+
+} // namespace startup
+} // namespace shell
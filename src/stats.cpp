@@ -0,0 +1,258 @@
+#include "stats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <unistd.h>
+
+namespace shell {
+namespace stats {
+
+namespace {
+    // Log-linear buckets: values below SUB are exact, and every power of
+    // two above is split into SUB equal buckets.
+    constexpr int SUB_BITS = 5;
+    constexpr size_t SUB = size_t{1} << SUB_BITS;
+    constexpr int MAX_EXP = 40;  // 2^40ns, about 18 minutes; longer samples share the top bucket
+    constexpr size_t BUCKETS = SUB + static_cast<size_t>(MAX_EXP - SUB_BITS + 1) * SUB;
+    constexpr long DEFAULT_INTERVAL = 60;
+
+    const char* const COUNTER_NAMES[] = {
+        "commands", "forks", "execs", "builtins", "lookups", "lookup_misses", "completions",
+    };
+    const char* const LATENCY_NAMES[] = {"parse", "spawn", "wait", "completion"};
+    static_assert(sizeof(COUNTER_NAMES) / sizeof(*COUNTER_NAMES) ==
+                  static_cast<size_t>(Counter::COUNT), "name every counter");
+    static_assert(sizeof(LATENCY_NAMES) / sizeof(*LATENCY_NAMES) ==
+                  static_cast<size_t>(Latency::COUNT), "name every histogram");
+
+    struct Histogram {
+        std::atomic<uint64_t> buckets[BUCKETS];
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+    };
+
+    // Copy of one histogram, so percentiles come from consistent counts.
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t mean = 0;
+        uint64_t max = 0;
+        uint64_t p50 = 0;
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+        uint64_t p999 = 0;
+    };
+
+    // Zero-initialised as statics, which is all the reset state there is.
+    std::atomic<uint64_t> counters[static_cast<size_t>(Counter::COUNT)];
+    Histogram histograms[static_cast<size_t>(Latency::COUNT)];
+    std::chrono::steady_clock::time_point since = std::chrono::steady_clock::now();
+
+    enum class State { UNCHECKED, OFF, ON };
+
+    State dump_state = State::UNCHECKED;
+    pid_t owner = 0;  // forked children keep a copy of the counters but never dump them
+    std::string dump_path;
+    std::chrono::seconds dump_interval{DEFAULT_INTERVAL};
+    std::chrono::steady_clock::time_point next_dump;
+
+    size_t bucket_of(uint64_t value) {
+        if (value < SUB) return static_cast<size_t>(value);
+        int exp = 63 - __builtin_clzll(value);
+        if (exp > MAX_EXP) return BUCKETS - 1;
+        size_t sub = static_cast<size_t>(value >> (exp - SUB_BITS)) & (SUB - 1);
+        return SUB + static_cast<size_t>(exp - SUB_BITS) * SUB + sub;
+    }
+
+    // Middle of the range of values that land in a bucket.
+    uint64_t value_of(size_t bucket) {
+        if (bucket < SUB) return bucket;
+        size_t group = (bucket - SUB) / SUB;
+        uint64_t sub = (bucket - SUB) % SUB;
+        int shift = static_cast<int>(group);
+        uint64_t lower = (uint64_t{1} << (shift + SUB_BITS)) + (sub << shift);
+        uint64_t width = uint64_t{1} << shift;
+        return lower + (width - 1) / 2;
+    }
+
+    Summary summarize(const Histogram& h) {
+        Summary s;
+        static uint64_t counts[BUCKETS];
+        uint64_t total = 0;
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            counts[i] = h.buckets[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+        if (total == 0) return s;
+
+        s.count = total;
+        s.max = h.max.load(std::memory_order_relaxed);
+        s.mean = h.sum.load(std::memory_order_relaxed) / total;
+
+        // Smallest value with at least per_mille/1000 of the samples at or below it.
+        auto percentile = [&](uint64_t per_mille) {
+            uint64_t rank = (total * per_mille + 999) / 1000;
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; ++i) {
+                seen += counts[i];
+                if (seen >= rank) return std::min(value_of(i), s.max);
+            }
+            return s.max;
+        };
+        s.p50 = percentile(500);
+        s.p90 = percentile(900);
+        s.p99 = percentile(990);
+        s.p999 = percentile(999);
+        return s;
+    }
+
+    std::string format_duration(uint64_t ns) {
+        char text[32];
+        if (ns < 1000) {
+            std::snprintf(text, sizeof(text), "%lluns", static_cast<unsigned long long>(ns));
+        } else if (ns < 1000000) {
+            std::snprintf(text, sizeof(text), "%.1fus", static_cast<double>(ns) / 1e3);
+        } else if (ns < 1000000000) {
+            std::snprintf(text, sizeof(text), "%.2fms", static_cast<double>(ns) / 1e6);
+        } else {
+            std::snprintf(text, sizeof(text), "%.2fs", static_cast<double>(ns) / 1e9);
+        }
+        return text;
+    }
+
+    void print_table(std::ostream& out, double uptime) {
+        out << "counters (last " << std::fixed << std::setprecision(1) << uptime << "s)\n";
+        for (size_t i = 0; i < static_cast<size_t>(Counter::COUNT); ++i) {
+            out << "  " << std::left << std::setw(16) << COUNTER_NAMES[i] << std::right
+                << std::setw(12) << counters[i].load(std::memory_order_relaxed) << "\n";
+        }
+
+        out << std::left << std::setw(18) << "latency" << std::right;
+        for (const char* column : {"count", "mean", "p50", "p90", "p99", "p99.9", "max"}) {
+            out << std::setw(10) << column;
+        }
+        out << "\n";
+        for (size_t i = 0; i < static_cast<size_t>(Latency::COUNT); ++i) {
+            Summary s = summarize(histograms[i]);
+            out << "  " << std::left << std::setw(16) << LATENCY_NAMES[i] << std::right
+                << std::setw(10) << s.count;
+            for (uint64_t value : {s.mean, s.p50, s.p90, s.p99, s.p999, s.max}) {
+                out << std::setw(10) << (s.count ? format_duration(value) : "-");
+            }
+            out << "\n";
+        }
+    }
+
+    void print_json(std::ostream& out, double uptime) {
+        out << "{\"pid\":" << getpid() << ",\"uptime_s\":" << std::fixed
+            << std::setprecision(3) << uptime << ",\"counters\":{";
+        for (size_t i = 0; i < static_cast<size_t>(Counter::COUNT); ++i) {
+            out << (i ? "," : "") << '"' << COUNTER_NAMES[i] << "\":"
+                << counters[i].load(std::memory_order_relaxed);
+        }
+        out << "},\"latency_ns\":{";
+        for (size_t i = 0; i < static_cast<size_t>(Latency::COUNT); ++i) {
+            Summary s = summarize(histograms[i]);
+            out << (i ? "," : "") << '"' << LATENCY_NAMES[i] << "\":{\"count\":" << s.count
+                << ",\"mean\":" << s.mean << ",\"p50\":" << s.p50 << ",\"p90\":" << s.p90
+                << ",\"p99\":" << s.p99 << ",\"p999\":" << s.p999 << ",\"max\":" << s.max << "}";
+        }
+        out << "}}\n";
+    }
+
+    // Written next to the target and renamed over it, so readers never
+    // see half a dump.
+    void dump() {
+        std::string tmp = dump_path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::trunc);
+            if (!out) return;
+            print(out, true);
+            if (!out.flush()) return;
+        }
+        std::rename(tmp.c_str(), dump_path.c_str());
+    }
+
+    // The final numbers, including the last command's.
+    void dump_at_exit() {
+        if (getpid() == owner) dump();
+    }
+
+    void configure() {
+        dump_state = State::OFF;
+        const char* path = getenv("SHELL_STATS_FILE");
+        if (!path || !*path) return;
+
+        dump_path = path;
+        if (const char* interval = getenv("SHELL_STATS_INTERVAL")) {
+            char* end = nullptr;
+            long seconds = std::strtol(interval, &end, 10);
+            if (end != interval && *end == '\0' && seconds >= 0) {
+                dump_interval = std::chrono::seconds(seconds);
+            }
+        }
+        owner = getpid();
+        next_dump = std::chrono::steady_clock::now() + dump_interval;
+        dump_state = State::ON;
+        std::atexit(dump_at_exit);
+    }
+} // namespace
+
+void add(Counter counter, uint64_t n) {
+    counters[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+void record(Latency latency, std::chrono::steady_clock::duration elapsed) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+
+    Histogram& h = histograms[static_cast<size_t>(latency)];
+    h.buckets[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    h.sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = h.max.load(std::memory_order_relaxed);
+    while (value > max && !h.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+void print(std::ostream& out, bool json) {
+    std::chrono::duration<double> uptime = std::chrono::steady_clock::now() - since;
+    auto flags = out.flags();
+    auto precision = out.precision();
+    if (json) {
+        print_json(out, uptime.count());
+    } else {
+        print_table(out, uptime.count());
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void reset() {
+    for (auto& counter : counters) {
+        counter.store(0, std::memory_order_relaxed);
+    }
+    for (auto& h : histograms) {
+        for (auto& bucket : h.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        h.sum.store(0, std::memory_order_relaxed);
+        h.max.store(0, std::memory_order_relaxed);
+    }
+    since = std::chrono::steady_clock::now();
+}
+
+void dump_if_due() {
+    if (dump_state == State::UNCHECKED) configure();
+    if (dump_state == State::OFF || getpid() != owner) return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_dump) return;
+    next_dump = now + dump_interval;
+    dump();
+}
+
+} // namespace stats
+} // namespace shell
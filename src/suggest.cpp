@@ -0,0 +1,421 @@
+#include "suggest.hpp"
+#include "history.hpp"
+#include "lineedit.hpp"
+#include "startup.hpp"
+#include "variables.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <system_error>
+#include <vector>
+#include <unistd.h>
+
+namespace shell {
+namespace suggest {
+
+namespace {
+    // Scores are log-sums of exp(t / DECAY_TAU) over a command's uses,
+    // with t in seconds since the index's epoch. Every score decays by the
+    // same factor as time passes, so the order never changes without a new
+    // use, and a use can only move its command up. That keeps each node's
+    // cached top list exact under incremental updates.
+    const double DECAY_TAU = 3 * 86400 / std::log(2.0);  // three-day half-life
+    // Uses in the current directory weigh this much more when ranking.
+    const double DIR_BOOST = std::log(4.0);
+    constexpr size_t TOP_K = 8;
+    constexpr size_t MAX_DIRS = 4;
+    constexpr size_t MAX_SAVED = 50000;
+    const char* const FILE_MAGIC = "#frecency 1 ";
+
+    double now_seconds() {
+        using namespace std::chrono;
+        return duration<double>(system_clock::now().time_since_epoch()).count();
+    }
+
+    double log_add(double a, double b) {
+        double hi = std::max(a, b);
+        double lo = std::min(a, b);
+        if (std::isinf(lo)) return hi;
+        return hi + std::log1p(std::exp(lo - hi));
+    }
+
+    struct Entry {
+        std::string command;
+        double score = -INFINITY;
+        std::vector<std::pair<std::string, double>> dirs;  // where it ran, scored
+
+        double rank(const std::string& dir) const {
+            for (const auto& [path, score_here] : dirs) {
+                if (path == dir) return log_add(score, score_here + DIR_BOOST);
+            }
+            return score;
+        }
+    };
+
+    // Radix tree node. `top` holds the best-scored entries anywhere below
+    // it, so a lookup costs one walk down the typed prefix.
+    struct Node {
+        std::string label;  // edge text from the parent
+        std::vector<std::unique_ptr<Node>> children;
+        int64_t entry = -1;  // command ending exactly here
+        std::vector<uint32_t> top;
+
+        Node* child(char c) const {
+            for (const auto& node : children) {
+                if (node->label[0] == c) return node.get();
+            }
+            return nullptr;
+        }
+    };
+
+    class Index {
+    public:
+        explicit Index(double epoch) : epoch_(epoch) {}
+
+        // Records a use of `command` in `dir` (empty if unknown) at `when`.
+        void use(const std::string& command, const std::string& dir, double when) {
+            double t = (when - epoch_) / DECAY_TAU;
+            uint32_t id = entry_for(command);
+            Entry& e = entries_[id];
+            e.score = log_add(e.score, t);
+            if (!dir.empty()) add_dir(e, dir, t);
+            update_path(id);
+        }
+
+        // Adds a command read back from the index file.
+        void restore(const std::string& command, double score,
+                     std::vector<std::pair<std::string, double>> dirs) {
+            uint32_t id = entry_for(command);
+            entries_[id].score = score;
+            entries_[id].dirs = std::move(dirs);
+            update_path(id);
+        }
+
+        // Best completion of `prefix` for a user in `dir`: the text to
+        // append, or empty if nothing longer matches.
+        std::string best(const std::string& prefix, const std::string& dir) const {
+            const Node* node = find(prefix);
+            if (!node) return "";
+
+            const Entry* best = nullptr;
+            double best_rank = -INFINITY;
+            for (uint32_t id : node->top) {
+                const Entry& e = entries_[id];
+                if (e.command.size() <= prefix.size()) continue;
+                double r = e.rank(dir);
+                if (!best || r > best_rank) {
+                    best = &e;
+                    best_rank = r;
+                }
+            }
+            return best ? best->command.substr(prefix.size()) : "";
+        }
+
+        // One line per command, best first:
+        // score TAB command [TAB dir-score TAB dir]...
+        void write(std::ostream& out) const {
+            std::vector<const Entry*> order;
+            order.reserve(entries_.size());
+            for (const auto& e : entries_) order.push_back(&e);
+            size_t keep = std::min(order.size(), MAX_SAVED);
+            std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(keep),
+                              order.end(), [](const Entry* a, const Entry* b) {
+                                  return a->score > b->score;
+                              });
+
+            out << FILE_MAGIC << std::to_string(epoch_) << "\n";
+            for (size_t i = 0; i < keep; ++i) {
+                const Entry& e = *order[i];
+                out << std::to_string(e.score) << '\t' << e.command;
+                for (const auto& [dir, score] : e.dirs) {
+                    out << '\t' << std::to_string(score) << '\t' << dir;
+                }
+                out << '\n';
+            }
+        }
+
+    private:
+        double epoch_;
+        Node root_;
+        std::vector<Entry> entries_;
+
+        uint32_t entry_for(const std::string& command) {
+            Node* node = insert(command);
+            if (node->entry < 0) {
+                node->entry = static_cast<int64_t>(entries_.size());
+                entries_.push_back(Entry{command, -INFINITY, {}});
+            }
+            return static_cast<uint32_t>(node->entry);
+        }
+
+        static void add_dir(Entry& e, const std::string& dir, double t) {
+            for (auto& [path, score] : e.dirs) {
+                if (path == dir) {
+                    score = log_add(score, t);
+                    return;
+                }
+            }
+            if (e.dirs.size() < MAX_DIRS) {
+                e.dirs.emplace_back(dir, t);
+                return;
+            }
+            auto weakest = std::min_element(e.dirs.begin(), e.dirs.end(),
+                [](const auto& a, const auto& b) { return a.second < b.second; });
+            *weakest = {dir, t};
+        }
+
+        // Returns the node for `key`, splitting edges as needed.
+        Node* insert(const std::string& key) {
+            Node* node = &root_;
+            size_t i = 0;
+            while (i < key.size()) {
+                Node* child = node->child(key[i]);
+                if (!child) {
+                    auto leaf = std::make_unique<Node>();
+                    leaf->label = key.substr(i);
+                    child = leaf.get();
+                    node->children.push_back(std::move(leaf));
+                    return child;
+                }
+                size_t common = 0;
+                while (common < child->label.size() && i + common < key.size() &&
+                       child->label[common] == key[i + common]) {
+                    ++common;
+                }
+                if (common < child->label.size()) split(*child, common);
+                i += common;
+                node = child;
+            }
+            return node;
+        }
+
+        // Cuts `node`'s edge after `at` characters. The subtree is the
+        // same, so both halves keep the same top list.
+        static void split(Node& node, size_t at) {
+            auto tail = std::make_unique<Node>();
+            tail->label = node.label.substr(at);
+            tail->children = std::move(node.children);
+            tail->entry = node.entry;
+            tail->top = node.top;
+            node.label.resize(at);
+            node.children.clear();
+            node.children.push_back(std::move(tail));
+            node.entry = -1;
+        }
+
+        const Node* find(const std::string& prefix) const {
+            const Node* node = &root_;
+            size_t i = 0;
+            while (i < prefix.size()) {
+                const Node* child = node->child(prefix[i]);
+                if (!child) return nullptr;
+                size_t n = std::min(child->label.size(), prefix.size() - i);
+                if (child->label.compare(0, n, prefix, i, n) != 0) return nullptr;
+                i += n;
+                node = child;
+            }
+            return node;
+        }
+
+        // Moves entry `id` up in the top lists along its path after its
+        // score grew.
+        void update_path(uint32_t id) {
+            const std::string& key = entries_[id].command;
+            Node* node = &root_;
+            size_t i = 0;
+            for (;;) {
+                promote(*node, id);
+                if (i == key.size()) break;
+                node = node->child(key[i]);
+                i += node->label.size();
+            }
+        }
+
+        void promote(Node& node, uint32_t id) {
+            auto& top = node.top;
+            auto it = std::find(top.begin(), top.end(), id);
+            if (it == top.end()) {
+                if (top.size() < TOP_K) {
+                    top.push_back(id);
+                } else if (entries_[id].score > entries_[top.back()].score) {
+                    top.back() = id;
+                } else {
+                    return;
+                }
+                it = top.end() - 1;
+            }
+            double score = entries_[id].score;
+            for (; it != top.begin() && entries_[*(it - 1)].score < score; --it) {
+                std::iter_swap(it, it - 1);
+            }
+        }
+    };
+
+    std::unique_ptr<Index> index;
+    std::future<std::unique_ptr<Index>> pending_load;
+    std::string index_path;
+
+    struct Use {
+        std::string command;
+        std::string dir;
+        double when;
+    };
+    std::vector<Use> pending_uses;  // recorded before the index arrived
+
+    // Last lookup, repeated for every redraw of the same line.
+    std::string shown_for;  // line the current suggestion was computed for
+    std::string suggestion;
+
+    std::string current_dir() {
+        char buf[PATH_MAX];
+        return getcwd(buf, sizeof(buf)) ? buf : "";
+    }
+
+    std::vector<std::string> split_fields(const std::string& line) {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        for (;;) {
+            size_t tab = line.find('\t', start);
+            fields.push_back(line.substr(start, tab - start));
+            if (tab == std::string::npos) return fields;
+            start = tab + 1;
+        }
+    }
+
+    // Reads the index file, or seeds a new index from the history file.
+    // Runs off the main thread; touches no shared state.
+    std::unique_ptr<Index> read_index(std::string path, std::string history_path) {
+        startup::Phase phase("frecency read", true);
+        std::ifstream in(path);
+        std::string line;
+        std::string magic(FILE_MAGIC);
+
+        if (std::getline(in, line) && line.compare(0, magic.size(), magic) == 0) {
+            auto loaded = std::make_unique<Index>(std::strtod(line.c_str() + magic.size(), nullptr));
+            while (std::getline(in, line)) {
+                auto fields = split_fields(line);
+                if (fields.size() < 2 || fields[1].empty()) continue;
+                std::vector<std::pair<std::string, double>> dirs;
+                for (size_t i = 2; i + 1 < fields.size() && dirs.size() < MAX_DIRS; i += 2) {
+                    dirs.emplace_back(fields[i + 1], std::strtod(fields[i].c_str(), nullptr));
+                }
+                loaded->restore(fields[1], std::strtod(fields[0].c_str(), nullptr),
+                                std::move(dirs));
+            }
+            return loaded;
+        }
+
+        // First run: older history lines count as older uses.
+        double now = now_seconds();
+        auto seeded = std::make_unique<Index>(now);
+        std::vector<std::string> lines;
+        std::ifstream hist(history_path);
+        while (std::getline(hist, line)) {
+            if (!line.empty()) lines.push_back(std::move(line));
+        }
+        for (size_t i = 0; i < lines.size(); ++i) {
+            seeded->use(lines[i], "", now - static_cast<double>(lines.size() - i));
+        }
+        return seeded;
+    }
+
+    void merge(std::unique_ptr<Index> loaded) {
+        index = std::move(loaded);
+        for (const auto& u : pending_uses) {
+            index->use(u.command, u.dir, u.when);
+        }
+        pending_uses.clear();
+    }
+
+    // Takes the loaded index if it is ready; never blocks.
+    bool ready() {
+        if (index) return true;
+        if (!pending_load.valid() ||
+            pending_load.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return false;
+        }
+        merge(pending_load.get());
+        return true;
+    }
+
+    // The rest of the best past command starting with `line`.
+    std::string suggestion_for(const std::string& line) {
+        if (variables::get("AUTOSUGGEST") == "off") return "";
+        if (line != shown_for) {
+            shown_for = line;
+            bool blank = line.find_first_not_of(" \t") == std::string::npos;
+            suggestion = blank || !ready() ? "" : index->best(line, current_dir());
+            // Lines are recorded one at a time; never suggest a second one.
+            suggestion = suggestion.substr(0, suggestion.find('\n'));
+        }
+        return suggestion;
+    }
+}
+
+void init() {
+    const char* history_file = history::get_history_file();
+    if (history_file) {
+        index_path = std::string(history_file) + ".frecency";
+        try {
+            pending_load = std::async(std::launch::async, read_index, index_path,
+                                      std::string(history_file));
+        } catch (const std::system_error&) {
+            pending_load = {};
+            merge(read_index(index_path, history_file));
+        }
+    } else {
+        index = std::make_unique<Index>(now_seconds());
+    }
+
+    // Escape sequences only make sense on a terminal.
+    const char* term = getenv("TERM");
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO) ||
+        (term && std::string(term) == "dumb")) {
+        return;
+    }
+
+    lineedit::set_suggester(suggestion_for);
+}
+
+void record(const std::string& line) {
+    if (line.find_first_not_of(" \t") == std::string::npos ||
+        line.find_first_of("\t\n") != std::string::npos) {
+        return;  // not representable in the index file
+    }
+    double now = now_seconds();
+    std::string dir = current_dir();
+    if (ready()) {
+        index->use(line, dir, now);
+    } else {
+        pending_uses.push_back({line, dir, now});
+    }
+    // Force a fresh lookup on the next line.
+    shown_for.clear();
+    suggestion.clear();
+}
+
+void save() {
+    if (!index && pending_load.valid()) merge(pending_load.get());
+    if (!index || index_path.empty()) return;
+
+    std::string tmp = index_path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) return;
+        index->write(out);
+        if (!out.flush()) {
+            std::remove(tmp.c_str());
+            return;
+        }
+    }
+    std::rename(tmp.c_str(), index_path.c_str());
+}
+
+} // namespace suggest
+} // namespace shell
@@ -0,0 +1,321 @@
+#include "supervisor.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <sys/wait.h>
+#include <termios.h>
+
+namespace shell {
+namespace supervisor {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// epoll tag of the timer; children are tagged with their index.
+constexpr uint64_t TIMER_TAG = UINT64_MAX;
+
+// Fallback poll interval when pidfds are unavailable and a limit is set.
+constexpr auto POLL_INTERVAL = std::chrono::milliseconds(10);
+
+int pidfd_open(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#else
+    (void)pid;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+void wait_for(pid_t pid, Outcome& out, size_t i) {
+    while (wait4(pid, &out.statuses[i], 0, &out.usage[i]) < 0 && errno == EINTR) {
+    }
+}
+
+// Walks the TERM -> KILL ladder for a timed-out process group.
+class Escalation {
+public:
+    Escalation(pid_t pgid, const Limits& limits) : pgid_(pgid), limits_(limits) {}
+
+    // Sends the next signal; returns how long to wait before the one
+    // after it, or zero if there is none.
+    std::chrono::nanoseconds fire(Outcome& out) {
+        if (!out.timed_out) {
+            out.timed_out = true;
+            kill(-pgid_, limits_.signal);
+            if (limits_.signal == SIGKILL) {
+                out.killed = true;
+                return {};
+            }
+            // A stopped pipeline would never act on the signal.
+            kill(-pgid_, SIGCONT);
+            return limits_.kill_after;
+        }
+        if (!out.killed) {
+            out.killed = true;
+            kill(-pgid_, SIGKILL);
+        }
+        return {};
+    }
+
+private:
+    pid_t pgid_;
+    const Limits& limits_;
+};
+
+void arm(int timer, std::chrono::nanoseconds delay) {
+    itimerspec spec{};
+    spec.it_value.tv_sec = static_cast<time_t>(delay.count() / 1000000000);
+    spec.it_value.tv_nsec = static_cast<long>(delay.count() % 1000000000);
+    timerfd_settime(timer, 0, &spec, nullptr);
+}
+
+// Without pidfds: blocking waits, or WNOHANG polling when a limit is set.
+void poll_wait(const std::vector<pid_t>& pids, bool limited,
+               Escalation& escalation, const Limits& limits, Outcome& out) {
+    if (!limited) {
+        for (size_t i = 0; i < pids.size(); ++i) {
+            if (pids[i] > 0) wait_for(pids[i], out, i);
+        }
+        return;
+    }
+
+    std::vector<bool> done(pids.size());
+    size_t remaining = 0;
+    for (size_t i = 0; i < pids.size(); ++i) {
+        done[i] = pids[i] <= 0;
+        if (!done[i]) ++remaining;
+    }
+
+    auto deadline = Clock::now() + limits.duration;
+    bool pending_step = true;
+    while (remaining > 0) {
+        for (size_t i = 0; i < pids.size(); ++i) {
+            if (done[i]) continue;
+            pid_t r = wait4(pids[i], &out.statuses[i], WNOHANG, &out.usage[i]);
+            if (r == pids[i] || (r < 0 && errno != EINTR)) {
+                done[i] = true;
+                --remaining;
+            }
+        }
+        if (remaining == 0) break;
+
+        if (pending_step && Clock::now() >= deadline) {
+            auto next = escalation.fire(out);
+            pending_step = next.count() > 0;
+            deadline = Clock::now() + next;
+        }
+        std::this_thread::sleep_for(POLL_INTERVAL);
+    }
+}
+
+bool parse_duration(const std::string& text, std::chrono::nanoseconds& out) {
+    char* end = nullptr;
+    errno = 0;
+    double seconds = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || errno != 0 || !std::isfinite(seconds) || seconds < 0) {
+        return false;
+    }
+
+    std::string suffix(end);
+    if (suffix == "m") {
+        seconds *= 60;
+    } else if (suffix == "h") {
+        seconds *= 60 * 60;
+    } else if (suffix == "d") {
+        seconds *= 24 * 60 * 60;
+    } else if (!suffix.empty() && suffix != "s") {
+        return false;
+    }
+
+    // Anything longer than a few decades is as good as no limit.
+    seconds = std::min(seconds, 1e9);
+    out = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(seconds));
+    // A positive interval too short to represent must not mean "no limit".
+    if (seconds > 0 && out.count() == 0) out = std::chrono::nanoseconds(1);
+    return true;
+}
+
+bool parse_signal(std::string text, int& sig) {
+    static const struct { const char* name; int number; } names[] = {
+        {"HUP", SIGHUP},   {"INT", SIGINT},   {"QUIT", SIGQUIT},
+        {"KILL", SIGKILL}, {"USR1", SIGUSR1}, {"USR2", SIGUSR2},
+        {"PIPE", SIGPIPE}, {"ALRM", SIGALRM}, {"TERM", SIGTERM},
+        {"CONT", SIGCONT}, {"STOP", SIGSTOP}, {"TSTP", SIGTSTP},
+    };
+
+    if (!text.empty() && text.find_first_not_of("0123456789") == std::string::npos) {
+        sig = std::atoi(text.c_str());
+        return sig > 0 && sig < NSIG;
+    }
+    if (text.rfind("SIG", 0) == 0) text.erase(0, 3);
+    for (const auto& entry : names) {
+        if (text == entry.name) {
+            sig = entry.number;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Runs tcsetpgrp() with SIGTTOU blocked, as a background group has to.
+void set_foreground(pid_t pgid) {
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGTTOU);
+    sigprocmask(SIG_BLOCK, &block, &old);
+    tcsetpgrp(STDIN_FILENO, pgid);
+    sigprocmask(SIG_SETMASK, &old, nullptr);
+}
+
+} // namespace
+
+int parse_timeout(const std::vector<std::string>& args, Limits& limits) {
+    const char* usage =
+        "timeout: usage: timeout [-s SIG] [-k DURATION] DURATION command [arg...]\n";
+    bool have_duration = false;
+    size_t i = 1;
+
+    for (; i < args.size(); ++i) {
+        const std::string& arg = args[i];
+        if (arg.size() >= 2 && arg[0] == '-' && (arg[1] == 's' || arg[1] == 'k')) {
+            std::string value = arg.substr(2);
+            if (value.empty()) {
+                if (i + 1 == args.size()) {
+                    std::cerr << "timeout: option requires an argument -- '" << arg[1] << "'\n"
+                              << usage;
+                    return -1;
+                }
+                value = args[++i];
+            }
+            if (arg[1] == 's' && !parse_signal(value, limits.signal)) {
+                std::cerr << "timeout: " << value << ": invalid signal\n";
+                return -1;
+            }
+            if (arg[1] == 'k' && !parse_duration(value, limits.kill_after)) {
+                std::cerr << "timeout: invalid time interval '" << value << "'\n";
+                return -1;
+            }
+        } else if (!have_duration) {
+            if (!parse_duration(arg, limits.duration)) {
+                std::cerr << "timeout: invalid time interval '" << arg << "'\n";
+                return -1;
+            }
+            have_duration = true;
+        } else {
+            break;
+        }
+    }
+
+    if (!have_duration || i == args.size()) {
+        std::cerr << usage;
+        return -1;
+    }
+    return static_cast<int>(i);
+}
+
+bool owns_terminal() {
+    pid_t fg = tcgetpgrp(STDIN_FILENO);
+    return fg >= 0 && fg == getpgrp();
+}
+
+void join_group(pid_t pgid, bool foreground) {
+    setpgid(0, pgid);
+    if (foreground) set_foreground(getpgrp());
+}
+
+void reclaim_terminal() {
+    set_foreground(getpgrp());
+}
+
+Outcome supervise(const std::vector<pid_t>& pids, pid_t pgid, const Limits& limits) {
+    Outcome out;
+    out.statuses.assign(pids.size(), 0);
+    out.usage.assign(pids.size(), rusage{});
+    const bool limited = limits.duration.count() > 0 && pgid > 0;
+    Escalation escalation(pgid, limits);
+
+    // These descriptors never outlive this call and nothing forks while it
+    // runs, so they stay out of the fd table.
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    int timer = limited ? timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC) : -1;
+    std::vector<int> pidfds(pids.size(), -1);
+    size_t remaining = 0;
+    bool usable = ep >= 0 && (!limited || timer >= 0);
+
+    for (size_t i = 0; usable && i < pids.size(); ++i) {
+        if (pids[i] <= 0) continue;
+        pidfds[i] = pidfd_open(pids[i]);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = i;
+        usable = pidfds[i] >= 0 && epoll_ctl(ep, EPOLL_CTL_ADD, pidfds[i], &ev) == 0;
+        ++remaining;
+    }
+    if (usable && limited) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = TIMER_TAG;
+        usable = epoll_ctl(ep, EPOLL_CTL_ADD, timer, &ev) == 0;
+        arm(timer, limits.duration);
+    }
+
+    if (!usable) {
+        // Old kernel or a sandbox without pidfd_open().
+        remaining = 0;
+        poll_wait(pids, limited, escalation, limits, out);
+    }
+
+    while (remaining > 0) {
+        epoll_event events[16];
+        int n = epoll_wait(ep, events, 16, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int k = 0; k < n; ++k) {
+            uint64_t tag = events[k].data.u64;
+            if (tag == TIMER_TAG) {
+                uint64_t expirations;
+                ssize_t r = read(timer, &expirations, sizeof(expirations));
+                (void)r;
+                auto next = escalation.fire(out);
+                if (next.count() > 0) arm(timer, next);
+                continue;
+            }
+
+            auto i = static_cast<size_t>(tag);
+            wait_for(pids[i], out, i);
+            close(pidfds[i]);
+            pidfds[i] = -1;
+            --remaining;
+        }
+    }
+
+    // Anything epoll could not report is waited for the plain way.
+    for (size_t i = 0; i < pids.size(); ++i) {
+        if (pidfds[i] >= 0) {
+            if (usable) wait_for(pids[i], out, i);
+            close(pidfds[i]);
+        }
+    }
+    if (timer >= 0) close(timer);
+    if (ep >= 0) close(ep);
+    return out;
+}
+
+} // namespace supervisor
+} // namespace shell
@@ -1,11 +1,14 @@
 #include "utils.hpp"
+#include "stats.hpp"
 #include <cstdlib>
 #include <unistd.h>
 #include <sstream>
 
 namespace shell {
 
-std::string resolve_exec(const std::string& cmd) {
+namespace {
+
+std::string search_exec(const std::string& cmd) {
     // Handle paths with /
     if (cmd.find('/') != std::string::npos) {
         if (access(cmd.c_str(), X_OK) == 0) {
@@ -38,6 +41,17 @@ std::string resolve_exec(const std::string& cmd) {
     return "";
 }
 
+} // namespace
+
+std::string resolve_exec(const std::string& cmd) {
+    stats::add(stats::Counter::LOOKUPS);
+    std::string path = search_exec(cmd);
+    if (path.empty()) {
+        stats::add(stats::Counter::LOOKUP_MISSES);
+    }
+    return path;
+}
+
 std::string expand_tilde(const std::string& path) {
     if (path.empty() || path[0] != '~') {
         return path;
@@ -0,0 +1,260 @@
+#include "variables.hpp"
+#include "arith.hpp"
+#include "executor.hpp"
+#include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <unistd.h>
+
+namespace shell {
+namespace variables {
+
+namespace {
+
+// Shell variables; a scalar is stored as a one-element array. Exported
+// variables additionally live in the process environment.
+std::unordered_map<std::string, std::vector<std::string>> vars;
+
+// Names given to `export` while unset; they enter the environment on
+// their first assignment.
+std::unordered_set<std::string> exported;
+
+// $0, $1, ... from the command line of a script or `shell -c`.
+std::vector<std::string> positional;
+
+bool is_name_start(char c) {
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool is_name_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Keeps the environment in step for exported variables.
+void sync_env(const std::string& name, const std::vector<std::string>& values) {
+    if (getenv(name.c_str()) || exported.count(name)) {
+        setenv(name.c_str(), values.empty() ? "" : values[0].c_str(), 1);
+    }
+}
+
+// Splits NAME[sub]=value / NAME=value. `sub` is empty without a subscript.
+bool split_assignment(const std::string& word, std::string& name,
+                      std::string& sub, bool& has_sub, std::string& value) {
+    size_t eq = word.find('=');
+    if (eq == std::string::npos || eq == 0) return false;
+
+    std::string lhs = word.substr(0, eq);
+    has_sub = false;
+    size_t bracket = lhs.find('[');
+    if (bracket != std::string::npos) {
+        if (lhs.back() != ']') return false;
+        sub = lhs.substr(bracket + 1, lhs.size() - bracket - 2);
+        lhs.resize(bracket);
+        has_sub = true;
+    }
+    if (!is_valid_name(lhs)) return false;
+
+    name = lhs;
+    value = word.substr(eq + 1);
+    return true;
+}
+
+} // namespace
+
+bool is_valid_name(const std::string& name) {
+    if (name.empty() || !is_name_start(name[0])) return false;
+    for (char c : name) {
+        if (!is_name_char(c)) return false;
+    }
+    return true;
+}
+
+bool is_set(const std::string& name) {
+    return vars.count(name) > 0 || getenv(name.c_str()) != nullptr;
+}
+
+std::string get(const std::string& name) {
+    if (name == "?") return std::to_string(executor::last_status());
+    if (name == "$") return std::to_string(getpid());
+    if (name == "#") return std::to_string(positional.empty() ? 0 : positional.size() - 1);
+    if (!name.empty() && std::isdigit(static_cast<unsigned char>(name[0]))) {
+        size_t index = std::strtoul(name.c_str(), nullptr, 10);
+        return index < positional.size() ? positional[index] : "";
+    }
+
+    auto it = vars.find(name);
+    if (it != vars.end()) {
+        return it->second.empty() ? "" : it->second[0];
+    }
+    const char* env = getenv(name.c_str());
+    return env ? env : "";
+}
+
+std::string get_element(const std::string& name, size_t index) {
+    if (index == 0) return get(name);
+    auto it = vars.find(name);
+    if (it == vars.end() || index >= it->second.size()) return "";
+    return it->second[index];
+}
+
+std::vector<std::string> get_all(const std::string& name) {
+    if (name == "@" || name == "*") {
+        if (positional.empty()) return {};
+        return {positional.begin() + 1, positional.end()};
+    }
+    auto it = vars.find(name);
+    if (it != vars.end()) return it->second;
+    if (is_set(name)) return {get(name)};
+    return {};
+}
+
+void set_positional(std::vector<std::string> args) {
+    positional = std::move(args);
+}
+
+void set(const std::string& name, const std::string& value) {
+    auto& values = vars[name];
+    if (values.empty()) {
+        values.push_back(value);
+    } else {
+        values[0] = value;
+    }
+    sync_env(name, values);
+}
+
+void set_element(const std::string& name, size_t index, const std::string& value) {
+    auto it = vars.find(name);
+    if (it == vars.end()) {
+        // Start from the inherited value, if any, as element 0.
+        it = vars.emplace(name, get_all(name)).first;
+    }
+    auto& values = it->second;
+    if (index >= values.size()) values.resize(index + 1);
+    values[index] = value;
+    sync_env(name, values);
+}
+
+void set_array(const std::string& name, std::vector<std::string> values) {
+    sync_env(name, values);
+    vars[name] = std::move(values);
+}
+
+void unset(const std::string& name) {
+    vars.erase(name);
+    exported.erase(name);
+    unsetenv(name.c_str());
+}
+
+void export_name(const std::string& name) {
+    if (is_set(name)) {
+        setenv(name.c_str(), get(name).c_str(), 1);
+    } else {
+        exported.insert(name);
+    }
+}
+
+size_t prefix_length(const std::vector<std::string>& words) {
+    size_t n = 0;
+    for (; n < words.size(); ++n) {
+        std::string name, sub, value;
+        bool has_sub;
+        if (!split_assignment(words[n], name, sub, has_sub, value) || has_sub ||
+            (!value.empty() && value[0] == '(')) {
+            break;
+        }
+    }
+    return n;
+}
+
+PrefixGuard::PrefixGuard(const std::vector<std::string>& words) {
+    for (const auto& word : words) {
+        size_t eq = word.find('=');
+        Saved saved{word.substr(0, eq), false, {}, false, {}};
+        auto it = vars.find(saved.name);
+        if (it != vars.end()) {
+            saved.had_var = true;
+            saved.var = it->second;
+            it->second = {word.substr(eq + 1)};
+        }
+        if (const char* env = getenv(saved.name.c_str())) {
+            saved.had_env = true;
+            saved.env = env;
+        }
+        setenv(saved.name.c_str(), word.c_str() + eq + 1, 1);
+        saved_.push_back(std::move(saved));
+    }
+}
+
+PrefixGuard::~PrefixGuard() {
+    // Newest first, so a name given twice ends up as it was.
+    for (auto it = saved_.rbegin(); it != saved_.rend(); ++it) {
+        if (it->had_var) vars[it->name] = std::move(it->var);
+        if (it->had_env) {
+            setenv(it->name.c_str(), it->env.c_str(), 1);
+        } else {
+            unsetenv(it->name.c_str());
+        }
+    }
+}
+
+bool resolve_index(const std::string& expr, size_t& index) {
+    int64_t value;
+    if (!arith::evaluate(expr, value) || value < 0) return false;
+    index = static_cast<size_t>(value);
+    return true;
+}
+
+bool is_assignment(const std::string& word) {
+    std::string name, sub, value;
+    bool has_sub;
+    return split_assignment(word, name, sub, has_sub, value);
+}
+
+int assign(const std::vector<std::string>& words) {
+    for (size_t i = 0; i < words.size(); ++i) {
+        std::string name, sub, value;
+        bool has_sub;
+        if (!split_assignment(words[i], name, sub, has_sub, value)) {
+            std::cerr << "shell: " << words[i]
+                      << ": assignments cannot prefix a command\n";
+            return 1;
+        }
+
+        if (has_sub) {
+            size_t index;
+            if (!resolve_index(sub, index)) {
+                std::cerr << "shell: " << name << "[" << sub << "]: bad array subscript\n";
+                return 1;
+            }
+            set_element(name, index, value);
+            continue;
+        }
+
+        if (value.empty() || value[0] != '(') {
+            set(name, value);
+            continue;
+        }
+
+        // NAME=(a b c): the tokenizer delivers "NAME=(a", "b", "c)".
+        std::vector<std::string> elements;
+        std::string word = value.substr(1);
+        for (;;) {
+            bool last = !word.empty() && word.back() == ')';
+            if (last) word.pop_back();
+            if (!word.empty()) elements.push_back(word);
+            if (last) break;
+            if (++i == words.size()) {
+                std::cerr << "shell: " << name << ": missing ')' in array assignment\n";
+                return 1;
+            }
+            word = words[i];
+        }
+        set_array(name, std::move(elements));
+    }
+    return 0;
+}
+
+} // namespace variables
+} // namespace shell
@@ -0,0 +1,31 @@
+#!/bin/sh
+# The audit log is rotated before it grows past SHELL_AUDIT_LOG_MAX,
+# even when one batch of records is larger than the limit.
+shell=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "FAIL: $1"
+    status=1
+}
+
+commands=
+i=0
+while [ $i -lt 60 ]; do
+    commands="$commands /bin/true;"
+    i=$((i + 1))
+done
+
+SHELL_AUDIT_LOG="$dir/log" SHELL_AUDIT_LOG_MAX=1K "$shell" -c "$commands"
+
+[ -s "$dir/log" ] || fail "no audit log written"
+[ -s "$dir/log.1" ] || fail "audit log was not rotated"
+for log in "$dir/log" "$dir/log.1"; do
+    [ -e "$log" ] || continue
+    size=$(wc -c < "$log")
+    [ "$size" -le 1024 ] || fail "$(basename "$log") is $size bytes, over the 1K limit"
+done
+
+exit $status
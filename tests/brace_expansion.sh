@@ -0,0 +1,33 @@
+#!/bin/sh
+# Brace expansion leaves NAME=value words alone and refuses a
+# redirection target that expands to more than one file.
+shell=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "FAIL: $1"
+    status=1
+}
+
+out=$("$shell" -c 'echo a{1..3}b {x,y}')
+[ "$out" = "a1b a2b a3b x y" ] || fail "expansion gave '$out'"
+
+out=$("$shell" -c 'x={a,b}; echo $x')
+[ "$out" = "{a,b}" ] || fail "assignment was expanded to '$out'"
+
+out=$("$shell" -c 'x={a,b} env | grep ^x=')
+[ "$out" = "x={a,b}" ] || fail "prefix assignment was expanded to '$out'"
+
+err=$(cd "$dir" && "$shell" -c 'echo {1..3} > out{1,2}' 2>&1)
+case $err in
+    *"ambiguous redirect"*) ;;
+    *) fail "two-file redirection gave '$err'" ;;
+esac
+[ -e "$dir/out1" ] && fail "ambiguous redirection wrote out1"
+
+(cd "$dir" && "$shell" -c 'echo ok > out{3}x{1..1}')
+[ "$(cat "$dir/out{3}x1" 2>/dev/null)" = "ok" ] || fail "single-file target was not expanded"
+
+exit $status
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Completing in "." right after cd lists the new directory, not the
+# listing cached for the previous one. Needs script(1) for a terminal.
+shell=$1
+command -v script > /dev/null || { echo "script(1) not found, skipped"; exit 0; }
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+mkdir "$dir/d2" "$dir/d3"
+: > "$dir/d2/zzfirst"
+: > "$dir/d3/zzthird"
+
+{
+    sleep 0.5
+    printf 'cd %s/d2\n' "$dir"
+    sleep 1.2
+    printf 'touch zz\t'
+    sleep 0.2
+    printf '\n'
+    sleep 0.1
+    printf 'cd ../d3\n'
+    sleep 0.1
+    printf 'touch zz\t'
+    sleep 0.2
+    printf '\nexit\n'
+    sleep 0.3
+} | HOME=$dir AUTOSUGGEST=off script -qec "$shell" /dev/null > /dev/null 2>&1
+
+if [ -e "$dir/d3/zzfirst" ]; then
+    echo "FAIL: completion in d3 offered d2's zzfirst"
+    exit 1
+fi
+exit 0
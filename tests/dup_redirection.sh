@@ -0,0 +1,24 @@
+#!/bin/sh
+# A >&N or 2>&N naming a closed descriptor fails the command without
+# running it.
+shell=$1
+status=0
+
+fail() {
+    echo "FAIL: $1"
+    status=1
+}
+
+out=$("$shell" -c '/bin/echo x >&99; echo rc=$?' 2>/dev/null)
+[ "$out" = "rc=1" ] || fail "external command with >&99 gave '$out'"
+
+out=$("$shell" -c 'echo x >&99; echo rc=$?' 2>/dev/null)
+[ "$out" = "rc=1" ] || fail "builtin with >&99 gave '$out'"
+
+out=$("$shell" -c 'echo x | /bin/cat 2>&99; echo rc=$?' 2>/dev/null)
+[ "$out" = "rc=1" ] || fail "pipeline stage with 2>&99 gave '$out'"
+
+out=$("$shell" -c 'echo x >&2' 2>&1)
+[ "$out" = "x" ] || fail ">&2 gave '$out'"
+
+exit $status
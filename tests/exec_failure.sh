@@ -0,0 +1,35 @@
+#!/bin/sh
+# A failed exec ends scripts and -c with 127 or 126; only the
+# interactive shell carries on.
+shell=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "FAIL: $1"
+    status=1
+}
+
+out=$("$shell" -c 'exec /nonexistent/cmd; echo still-running' 2>/dev/null)
+code=$?
+[ "$code" -eq 127 ] || fail "exec of a missing command gave status $code"
+[ -z "$out" ] || fail "-c kept running after exec failed: '$out'"
+
+"$shell" -c "exec $dir; echo still-running" > /dev/null 2>&1
+code=$?
+[ "$code" -eq 126 ] || fail "exec of a directory gave status $code"
+
+printf 'exec /nonexistent/cmd\necho still-running\n' > "$dir/script"
+out=$("$shell" "$dir/script" 2>/dev/null)
+code=$?
+[ "$code" -eq 127 ] || fail "script exec failure gave status $code"
+[ -z "$out" ] || fail "script kept running after exec failed: '$out'"
+
+out=$(printf 'exec /nonexistent/cmd\necho still-running\n' | "$shell" 2>/dev/null)
+case $out in
+    *still-running*) ;;
+    *) fail "interactive shell stopped after exec failed" ;;
+esac
+
+exit $status
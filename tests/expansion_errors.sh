@@ -0,0 +1,36 @@
+#!/bin/sh
+# A line that fails to expand sets status 1; scripts and -c stop there,
+# the interactive shell carries on.
+shell=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "FAIL: $1"
+    status=1
+}
+
+out=$("$shell" -c 'echo $((1/0)); echo still-running' 2>/dev/null)
+code=$?
+[ "$code" -eq 1 ] || fail "arithmetic error gave status $code"
+[ -z "$out" ] || fail "-c kept running after an arithmetic error: '$out'"
+
+out=$("$shell" -c 'echo {1..99999999}; echo still-running' 2>/dev/null)
+code=$?
+[ "$code" -eq 1 ] || fail "oversized brace expansion gave status $code"
+[ -z "$out" ] || fail "-c kept running after a brace error: '$out'"
+
+printf 'echo first\necho {1..99999999}\necho still-running\n' > "$dir/script"
+out=$("$shell" "$dir/script" 2>/dev/null)
+code=$?
+[ "$code" -eq 1 ] || fail "script brace error gave status $code"
+[ "$out" = "first" ] || fail "script printed '$out'"
+
+out=$(printf 'echo $((1/0))\necho rc=$?\n' | "$shell" 2>/dev/null)
+case $out in
+    *rc=1*) ;;
+    *) fail "interactive arithmetic error did not set status 1" ;;
+esac
+
+exit $status
@@ -0,0 +1,31 @@
+#!/bin/sh
+# export puts variables in the environment; NAME=value in front of a
+# command exports it for that command only.
+shell=$1
+status=0
+
+fail() {
+    echo "FAIL: $1"
+    status=1
+}
+
+unset FOO
+out=$("$shell" -c 'FOO=bar env | grep ^FOO=; echo "[$FOO]"')
+[ "$out" = "FOO=bar
+[]" ] || fail "FOO=bar env gave '$out'"
+
+out=$("$shell" -c 'FOO=bar; env | grep -c ^FOO=; export FOO; env | grep ^FOO=')
+[ "$out" = "0
+FOO=bar" ] || fail "export FOO gave '$out'"
+
+out=$("$shell" -c 'export FOO; FOO=later; env | grep ^FOO=')
+[ "$out" = "FOO=later" ] || fail "export before assignment gave '$out'"
+
+out=$("$shell" -c 'X=1; X=2 sh -c "echo \$X"; echo $X')
+[ "$out" = "2
+1" ] || fail "prefix over a shell variable gave '$out'"
+
+out=$("$shell" -c 'echo a:b | IFS=: read p q; echo $p-$q')
+[ "$out" = "a-b" ] || fail "IFS prefix on read gave '$out'"
+
+exit $status
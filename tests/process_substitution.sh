@@ -0,0 +1,43 @@
+#!/bin/sh
+# Process substitution runs only for <(...) and >(...) typed unquoted;
+# the same text from quotes or a variable is an ordinary word.
+shell=$1
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "FAIL: $1"
+    status=1
+}
+
+out=$("$shell" -c "echo '<(touch $dir/quoted)'")
+[ -e "$dir/quoted" ] && fail "quoted <(...) was run"
+[ "$out" = "<(touch $dir/quoted)" ] || fail "quoted <(...) printed '$out'"
+
+out=$("$shell" -c "x='<(touch $dir/expanded)'; echo \$x")
+[ -e "$dir/expanded" ] && fail "expanded <(...) was run"
+[ "$out" = "<(touch $dir/expanded)" ] || fail "expanded <(...) printed '$out'"
+
+"$shell" -c "echo \">(touch $dir/output)\"" > /dev/null
+[ -e "$dir/output" ] && fail "quoted >(...) was run"
+
+out=$("$shell" -c "cat <(echo substituted)")
+[ "$out" = "substituted" ] || fail "unquoted <(...) gave '$out'"
+
+out=$("$shell" -c "echo '|' '>' x")
+[ "$out" = "| > x" ] || fail "quoted operators gave '$out'"
+
+# Scripts are tokenized once and cached; the second run loads the cache.
+cat > "$dir/script" <<SCRIPT
+echo '<(touch $dir/cached)' '|' x | cat
+cat <(echo cached-ok)
+SCRIPT
+for run in first second; do
+    out=$(XDG_CACHE_HOME="$dir/cache" "$shell" "$dir/script")
+    [ -e "$dir/cached" ] && fail "quoted <(...) was run from the $run script run"
+    expected=$(printf '%s\n%s' "<(touch $dir/cached) | x" "cached-ok")
+    [ "$out" = "$expected" ] || fail "$run script run printed '$out'"
+done
+
+exit $status
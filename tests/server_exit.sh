@@ -0,0 +1,42 @@
+#!/bin/sh
+# `exit N` in a server request answers the client with status N, and
+# `exec cmd` with the command's status.
+shell=$1
+client=$(dirname "$shell")/shell-client
+dir=$(mktemp -d) || exit 1
+"$shell" --serve "$dir/sock" > /dev/null 2>&1 &
+server=$!
+trap 'kill $server; rm -rf "$dir"' EXIT
+status=0
+
+fail() {
+    echo "FAIL: $1"
+    status=1
+}
+
+tries=0
+while [ ! -S "$dir/sock" ] && [ $tries -lt 50 ]; do
+    sleep 0.1
+    tries=$((tries + 1))
+done
+
+out=$("$client" "$dir/sock" 'echo before; exit 3')
+code=$?
+[ "$code" -eq 3 ] || fail "exit 3 gave status $code"
+[ "$out" = "before" ] || fail "exit 3 printed '$out'"
+
+out=$("$client" "$dir/sock" 'cat <(exit 7); echo after')
+code=$?
+[ "$code" -eq 0 ] || fail "exit in a process substitution gave status $code"
+[ "$out" = "after" ] || fail "exit in a process substitution printed '$out'"
+
+out=$("$client" "$dir/sock" 'exec sh -c "echo ran; exit 5"')
+code=$?
+[ "$code" -eq 5 ] || fail "exec gave status $code"
+[ "$out" = "ran" ] || fail "exec printed '$out'"
+
+"$client" "$dir/sock" 'false'
+code=$?
+[ "$code" -eq 1 ] || fail "false gave status $code"
+
+exit $status
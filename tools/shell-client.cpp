@@ -0,0 +1,75 @@
+// shell-client: runs one command line on a `shell --serve` instance.
+//
+//   shell-client [-t] SOCKET COMMAND...
+//
+// The command runs with this process's cwd, environment and stdio, and
+// its exit status becomes ours. -t prints the server-side timing.
+
+#include "protocol.hpp"
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+extern char** environ;
+
+int main(int argc, char* argv[]) {
+    int i = 1;
+    bool timing = false;
+    if (i < argc && std::strcmp(argv[i], "-t") == 0) {
+        timing = true;
+        ++i;
+    }
+    if (argc - i < 2) {
+        fprintf(stderr, "usage: shell-client [-t] SOCKET COMMAND...\n");
+        return 2;
+    }
+
+    std::string path = argv[i++];
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "shell-client: %s: socket path too long\n", path.c_str());
+        return 2;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0 ||
+        connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        fprintf(stderr, "shell-client: %s: %s\n", path.c_str(), strerror(errno));
+        return 255;
+    }
+
+    shell::protocol::Request req;
+    for (; i < argc; ++i) {
+        if (!req.command.empty()) req.command += ' ';
+        req.command += argv[i];
+    }
+    char cwd[PATH_MAX];
+    req.cwd = getcwd(cwd, sizeof(cwd)) ? cwd : "/";
+    for (char** env = environ; *env; ++env) {
+        req.env.push_back(*env);
+    }
+    req.fds[0] = STDIN_FILENO;
+    req.fds[1] = STDOUT_FILENO;
+    req.fds[2] = STDERR_FILENO;
+
+    shell::protocol::Response resp;
+    if (!shell::protocol::send_request(sock, req) ||
+        !shell::protocol::recv_response(sock, resp)) {
+        fprintf(stderr, "shell-client: connection closed by server\n");
+        return 255;
+    }
+
+    if (timing) {
+        fprintf(stderr, "status %d  real %.3fs  user %.3fs  sys %.3fs\n",
+                resp.status, static_cast<double>(resp.wall_ns) / 1e9,
+                static_cast<double>(resp.user_us) / 1e6,
+                static_cast<double>(resp.sys_us) / 1e6);
+    }
+    return resp.status;
+}